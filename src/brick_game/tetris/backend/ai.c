@@ -0,0 +1,369 @@
+#include "ai.h"
+
+#include "figures.h"
+
+/**
+ * @brief Веса оценки по умолчанию
+ * @details Подобраны прогонами tetris_sim -a: главное - не оставлять дыр
+ *          и переходов по столбцам, высоту держать низкой
+ */
+static const AiWeights_t AI_WEIGHTS = {.aggregate_height = -0.51,
+                                       .holes = -7.9,
+                                       .bumpiness = -0.18,
+                                       .row_transitions = -3.2,
+                                       .column_transitions = -9.3,
+                                       .wells = -1.0,
+                                       .max_height = -0.5,
+                                       .lines = 3.4};
+
+/**
+ * @brief Кладет фигуру на битборд и удаляет заполненные строки
+ * @param rows Битборд поля (изменяется)
+ * @param height Высота поля
+ * @param width Ширина поля
+ * @param figure Фигура в конечном положении
+ * @return Количество удаленных строк или -1, если фигура легла выше поля
+ */
+static int place_rows(uint32_t *rows, int height, int width,
+                      const Tetramino *figure) {
+  const FigureShape *shape = figure_shape(figure);
+  int lines = 0;
+  for (int i = shape->top; i <= shape->bottom; i++) {
+    int y = figure->y + i;
+    if (y < 0)
+      lines = -1;
+    else
+      rows[BOARD_TOP + y] |= (uint32_t)shape->mask[i]
+                             << (figure->x + BOARD_WALL);
+  }
+  if (lines == 0) {
+    int write = BOARD_TOP + height - 1;
+    for (int read = write; read >= BOARD_TOP; read--) {
+      if (rows[read] == ROW_FULL)
+        lines++;
+      else
+        rows[write--] = rows[read];
+    }
+    while (write >= BOARD_TOP) rows[write--] = ROW_EMPTY_OF(width);
+  }
+  return lines;
+}
+
+/**
+ * @brief Оценивает поле после положения фигуры
+ * @param weights Веса признаков
+ * @param features Признаки поля
+ * @param lines Удаленные строки (-1 - фигура легла выше поля)
+ * @return Взвешенная сумма признаков
+ */
+static double ai_score(const AiWeights_t *weights,
+                       const BoardFeatures_t *features, int lines) {
+  double score = AI_LOSS;
+  if (lines >= 0)
+    score = weights->aggregate_height * features->aggregate_height +
+            weights->holes * features->holes +
+            weights->bumpiness * features->bumpiness +
+            weights->row_transitions * features->row_transitions +
+            weights->column_transitions * features->column_transitions +
+            weights->wells * features->wells +
+            weights->max_height * features->max_height +
+            weights->lines * lines;
+  return score;
+}
+
+/**
+ * @brief Перечисляет положения фигуры на поле scratch->board и оценивает их
+ * @param s Рабочая память потока (board - исходное поле)
+ * @param figure Фигура в начальном положении
+ * @param search 1 - полный поиск generate_placements(), 0 - generate_drops()
+ * @return Количество положений; поля, строки и признаки - в s
+ */
+static int ai_expand(AiScratch_t *s, const Tetramino *figure, int search) {
+  int height = s->board.height, width = s->board.width;
+  int count = 0;
+  if (search)
+    count = generate_placements(&s->board, figure, s->places, PLACEMENTS_MAX);
+  else
+    count = generate_drops(&s->board, figure, s->places, PLACEMENTS_MAX);
+  for (int j = 0; j < count; j++) {
+    Tetramino placed = *figure;
+    placed.x = s->places[j].x;
+    placed.y = s->places[j].y;
+    placed.rotation = s->places[j].rotation;
+    memcpy(s->boards[j], s->board.rows, sizeof(s->boards[j]));
+    s->lines[j] = place_rows(s->boards[j], height, width, &placed);
+  }
+  board_features_batch((const uint32_t(*)[BOARD_ROWS_MAX])s->boards, count,
+                       height, width, s->features);
+  return count;
+}
+
+/**
+ * @brief Лучшая оценка следующей фигуры на поле после кандидата
+ * @param ai Автоигрок (следующая фигура задания)
+ * @param s Рабочая память потока
+ * @param rows Поле после положения текущей фигуры
+ * @return Оценка лучшего положения следующей фигуры
+ */
+static double ai_second(AiPlayer_t *ai, AiScratch_t *s,
+                        const uint32_t *rows) {
+  Tetramino next = *ai->job_next;
+  double best = AI_LOSS;
+  s->board.height = ai->first.board.height;
+  s->board.width = ai->first.board.width;
+  memcpy(s->board.rows, rows, sizeof(s->board.rows));
+  update_heights(&s->board);
+  next.x = (int8_t)(s->board.width / 2 - 2);
+  next.y = figure_info(next.id)->spawn_y;
+  next.rotation = 0;
+  int count = ai_expand(s, &next, 0);
+  for (int j = 0; j < count; j++) {
+    double score =
+        ai_score(&ai->config.weights, &s->features[j], s->lines[j]);
+    if (score > best) best = score;
+  }
+  return best;
+}
+
+/**
+ * @brief Разбирает кандидатов текущего задания, пока они не кончатся
+ * @param ai Автоигрок
+ * @param s Рабочая память потока
+ * @details Кандидаты берутся атомарным счетчиком в порядке убывания оценки
+ *          первого уровня. Если поиск ограничен сроком (timed), после
+ *          срока оценивается только лучший кандидат, остальные получают
+ *          AI_LOSS.
+ */
+static void ai_run_job(AiPlayer_t *ai, AiScratch_t *s) {
+  int i;
+  while ((i = atomic_fetch_add(&ai->job_cursor, 1)) < ai->job_count) {
+    int c = ai->order[i];
+    if (i > 0 && ai->config.timed && monotonic_time() > ai->job_deadline)
+      ai->value[c] = AI_LOSS;
+    else if (ai->first.lines[c] < 0)
+      ai->value[c] = AI_LOSS;
+    else
+      ai->value[c] = ai->config.weights.lines * ai->first.lines[c] +
+                     ai_second(ai, s, ai->first.boards[c]);
+  }
+}
+
+/**
+ * @brief Поток пула: ждет задания и разбирает кандидатов
+ * @param arg Рабочая память потока (AiScratch_t)
+ * @return NULL
+ */
+static void *ai_worker(void *arg) {
+  AiScratch_t *s = arg;
+  AiPlayer_t *ai = s->owner;
+  unsigned seen = 0;
+  pthread_mutex_lock(&ai->lock);
+  while (!ai->stop) {
+    if (ai->generation != seen) {
+      seen = ai->generation;
+      pthread_mutex_unlock(&ai->lock);
+      ai_run_job(ai, s);
+      pthread_mutex_lock(&ai->lock);
+      if (--ai->pending == 0) pthread_cond_signal(&ai->work_done);
+    } else {
+      pthread_cond_wait(&ai->work_ready, &ai->lock);
+    }
+  }
+  pthread_mutex_unlock(&ai->lock);
+  return NULL;
+}
+
+/**
+ * @brief Создает автоигрока
+ * @param config Параметры (NULL - один поток и значения по умолчанию)
+ * @return Указатель на автоигрока или NULL при нехватке памяти
+ * @details Запускает config->threads - 1 потоков пула; вызывающий поток
+ *          сам участвует в поиске
+ */
+AiPlayer_t *ai_create(const AiConfig_t *config) {
+  static const AiWeights_t zero_weights = {0};
+  AiPlayer_t *ai = aligned_alloc(_Alignof(AiPlayer_t), sizeof(AiPlayer_t));
+  if (ai != NULL) {
+    memset(ai, 0, sizeof(AiPlayer_t));
+    if (config != NULL) ai->config = *config;
+    if (ai->config.threads < 1) ai->config.threads = 1;
+    if (ai->config.threads > AI_THREADS_MAX)
+      ai->config.threads = AI_THREADS_MAX;
+    if (ai->config.beam_width <= 0) ai->config.beam_width = AI_BEAM_WIDTH;
+    if (memcmp(&ai->config.weights, &zero_weights, sizeof(zero_weights)) == 0)
+      ai->config.weights = AI_WEIGHTS;
+    pthread_mutex_init(&ai->lock, NULL);
+    pthread_cond_init(&ai->work_ready, NULL);
+    pthread_cond_init(&ai->work_done, NULL);
+    atomic_init(&ai->job_cursor, 0);
+    for (int i = 0; i < AI_THREADS_MAX; i++) ai->scratch[i].owner = ai;
+    ai->first.owner = ai;
+    for (int i = 1; i < ai->config.threads; i++) {
+      if (pthread_create(&ai->workers[ai->workers_count], NULL, ai_worker,
+                         &ai->scratch[i]) == 0)
+        ai->workers_count++;
+    }
+  }
+  return ai;
+}
+
+/**
+ * @brief Останавливает пул потоков и освобождает автоигрока
+ * @param ai Автоигрок (может быть NULL)
+ */
+void ai_destroy(AiPlayer_t *ai) {
+  if (ai != NULL) {
+    pthread_mutex_lock(&ai->lock);
+    ai->stop = 1;
+    pthread_cond_broadcast(&ai->work_ready);
+    pthread_mutex_unlock(&ai->lock);
+    for (int i = 0; i < ai->workers_count; i++)
+      pthread_join(ai->workers[i], NULL);
+    pthread_cond_destroy(&ai->work_done);
+    pthread_cond_destroy(&ai->work_ready);
+    pthread_mutex_destroy(&ai->lock);
+    free(ai);
+  }
+}
+
+/**
+ * @brief Сбрасывает план хода (например, перед новой игрой)
+ * @param ai Автоигрок
+ */
+void ai_reset(AiPlayer_t *ai) {
+  ai->planned = 0;
+  ai->plan_step = 0;
+}
+
+/**
+ * @brief Время на поиск одного хода
+ * @param game Указатель на состояние игры
+ * @return Бюджет в мс: доля интервала гравитации game->speed
+ */
+long long ai_budget(const GameInfo_t *game) {
+  return game->speed / AI_BUDGET_DIVISOR;
+}
+
+/**
+ * @brief Выбирает положение текущей фигуры лучевым поиском
+ * @param ai Автоигрок
+ * @param game Указатель на состояние игры (только чтение)
+ * @param[out] best Выбранное положение и путь к нему
+ * @return 1 если положение найдено, 0 если фигуре некуда встать
+ * @details Первый уровень - все достижимые положения current, оцененные по
+ *          признакам поля. Лучшие beam_width из них раскрываются на втором
+ *          уровне положениями next из generate_drops(); оценка кандидата -
+ *          удаленные им строки плюс лучшая оценка next. Кандидаты
+ *          второго уровня делятся между потоками пула; при timed поиск
+ *          ограничен сроком ai_budget().
+ */
+int ai_plan(AiPlayer_t *ai, const GameInfo_t *game, Placement_t *best) {
+  AiScratch_t *first = &ai->first;
+  long long deadline = monotonic_time() + ai_budget(game);
+  first->board.height = game->height;
+  first->board.width = game->width;
+  memcpy(first->board.rows, game->rows, sizeof(first->board.rows));
+  memcpy(first->board.heights, game->heights, sizeof(first->board.heights));
+  int count = ai_expand(first, &game->current, 1);
+  for (int j = 0; j < count; j++) {
+    ai->level[j] = ai_score(&ai->config.weights, &first->features[j],
+                            first->lines[j]);
+    int k = j;
+    for (; k > 0 && ai->level[ai->order[k - 1]] < ai->level[j]; k--)
+      ai->order[k] = ai->order[k - 1];
+    ai->order[k] = j;
+  }
+  int beam = count < ai->config.beam_width ? count : ai->config.beam_width;
+  if (game->next.id == FIGURE_NONE) {
+    for (int i = 0; i < beam; i++)
+      ai->value[ai->order[i]] = ai->level[ai->order[i]];
+  } else if (beam > 0) {
+    ai->job_next = &game->next;
+    ai->job_count = beam;
+    ai->job_deadline = deadline;
+    atomic_store(&ai->job_cursor, 0);
+    if (ai->workers_count > 0) {
+      pthread_mutex_lock(&ai->lock);
+      ai->generation++;
+      ai->pending = ai->workers_count;
+      pthread_cond_broadcast(&ai->work_ready);
+      pthread_mutex_unlock(&ai->lock);
+    }
+    ai_run_job(ai, &ai->scratch[0]);
+    pthread_mutex_lock(&ai->lock);
+    while (ai->pending > 0) pthread_cond_wait(&ai->work_done, &ai->lock);
+    pthread_mutex_unlock(&ai->lock);
+  }
+  int chosen = beam > 0 ? ai->order[0] : -1;
+  for (int i = 1; i < beam; i++) {
+    if (ai->value[ai->order[i]] > ai->value[chosen]) chosen = ai->order[i];
+  }
+  if (chosen >= 0) *best = first->places[chosen];
+  return chosen >= 0;
+}
+
+/**
+ * @brief Сравнивает положения двух фигур
+ * @param a Первая фигура
+ * @param b Вторая фигура
+ * @return 1 если номер, координаты и поворот совпадают
+ */
+static int same_place(const Tetramino *a, const Tetramino *b) {
+  return a->id == b->id && a->x == b->x && a->y == b->y &&
+         a->rotation == b->rotation;
+}
+
+/**
+ * @brief Выдает очередное действие автоигрока
+ * @param ai Автоигрок
+ * @param game Указатель на состояние игры
+ * @return Действие для tetris_step() или -1 (ждать)
+ * @details В START и GAMEOVER начинает игру. Для новой фигуры, а также если
+ *          фигура оказалась не там, где ожидалось (например, ее сдвинула
+ *          гравитация), строит план заново. Шаг MOVE_SOFT выполняет
+ *          гравитация: автоигрок ждет, пока фигура опустится.
+ */
+UserAction_t ai_action(AiPlayer_t *ai, const GameInfo_t *game) {
+  UserAction_t action = -1;
+  if (game->state == START || game->state == GAMEOVER) {
+    action = Start;
+  } else if (game->state == MOVING) {
+    Tetramino fallen = ai->expect;
+    fallen.y++;
+    if (ai->planned && ai->plan_step < ai->plan.path_len &&
+        ai->plan.path[ai->plan_step] == MOVE_SOFT &&
+        same_place(&game->current, &fallen)) {
+      ai->expect = fallen;
+      ai->plan_step++;
+    }
+    if (!ai->planned || !same_place(&game->current, &ai->expect)) {
+      ai->planned = ai_plan(ai, game, &ai->plan);
+      ai->plan_step = 0;
+      ai->expect = game->current;
+    }
+    if (ai->planned && ai->plan_step < ai->plan.path_len) {
+      switch (ai->plan.path[ai->plan_step]) {
+        case MOVE_LEFT:
+          action = Left;
+          ai->expect.x--;
+          break;
+        case MOVE_RIGHT:
+          action = Right;
+          ai->expect.x++;
+          break;
+        case MOVE_ROTATE:
+          action = Action;
+          rotate_tetramino(game, &ai->expect);
+          break;
+        case MOVE_DROP:
+          action = Down;
+          ai->expect.y = landing_y(game, &ai->expect);
+          break;
+        default:
+          break;
+      }
+      if (action != (UserAction_t)-1) ai->plan_step++;
+    }
+  }
+  return action;
+}
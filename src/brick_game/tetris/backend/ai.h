@@ -0,0 +1,94 @@
+#ifndef AI_TETRIS_H
+#define AI_TETRIS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "backend_tetris.h"
+#include "moves.h"
+
+#define AI_THREADS_MAX 8  ///< наибольшее число потоков поиска
+#define AI_BEAM_WIDTH 8  ///< число лучших положений текущей фигуры
+#define AI_BUDGET_DIVISOR 4  ///< доля интервала гравитации на поиск хода
+#define AI_LOSS (-1e9)  ///< оценка проигрышного положения
+
+/**
+ * @struct AiWeights_t
+ * @brief Веса признаков поля в оценке положения
+ */
+typedef struct {
+  double aggregate_height;    ///< Сумма высот столбцов
+  double holes;               ///< Дыры
+  double bumpiness;           ///< Неровность
+  double row_transitions;     ///< Переходы вдоль строк
+  double column_transitions;  ///< Переходы вдоль столбцов
+  double wells;               ///< Клетки колодцев
+  double max_height;          ///< Наибольшая высота
+  double lines;               ///< Удаленные строки
+} AiWeights_t;
+
+/**
+ * @struct AiConfig_t
+ * @brief Параметры автоигрока
+ * @details Без timed поиск всегда перебирает всех кандидатов луча, и ход
+ * зависит только от состояния игры: прогоны tetris_sim и tetris_batch
+ * воспроизводимы при любой загрузке машины. Срок нужен игре в реальном
+ * времени, где поиск не должен задерживать гравитацию.
+ */
+typedef struct {
+  int threads;  ///< Потоков поиска, включая вызывающий (1 - без пула)
+  int beam_width;  ///< Ширина луча (0 - AI_BEAM_WIDTH)
+  int timed;  ///< Ограничивать поиск сроком ai_budget()
+  AiWeights_t weights;  ///< Веса оценки (все нули - веса по умолчанию)
+} AiConfig_t;
+
+/**
+ * @struct AiScratch_t
+ * @brief Рабочая память одного потока поиска
+ */
+typedef struct {
+  struct AiPlayer_t *owner;  ///< Автоигрок-владелец
+  GameInfo_t board;  ///< Поле (только размеры, rows и heights)
+  Placement_t places[PLACEMENTS_MAX];  ///< Положения фигуры
+  uint32_t boards[PLACEMENTS_MAX][BOARD_ROWS_MAX];  ///< Поля после положений
+  int lines[PLACEMENTS_MAX];  ///< Удаленные строки
+  BoardFeatures_t features[PLACEMENTS_MAX];  ///< Признаки полей
+} AiScratch_t;
+
+/**
+ * @struct AiPlayer_t
+ * @brief Автоигрок: пул потоков поиска и текущий план хода
+ */
+typedef struct AiPlayer_t {
+  AiConfig_t config;  ///< Параметры
+  AiScratch_t first;  ///< Положения текущей фигуры
+  AiScratch_t scratch[AI_THREADS_MAX];  ///< Память потоков
+  pthread_t workers[AI_THREADS_MAX];    ///< Потоки пула
+  int workers_count;          ///< Запущено потоков пула
+  pthread_mutex_t lock;       ///< Защита полей задания
+  pthread_cond_t work_ready;  ///< Появилось задание
+  pthread_cond_t work_done;   ///< Потоки пула закончили
+  unsigned generation;        ///< Номер текущего задания
+  int pending;                ///< Потоков, не закончивших
+  int stop;                   ///< Флаг завершения пула
+  const Tetramino *job_next;  ///< Следующая фигура задания
+  int job_count;           ///< Кандидатов в задании
+  long long job_deadline;  ///< Срок поиска (monotonic_time())
+  atomic_int job_cursor;   ///< Следующий кандидат
+  int order[PLACEMENTS_MAX];  ///< Кандидаты по убыванию оценки
+  double level[PLACEMENTS_MAX];  ///< Оценка первого уровня
+  double value[PLACEMENTS_MAX];  ///< Оценка с учетом next
+  Placement_t plan;              ///< Выбранное положение
+  int plan_step;                 ///< Следующий ход плана
+  int planned;                   ///< План построен
+  Tetramino expect;  ///< Ожидаемое положение фигуры
+} AiPlayer_t;
+
+AiPlayer_t *ai_create(const AiConfig_t *config);
+void ai_destroy(AiPlayer_t *ai);
+void ai_reset(AiPlayer_t *ai);
+long long ai_budget(const GameInfo_t *game);
+int ai_plan(AiPlayer_t *ai, const GameInfo_t *game, Placement_t *best);
+UserAction_t ai_action(AiPlayer_t *ai, const GameInfo_t *game);
+
+#endif  // AI_TETRIS_H
@@ -1,48 +1,309 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "backend_tetris.h"
 
 #include "figures.h"
+#include "fsm_stats.h"
+#include "input.h"
 
 /**
  * @brief Возвращает указатель на текущее состояние игры
  * @return Указатель на структуру GameInfo_t
- * @note Использует статическую переменную для хранения состояния
+ * @note Использует статическую переменную для хранения состояния; это
+ *       экземпляр игры по умолчанию для userInput()
  */
 GameInfo_t *updateCurrentState() {
-  static GameInfo_t game = {0};
+  static GameInfo_t game = {
+      .rng = RNG_INITIALIZER, .height = HEIGHT, .width = WIDTH};
   return &game;
 }
 
+/**
+ * @brief Создает новый независимый экземпляр игры
+ * @param config Параметры экземпляра (NULL - параметры по умолчанию)
+ * @return Указатель на инициализированное состояние игры или NULL,
+ *         если не удалось выделить память или размеры поля недопустимы
+ *         (см. tetris_size_valid())
+ * @details Экземпляры не разделяют состояние, поэтому разные игры можно
+ *          вести параллельно в разных потоках. Генератор фигур заводится
+ *          из config->seed; без параметров начальное значение равно 0,
+ *          а поле имеет размеры HEIGHT x WIDTH.
+ * @see tetris_step(), tetris_destroy()
+ */
+GameInfo_t *tetris_create(const TetrisConfig_t *config) {
+  int height = config != NULL && config->height != 0 ? config->height : HEIGHT;
+  int width = config != NULL && config->width != 0 ? config->width : WIDTH;
+  GameInfo_t *game = NULL;
+  if (tetris_size_valid(height, width))
+    game = aligned_alloc(_Alignof(GameInfo_t), sizeof(GameInfo_t));
+  if (game != NULL) {
+    memset(game, 0, sizeof(GameInfo_t));
+    game->height = (uint8_t)height;
+    game->width = (uint8_t)width;
+    if (config != NULL) {
+      game->flags = config->flags;
+      game->randomizer = config->randomizer;
+    }
+    rng_seed(&game->rng, config != NULL ? config->seed : 0);
+    game_init(game);
+  }
+  return game;
+}
+
+/**
+ * @brief Проверяет размеры поля
+ * @param height Высота поля (0 - HEIGHT)
+ * @param width Ширина поля (0 - WIDTH)
+ * @return 1 если игру с таким полем можно создать, иначе 0
+ */
+int tetris_size_valid(int height, int width) {
+  return (height == 0 || (height >= SIZE_MIN && height <= HEIGHT_MAX)) &&
+         (width == 0 || (width >= SIZE_MIN && width <= WIDTH_MAX));
+}
+
+/**
+ * @brief Выполняет один шаг конечного автомата игры
+ * @param game Указатель на состояние игры
+ * @param action Действие пользователя
+ * @note В сборке с TETRIS_STATS каждый шаг замеряется (см. FsmStats_t)
+ */
+void tetris_step(GameInfo_t *game, UserAction_t action) {
+  FSM_STATS_BEGIN(game);
+  switch (game->state) {
+    case START:
+      start_state_actions(game, action);
+      break;
+    case SPAWN:
+      spawn_state_actions(game);
+      break;
+    case MOVING:
+      moving_state_actions(game, action);
+      break;
+    case SHIFTING:
+      shifting_state_actions(game);
+      break;
+    case ATTACHING:
+      attaching_state_actions(game);
+      break;
+    case GAMEOVER:
+      gameover_state_actions(game, action);
+      break;
+    case PAUSE:
+      pause_state_actions(game, action);
+      break;
+    default:
+      break;
+  }
+  FSM_STATS_END(game);
+}
+
+/**
+ * @brief Продвигает виртуальные часы игры
+ * @param game Указатель на состояние игры
+ * @param ms Прошедшее время в миллисекундах
+ * @note Действует только для экземпляров с флагом GAME_VIRTUAL_CLOCK
+ */
+void tetris_advance_clock(GameInfo_t *game, long long ms) { game->clock += ms; }
+
+/**
+ * @brief Освобождает экземпляр игры, созданный tetris_create()
+ * @param game Указатель на состояние игры (может быть NULL)
+ */
+void tetris_destroy(GameInfo_t *game) { free(game); }
+
+/**
+ * @brief Снимает состояние игры
+ * @param game Указатель на состояние игры
+ * @param[out] snapshot Снимок; строки ниже высоты поля не заполняются
+ * @details Поля копируются по одному, строки поля сохраняются без стен:
+ *          для поля 20x10 снимок занимает GAME_SNAPSHOT_SIZE_OF(HEIGHT) =
+ *          108 байт. Это не один memcpy(): размер важнее, потому что
+ *          снимки хранятся в каждом ключевом кадре корпуса.
+ */
+void tetris_snapshot(const GameInfo_t *game, GameSnapshot_t *snapshot) {
+  uint32_t field = ROW_FIELD_OF(game->width);
+  snapshot->timer = game->timer;
+  snapshot->clock = game->clock;
+  snapshot->rng = game->rng;
+  snapshot->score = game->score;
+  snapshot->lines = game->lines;
+  snapshot->pieces = game->pieces;
+  snapshot->speed = (uint16_t)game->speed;
+  snapshot->current = game->current;
+  snapshot->next = game->next;
+  snapshot->state = (uint8_t)game->state;
+  snapshot->level = (uint8_t)game->level;
+  snapshot->randomizer = game->randomizer;
+  snapshot->bag_left = game->bag_left;
+  memcpy(snapshot->bag, game->bag, sizeof(snapshot->bag));
+  snapshot->height = game->height;
+  snapshot->width = game->width;
+  snapshot->reserved = 0;
+  for (int y = 0; y < game->height; y++)
+    snapshot->rows[y] =
+        (uint16_t)((game->rows[BOARD_TOP + y] & field) >> BOARD_WALL);
+}
+
+/**
+ * @brief Восстанавливает состояние игры из снимка
+ * @param game Указатель на состояние игры
+ * @param snapshot Снимок этой или другой игры той же сборки с полем тех же
+ *                 размеров
+ * @details Стены, буферные строки, пол и высоты столбцов строятся заново,
+ * поэтому восстановление дороже копирования снимка (см. случай
+ * tetris_restore в tetris_bench)
+ * @note Рекорд и цветовой слой поля не восстанавливаются: они не влияют на
+ *       ход игры. Для отрисовки после восстановления цвета нужно заполнить
+ *       заново.
+ */
+void tetris_restore(GameInfo_t *game, const GameSnapshot_t *snapshot) {
+  game->timer = snapshot->timer;
+  game->clock = snapshot->clock;
+  game->rng = snapshot->rng;
+  game->score = snapshot->score;
+  game->lines = snapshot->lines;
+  game->pieces = snapshot->pieces;
+  game->speed = snapshot->speed;
+  game->current = snapshot->current;
+  game->next = snapshot->next;
+  game->state = (GameState_t)snapshot->state;
+  game->level = snapshot->level;
+  game->randomizer = snapshot->randomizer;
+  game->bag_left = snapshot->bag_left;
+  memcpy(game->bag, snapshot->bag, sizeof(game->bag));
+  game->height = snapshot->height;
+  game->width = snapshot->width;
+  game->cleared_rows = 0;
+  game->state_since = 0;
+  uint32_t empty = ROW_EMPTY_OF(game->width);
+  for (int i = 0; i < BOARD_TOP; i++) game->rows[i] = empty;
+  for (int y = 0; y < game->height; y++)
+    game->rows[BOARD_TOP + y] =
+        empty | (uint32_t)snapshot->rows[y] << BOARD_WALL;
+  for (int i = BOARD_TOP + game->height; i < BOARD_ROWS_MAX; i++)
+    game->rows[i] = ROW_FULL;
+  update_heights(game);
+}
+
 /**
  * @brief Инициализирует начальное состояние игры
  * @param game Указатель на структуру состояния игры
- * @details Очищает игровое поле, сбрасывает счет и уровень,
- *          загружает рекорд и устанавливает начальное состояние
+ * @details Очищает игровое поле, сбрасывает счет и уровень и
+ *          устанавливает начальное состояние. Рекорд не трогается: его
+ *          задает владелец таблицы рекордов (см. ScoreStore_t)
  */
 void game_init(GameInfo_t *game) {
-  reset_field();
-  generate_figure(&game->next);
+  reset_field(game);
+  generate_figure(game, &game->next);
   game->score = 0;
-  game->high_score = load_max_score();
+  game->lines = 0;
+  game->pieces = 0;
   game->level = LEVEL_MIN;
   game->speed = SPEED_MIN;
-  game->pause = 0;
-  game->timer = get_current_time();
+  game->timer = game_time(game);
   game->state = START;
 }
 
 /**
  * @brief Очищает игровое поле
- * @details Устанавливает все ячейки поля в 0
+ * @details Обнуляет цветовой слой, заполняет битборд пустыми строками
+ *          со стенами и добавляет под полем заполненные строки пола
+ *          (до конца массива строк)
  */
-void reset_field() {
-  GameInfo_t *game = updateCurrentState();
-  for (int i = 0; i < HEIGHT; i++) {
-    for (int j = 0; j < WIDTH; j++) {
-      game->field[i][j] = 0;
+void reset_field(GameInfo_t *game) {
+  uint32_t empty = ROW_EMPTY_OF(game->width);
+  memset(game->field, 0, sizeof(game->field));
+  memset(game->heights, 0, sizeof(game->heights));
+  game->cleared_rows = 0;
+  for (int i = 0; i < BOARD_ROWS_MAX; i++)
+    game->rows[i] = i < BOARD_TOP + game->height ? empty : ROW_FULL;
+}
+
+/**
+ * @brief Записывает клетку поля в цветовой слой и битборд
+ * @param game Указатель на структуру состояния игры
+ * @param y Номер строки поля
+ * @param x Номер столбца поля
+ * @param color Цвет клетки (0 - пустая клетка)
+ */
+void set_field_cell(GameInfo_t *game, int y, int x, int color) {
+  uint32_t bit = 1u << (BOARD_WALL + x);
+  game->field[y][x] = (uint8_t)color;
+  if (color != 0)
+    game->rows[BOARD_TOP + y] |= bit;
+  else
+    game->rows[BOARD_TOP + y] &= ~bit;
+  update_heights(game);
+}
+
+/**
+ * @brief Возвращает цвет клетки поля
+ * @param game Указатель на структуру состояния игры
+ * @param y Номер строки поля
+ * @param x Номер столбца поля
+ * @return Цвет клетки (0 - пустая клетка)
+ */
+int field_color(const GameInfo_t *game, int y, int x) {
+  return game->field[y][x];
+}
+
+/**
+ * @brief Пересчитывает высоты всех столбцов по битборду
+ * @param game Указатель на структуру состояния игры
+ * @details Один проход по строкам сверху вниз: столбцы, впервые встреченные
+ *          занятыми в строке y, получают высоту game->height - y
+ */
+void update_heights(GameInfo_t *game) {
+  int height = game->height;
+  uint32_t field = ROW_FIELD_OF(game->width);
+  uint32_t seen = 0;
+  memset(game->heights, 0, sizeof(game->heights));
+  for (int y = 0; y < height && seen != field; y++) {
+    uint32_t fresh = game->rows[BOARD_TOP + y] & field & ~seen;
+    seen |= fresh;
+    while (fresh != 0) {
+      game->heights[__builtin_ctz(fresh) - BOARD_WALL] = (uint8_t)(height - y);
+      fresh &= fresh - 1;
     }
   }
 }
 
+/**
+ * @brief Возвращает строку битборда по номеру строки поля
+ * @param game Указатель на структуру состояния игры
+ * @param y Номер строки (может выходить за буфер сверху и пол снизу)
+ * @return Маска строки: выше буфера - пустая строка, ниже пола - заполненная
+ * @details Строки под полем до конца массива заполнены (см. reset_field()),
+ *          поэтому граница проверки не зависит от высоты поля
+ */
+static uint32_t board_row(const GameInfo_t *game, int y) {
+  uint32_t row = ROW_FULL;
+  if (y < -BOARD_TOP)
+    row = ROW_EMPTY_OF(game->width);
+  else if (y < HEIGHT_MAX + BOARD_FLOOR)
+    row = game->rows[BOARD_TOP + y];
+  return row;
+}
+
+/**
+ * @brief Переводит строку фигуры в координаты битборда
+ * @param figure Указатель на фигуру
+ * @param shape Форма фигуры из таблицы фигур
+ * @param i Номер строки матрицы фигуры
+ * @return Маска строки на позиции фигуры; 32 бита, чтобы клетки за правой
+ *         стеной не терялись, клетки левее стены попадают в бит стены
+ */
+static uint32_t figure_row(const Tetramino *figure, const FigureShape *shape,
+                           int i) {
+  uint32_t row = shape->mask[i];
+  int shift = figure->x + BOARD_WALL;
+  if (shift >= 0)
+    row <<= shift;
+  else if (row != 0)
+    row = (row >> -shift) | 1u;
+  return row;
+}
+
 /**
  * @brief Получает текущее время в миллисекундах
  * @return Текущее время в миллисекундах
@@ -53,6 +314,27 @@ long long int get_current_time() {
   return (long long)now.tv_sec * 1000 + now.tv_usec / 1000;
 }
 
+/**
+ * @brief Получает монотонное время в миллисекундах
+ * @return Время CLOCK_MONOTONIC в миллисекундах
+ * @details В отличие от get_current_time() не скачет при переводе
+ * системных часов, поэтому годится для сроков и интервалов
+ */
+long long int monotonic_time() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Получает текущее время игры в миллисекундах
+ * @param game Указатель на структуру состояния игры
+ * @return Виртуальное время при GAME_VIRTUAL_CLOCK, иначе системное время
+ */
+long long int game_time(const GameInfo_t *game) {
+  return (game->flags & GAME_VIRTUAL_CLOCK) ? game->clock : get_current_time();
+}
+
 /**
  * @brief Преобразует ввод пользователя в игровое действие
  * @param user_input Код нажатой клавиши
@@ -89,37 +371,16 @@ UserAction_t get_action(int user_input) {
 /**
  * @brief Обрабатывает пользовательский ввод в зависимости от состояния игры
  * @param action Действие пользователя
- * @param hold Флаг удержания клавиши (не используется)
+ * @param hold Флаг удержания клавиши
+ * @details Сдвиги проходят через автоповтор экземпляра по умолчанию
+ * (параметры INPUT_DAS_MS и INPUT_ARR_MS): нажатие сдвигает фигуру сразу,
+ * а вызовы с hold, пока клавиша удерживается, - не чаще, чем разрешает
+ * автоповтор (см. AutoShift_t)
  */
 void userInput(UserAction_t action, bool hold) {
+  static AutoShift_t shift = AUTOSHIFT_INITIALIZER;
   GameInfo_t *game = updateCurrentState();
-
-  switch (game->state) {
-    case START:
-      start_state_actions(game, action);
-      break;
-    case SPAWN:
-      spawn_state_actions(game);
-      break;
-    case MOVING:
-      moving_state_actions(game, action);
-      break;
-    case SHIFTING:
-      shifting_state_actions(game);
-      break;
-    case ATTACHING:
-      attaching_state_actions(game);
-      break;
-    case GAMEOVER:
-      gameover_state_actions(game, action);
-      break;
-    case PAUSE:
-      pause_state_actions(game, action);
-      break;
-    default:
-      break;
-  }
-  (void)hold;
+  tetris_step(game, autoshift_input(&shift, action, hold, game_time(game)));
 }
 
 /**
@@ -147,9 +408,10 @@ void start_state_actions(GameInfo_t *game, UserAction_t action) {
  * @details Спавнит новую фигуру и проверяет условия завершения игры
  */
 void spawn_state_actions(GameInfo_t *game) {
-  spawn_figure();
-  if (check_figure_overlay()) {
-    while (check_figure_overlay()) {
+  spawn_figure(game);
+  game->pieces++;
+  if (check_figure_overlay(game)) {
+    while (check_figure_overlay(game)) {
       game->current.y--;
     }
     game->state = GAMEOVER;
@@ -165,31 +427,29 @@ void spawn_state_actions(GameInfo_t *game) {
 void moving_state_actions(GameInfo_t *game, UserAction_t action) {
   switch (action) {
     case Left:
-      move_left();
+      move_left(game);
       break;
     case Right:
-      move_right();
+      move_right(game);
       break;
     case Down:
-      while (((collision() & 0b100) != 4)) {
-        move_down();
-      }
+      game->current.y = landing_y(game, &game->current);
       break;
     case Action:
-      rotate_figure();
+      rotate_figure(game);
       break;
     case Terminate:
       game->state = EXIT_STATE;
       break;
     case Pause:
       game->state = PAUSE;
-      game->pause = 1;
       break;
     default:
       break;
   }
-  if ((get_current_time() - game->timer) >= game->speed) {
-    game->timer = get_current_time();
+  long long now = game_time(game);
+  if ((now - game->timer) >= game->speed) {
+    game->timer = now;
     game->state = SHIFTING;
   }
 }
@@ -202,8 +462,8 @@ void moving_state_actions(GameInfo_t *game, UserAction_t action) {
  * - Иначе возвращается в MOVING
  */
 void shifting_state_actions(GameInfo_t *game) {
-  move_down();
-  game->state = ((collision() & 0b100) == 4) ? ATTACHING : MOVING;
+  move_down(game);
+  game->state = ((collision(game) & 0b100) == 4) ? ATTACHING : MOVING;
 }
 
 /**
@@ -216,9 +476,9 @@ void shifting_state_actions(GameInfo_t *game) {
  * 4. Переход в состояние SPAWN для новой фигуры
  */
 void attaching_state_actions(GameInfo_t *game) {
-  attached_figure();
-  calculate_score();
-  update_level();
+  attached_figure(game);
+  calculate_score(game);
+  update_level(game);
   game->state = SPAWN;
 }
 
@@ -233,9 +493,8 @@ void attaching_state_actions(GameInfo_t *game) {
 void pause_state_actions(GameInfo_t *game, UserAction_t action) {
   switch (action) {
     case Pause:
-      game->pause = 0;
       game->state = MOVING;
-      game->timer = get_current_time();
+      game->timer = game_time(game);
       break;
     case Terminate:
       game->state = EXIT_STATE;
@@ -270,123 +529,183 @@ void gameover_state_actions(GameInfo_t *game, UserAction_t action) {
 
 /**
  * @brief Проверяет столкновения фигуры
+ * @param game Указатель на структуру состояния игры
  * @return Битовая маска столкновений (0b100 - низ, 0b010 - лево, 0b001 - право)
+ * @details Каждая строка фигуры сравнивается с соседними строками битборда
+ *          одной операцией AND; стены и пол входят в битборд
  */
-int collision() {
-  GameInfo_t *game = updateCurrentState();
+int collision(const GameInfo_t *game) {
+  const FigureShape *shape = figure_shape(&game->current);
   int collision = 0;
-  int x = game->current.x;
-  int y = game->current.y;  ///< координаты текущей фигуры
-  for (int i = 0; i < 4; i++, y++) {
-    for (int j = 0; j < 4; j++, x++) {
-      if (game->current.view[i][j] != 0 &&
-          (game->field[y + 1][x] != 0 || y == HEIGHT - 1))
-        collision |= (1 << 2);  ///< столкновение снизу (0b100(4))
-      if (game->current.view[i][j] != 0 && game->field[y][x - 1] != 0)
-        collision |= (1 << 1);  ///< столкновение слева (0b010(2))
-      if (game->current.view[i][j] != 0 && game->field[y][x + 1] != 0)
-        collision |= 1;  ///< столкновение справа (0b001(1))
-    }
-    x = game->current.x;
+  for (int i = shape->top; i <= shape->bottom; i++) {
+    uint32_t row = figure_row(&game->current, shape, i);
+    int y = game->current.y + i;
+    if (row & board_row(game, y + 1))
+      collision |= (1 << 2);  ///< столкновение снизу (0b100(4))
+    if ((row >> 1) & board_row(game, y))
+      collision |= (1 << 1);  ///< столкновение слева (0b010(2))
+    if ((row << 1) & board_row(game, y))
+      collision |= 1;  ///< столкновение справа (0b001(1))
   }
   return collision;
 }
 
 /**
- * @brief Проверяет наложение текущей фигуры на занятые клетки поля
+ * @brief Проверяет наложение фигуры на занятые клетки поля
+ * @param game Указатель на структуру состояния игры
+ * @param figure Фигура в проверяемой позиции и повороте
  * @return 1 если есть наложение, 0 если наложения нет
- * @details Функция проверяет все 4x4 клетки текущей фигуры на пересечение
- *          с непустыми клетками игрового поля. Проверка выполняется для
- *          текущей позиции фигуры (game->current.x, game->current.y).
- * @note Использует битовое представление фигуры (game->current.view),
- *       где 0 - пустая клетка, не 0 - часть фигуры.
+ * @details Строки фигуры пересекаются с битбордом; так как стены и пол
+ *          заняты, выход за боковые и нижнюю границы тоже считается наложением.
  */
-int check_figure_overlay() {
-  GameInfo_t *game = updateCurrentState();
+int figure_overlay(const GameInfo_t *game, const Tetramino *figure) {
+  const FigureShape *shape = figure_shape(figure);
   int overlay = 0;
-  int x = game->current.x;
-  int y = game->current.y;
-  for (int i = 0; i < 4; i++, y++) {
-    for (int j = 0; j < 4; j++, x++) {
-      if (game->current.view[i][j] != 0 && game->field[y][x] != 0) overlay = 1;
-    }
-    x = game->current.x;
+  for (int i = shape->top; i <= shape->bottom; i++) {
+    if (figure_row(figure, shape, i) & board_row(game, figure->y + i))
+      overlay = 1;
   }
   return overlay;
 }
 
+/**
+ * @brief Проверяет наложение текущей фигуры на занятые клетки поля
+ * @param game Указатель на структуру состояния игры
+ * @return 1 если есть наложение, 0 если наложения нет
+ * @see figure_overlay()
+ */
+int check_figure_overlay(const GameInfo_t *game) {
+  return figure_overlay(game, &game->current);
+}
+
 /**
  * @brief Проверяет выход фигуры за границы игрового поля
+ * @param game Указатель на структуру состояния игры
  * @return Код ошибки:
  *         - 0: нет выхода за границы
  *         - 1: выход за левую границу
  *         - 2: выход за правую границу
  *         - 3: выход за нижнюю границу
- * @note Проверяет все 4x4 клетки текущей фигуры
+ * @note Проверяет маски строк текущей фигуры по битам стен
  */
-int check_leaving_field() {
-  GameInfo_t *game = updateCurrentState();
+int check_leaving_field(const GameInfo_t *game) {
+  const FigureShape *shape = figure_shape(&game->current);
   int leave = 0;
-  int x = game->current.x;
-  int y = game->current.y;
-  for (int i = 0; i < 4; i++, y++) {
-    for (int j = 0; j < 4; j++, x++) {
-      if (game->current.view[i][j] != 0 && (x < 0))
-        leave = 1;
-      else if (game->current.view[i][j] != 0 && (x > WIDTH - 1))
-        leave = 2;
-      else if (game->current.view[i][j] != 0 && (y > HEIGHT - 1))
-        leave = 3;
-    }
-    x = game->current.x;
+  for (int i = shape->top; i <= shape->bottom; i++) {
+    uint32_t row = figure_row(&game->current, shape, i);
+    if (row >> (BOARD_WALL + game->width))
+      leave = 2;
+    else if (game->current.y + i > game->height - 1)
+      leave = 3;
+    else if (row & ((1u << BOARD_WALL) - 1))
+      leave = 1;
   }
   return leave;
 }
 
 /**
- * @brief Удаляет заполненные строки и подсчитывает их количество
- * @param[out] lines Указатель для сохранения количества удаленных строк
- * @return 1 если были удалены строки, 0 если нет
+ * @brief Вычисляет строку, на которую упадет фигура при сбросе
+ * @param game Указатель на структуру состояния игры
+ * @param figure Падающая фигура
+ * @return Y-координата фигуры после сброса
+ * @details Если фигура целиком выше поверхности стакана, строка падения
+ *          находится сразу по высотам столбцов и нижнему профилю фигуры,
+ *          без пошагового спуска. Фигура, задвинутая под нависающие клетки,
+ *          опускается пошагово.
  */
-int remove_full_lines(int *lines) {
-  const GameInfo_t *game = updateCurrentState();
-  int removed = 0;
-  for (int i = HEIGHT - 1; i >= 0; i--) {
-    int full = 1;
-    for (int j = 0; j < WIDTH; j++) {
-      if (game->field[i][j] == 0) full = 0;
+int landing_y(const GameInfo_t *game, const Tetramino *figure) {
+  const FigureShape *shape = figure_shape(figure);
+  int landing = game->height;
+  int above = 1;
+  for (int j = shape->left; j <= shape->right; j++) {
+    if (shape->profile[j] >= 0) {
+      int surface = game->height - game->heights[figure->x + j];
+      if (figure->y + shape->profile[j] >= surface) above = 0;
+      if (surface - 1 - shape->profile[j] < landing)
+        landing = surface - 1 - shape->profile[j];
     }
-    if (full) {
-      drop_lines(i);
-      *lines += 1;
-      removed = 1;
+  }
+  if (!above) {
+    Tetramino probe = *figure;
+    do {
+      probe.y++;
+    } while (!figure_overlay(game, &probe));
+    landing = probe.y - 1;
+  }
+  return landing;
+}
+
+/**
+ * @brief Удаляет все заполненные строки за один проход
+ * @param game Указатель на структуру состояния игры
+ * @return Маска удаленных строк: бит y - строка поля y
+ * @details Строки просматриваются снизу вверх, уцелевшие строки сразу
+ *          переносятся на место записи, освободившиеся сверху строки
+ *          очищаются. Маска также сохраняется в game->cleared_rows.
+ */
+uint64_t clear_lines(GameInfo_t *game) {
+  uint64_t mask = 0;
+  int write = game->height - 1;
+  for (int read = game->height - 1; read >= 0; read--) {
+    if (game->rows[BOARD_TOP + read] == ROW_FULL) {
+      mask |= 1ull << read;
+    } else {
+      if (write != read) {
+        game->rows[BOARD_TOP + write] = game->rows[BOARD_TOP + read];
+        memcpy(game->field[write], game->field[read], sizeof(game->field[0]));
+      }
+      write--;
     }
   }
-  return removed;
+  if (mask != 0) {
+    uint32_t empty = ROW_EMPTY_OF(game->width);
+    for (int i = 0; i <= write; i++) game->rows[BOARD_TOP + i] = empty;
+    memset(game->field, 0, sizeof(game->field[0]) * (write + 1));
+    update_heights(game);
+  }
+  game->cleared_rows = mask;
+  return mask;
+}
+
+/**
+ * @brief Удаляет заполненные строки и подсчитывает их количество
+ * @param game Указатель на структуру состояния игры
+ * @param[out] lines Указатель для сохранения количества удаленных строк
+ * @return 1 если были удалены строки, 0 если нет
+ */
+int remove_full_lines(GameInfo_t *game, int *lines) {
+  uint64_t mask = clear_lines(game);
+  *lines += __builtin_popcountll(mask);
+  return mask != 0;
 }
 
 /**
  * @brief Сдвигает строки игрового поля вниз начиная с указанной линии
+ * @param game Указатель на структуру состояния игры
  * @param line Номер линии, с которой начинается сдвиг
+ * @details Верхняя строка поля после сдвига становится пустой
  */
-void drop_lines(int line) {
-  GameInfo_t *game = updateCurrentState();
+void drop_lines(GameInfo_t *game, int line) {
   for (int i = line; i > 0; i--) {
-    for (int j = 0; j < WIDTH; j++) {
-      game->field[i][j] = game->field[i - 1][j];
-    }
+    game->rows[BOARD_TOP + i] = game->rows[BOARD_TOP + i - 1];
+    memcpy(game->field[i], game->field[i - 1], sizeof(game->field[i]));
   }
+  game->rows[BOARD_TOP] = ROW_EMPTY_OF(game->width);
+  memset(game->field[0], 0, sizeof(game->field[0]));
+  update_heights(game);
 }
 
 /**
  * @brief Подсчитывает и обновляет счет игрока
- * @details Удаляет заполненные линии и начисляет очки
- * Обновляет рекорд, если текущий счет его превышает
+ * @param game Указатель на структуру состояния игры
+ * @details Удаляет заполненные линии за один проход, начисляет очки и
+ * ведет счетчик удаленных линий.
+ * Обновляет рекорд в памяти, если текущий счет его превышает; к диску
+ * не обращается
  */
-void calculate_score() {
-  GameInfo_t *game = updateCurrentState();
-  int lines = 0;
-  while (remove_full_lines(&lines));
+void calculate_score(GameInfo_t *game) {
+  int lines = __builtin_popcountll(clear_lines(game));
+  game->lines += lines;
   switch (lines) {
     case 1:
       game->score += 100;
@@ -401,50 +720,18 @@ void calculate_score() {
       game->score += 1500;
       break;
   }
-  if (game->score > game->high_score) {
-    game->high_score = game->score;
-    save_max_score(game->high_score);
-  }
+  if (game->score > game->high_score) game->high_score = game->score;
 }
 
 /**
  * @brief Обновляет уровень сложности игры
+ * @param game Указатель на структуру состояния игры
  * @details Уровень повышается каждые 600 очков:
  *          - Увеличивает скорость игры (уменьшает game->speed)
  *          - Максимальный уровень ограничен LEVEL_MAX
  */
-void update_level() {
-  GameInfo_t *game = updateCurrentState();
+void update_level(GameInfo_t *game) {
   game->level = (game->score / 600) + 1;
   if (game->level > LEVEL_MAX) game->level = LEVEL_MAX;
   game->speed = SPEED_MIN - (game->level * 80);
 }
-
-/**
- * @brief Сохраняет рекорд в файл
- * @param high_score Значение рекорда для сохранения
- * @note Файл сохраняется в build/high_score.txt
- */
-void save_max_score(int high_score) {
-  FILE *file = fopen("build/high_score.txt", "w");
-  if (file != NULL) {
-    fprintf(file, "%d", high_score);
-    fclose(file);
-  } else {
-    perror("Error saving high score");
-  }
-}
-
-/**
- * @brief Загружает рекорд из файла
- * @return Загруженное значение рекорда или 0 если файл не существует
- */
-int load_max_score() {
-  int high_score = 0;
-  FILE *file = fopen("build/high_score.txt", "r");
-  if (file != NULL) {
-    fscanf(file, "%d", &high_score);
-    fclose(file);
-  }
-  return high_score;
-}
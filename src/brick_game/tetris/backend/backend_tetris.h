@@ -3,11 +3,16 @@
 
 #include <ncurses.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <time.h>
 
+#include "rng.h"
+
 /**
  * @defgroup game_constants Игровые константы
  * @{
@@ -18,13 +23,53 @@
 #define SPACE_KEY 32
 #define PAUSE_KEY 'p'
 
-/// игровые параметры
+/// игровые параметры: HEIGHT и WIDTH - размеры поля по умолчанию,
+/// размеры конкретной игры задаются TetrisConfig_t и лежат в GameInfo_t
 #define HEIGHT 20
 #define WIDTH 10
+#define HEIGHT_MAX 40  ///< наибольшая высота поля
+#define WIDTH_MAX 16   ///< наибольшая ширина поля
+#define SIZE_MIN 4  ///< наименьшая высота и ширина поля
 #define LEVEL_MAX 10
 #define LEVEL_MIN 1
 #define SPEED_MIN 900
 
+/// параметры битборда: строка поля — 32-битная маска, столбец j — бит
+/// (BOARD_WALL + j); все биты вне поля заняты (стены), под полем пол из
+/// заполненных строк, поэтому проверки наложения не зависят от ширины
+#define BOARD_WALL 3   ///< ширина левой стены (в битах)
+#define BOARD_TOP 4    ///< буферные строки над полем
+#define BOARD_FLOOR 4  ///< строки пола под полем
+#define BOARD_ROWS_MAX (BOARD_TOP + HEIGHT_MAX + BOARD_FLOOR)
+#define ROW_FULL 0xFFFFFFFFu  ///< заполненная строка
+/// клетки поля ширины w
+#define ROW_FIELD_OF(w) (((1u << (w)) - 1) << BOARD_WALL)
+/// пустая строка поля ширины w (только стены)
+#define ROW_EMPTY_OF(w) (ROW_FULL & ~ROW_FIELD_OF(w))
+#define ROW_FIELD ROW_FIELD_OF(WIDTH)  ///< клетки поля ширины WIDTH
+#define ROW_EMPTY ROW_EMPTY_OF(WIDTH)  ///< пустая строка поля ширины WIDTH
+#define GAME_CACHE_LINE 64  ///< строка кэша, по которой выровнена GameInfo_t
+
+/// флаги экземпляра игры (TetrisConfig_t.flags)
+#define GAME_VIRTUAL_CLOCK 1  ///< время игры задается tetris_advance_clock()
+#define GAME_NO_PERSIST 2  ///< результат игры не идет в таблицу рекордов
+
+/// способы выбора следующей фигуры (TetrisConfig_t.randomizer)
+#define RANDOMIZER_UNIFORM 0  ///< каждая фигура выбирается независимо
+#define RANDOMIZER_BAG 1  ///< фигуры выдаются перемешанными семерками
+
+/// номера фигур в таблице фигур (0 - пустая фигура)
+#define FIGURE_NONE 0
+#define FIGURE_I 1
+#define FIGURE_O 2
+#define FIGURE_L 3
+#define FIGURE_J 4
+#define FIGURE_S 5
+#define FIGURE_T 6
+#define FIGURE_Z 7
+#define FIGURES_COUNT 7
+#define FIGURE_KICKS_MAX 4
+
 /// кастомные цвета фигур
 #define COLOR_ORANGE 8
 #define COLOR_CUSTOM_YELLOW 9
@@ -48,17 +93,59 @@ typedef enum {
   EXIT_STATE  ///< Выход из игры
 } GameState_t;
 
+/**
+ * @struct FigureShape
+ * @brief Один поворот фигуры в таблице фигур
+ */
+typedef struct {
+  uint8_t mask[4];  ///< Маски строк матрицы 4x4 (бит j — столбец j)
+  int8_t top, bottom;  ///< Первая и последняя занятые строки матрицы
+  int8_t left, right;  ///< Первый и последний занятые столбцы матрицы
+  int8_t rows, cols;  ///< Размер области поворота фигуры
+  int8_t profile[4];  ///< Нижняя занятая строка столбца (-1 - пустой)
+} FigureShape;
+
+/**
+ * @struct FigureInfo
+ * @brief Описание фигуры: все повороты, смещения у стен и параметры появления
+ */
+typedef struct {
+  FigureShape shapes[4];  ///< Повороты по часовой стрелке
+  int8_t kicks[FIGURE_KICKS_MAX];  ///< Смещения по X, пробуемые при повороте
+  int8_t kicks_count;  ///< Количество смещений
+  int8_t rotations;  ///< Количество различных поворотов
+  int8_t spawn_y;  ///< Y-координата появления фигуры
+  char type;       ///< Тип фигуры (I, J, L, O, S, T, Z)
+  int color;       ///< Цвет клеток фигуры
+} FigureInfo;
+
 /**
  * @struct Tetramino
  * @brief Структура, описывающая фигуру тетриса
+ * @details Форма фигуры (маски строк, размер области поворота), тип и цвет
+ * берутся из таблицы фигур по номеру и повороту, поэтому фигура занимает
+ * 4 байта.
  */
 typedef struct {
-  int view[4][4];  ///< Матрица 4x4, представляющая форму фигуры
-  int x, y;   ///< X и Y -координаты фигуры на поле
-  char type;  ///< Тип фигуры (I, J, L, O, S, T, Z)
-  int rows, cols;  ///< Количество строк и столбцов в фигуре
+  int8_t x, y;  ///< X и Y -координаты фигуры на поле
+  int8_t id;    ///< Номер фигуры в таблице фигур
+  int8_t rotation;  ///< Номер текущего поворота фигуры
 } Tetramino;
 
+/**
+ * @struct BoardFeatures_t
+ * @brief Признаки поля для оценки положений фигуры
+ */
+typedef struct {
+  int aggregate_height;  ///< Сумма высот столбцов
+  int holes;             ///< Пустые клетки под занятыми
+  int bumpiness;  ///< Сумма разностей высот соседних столбцов
+  int row_transitions;  ///< Смены занятости вдоль строк (со стенами)
+  int column_transitions;  ///< Смены занятости вдоль столбцов (с полом)
+  int wells;  ///< Открытые клетки, зажатые с двух сторон
+  int max_height;  ///< Высота самого высокого столбца
+} BoardFeatures_t;
+
 /**
  * @enum UserAction_t
  * @brief Действия пользователя
@@ -77,20 +164,111 @@ typedef enum {
 /**
  * @struct GameInfo_t
  * @brief Полное состояние игры
+ * @details Поля до high_score - горячая часть: все, от чего зависит ход
+ * игры, без указателей. Снимок (GameSnapshot_t) хранит из нее только то,
+ * что нельзя вычислить заново. Рекорд и цветовой слой поля нужны только
+ * для отрисовки, а момент входа в состояние - только статистике автомата;
+ * они лежат после нее.
+ *
+ * Структура выровнена по строке кэша, и все, что шаг автомата читает
+ * кроме поля, лежит в первой строке; за ней идут генератор, высоты
+ * столбцов и битборд. Размеры поля задаются при создании игры; массивы
+ * рассчитаны на наибольшее поле, игра использует их начало. Пауза
+ * определяется состоянием PAUSE, отдельного флага нет.
  */
 typedef struct {
-  int field[HEIGHT][WIDTH];  ///< Игровое поле
-  Tetramino next;            ///< Следующая фигура
-  Tetramino current;         ///< Текущая фигура
-  int score;                 ///< Текущий счет
-  int high_score;            ///< Рекордный счет
-  int level;                 ///< Текущий уровень
-  int speed;                 ///< Текущая скорость (в мс)
-  int pause;                 ///< Флаг паузы (1 - пауза)
-  long long timer;  ///< Таймер для автоматического смещения
+  _Alignas(GAME_CACHE_LINE) long long timer;  ///< Таймер гравитации
+  long long clock;  ///< Виртуальное время в мс (при GAME_VIRTUAL_CLOCK)
   GameState_t state;  ///< Текущее состояние игры
+  Tetramino current;  ///< Текущая фигура
+  Tetramino next;     ///< Следующая фигура
+  int speed;          ///< Текущая скорость (в мс)
+  int score;          ///< Текущий счет
+  int level;          ///< Текущий уровень
+  int lines;          ///< Удалено линий за игру
+  int pieces;         ///< Выпущено фигур за игру
+  uint8_t flags;  ///< Флаги экземпляра (GAME_VIRTUAL_CLOCK, ...)
+  uint8_t randomizer;  ///< Способ выбора фигур (RANDOMIZER_UNIFORM, ...)
+  uint8_t bag_left;  ///< Количество фигур в семерке
+  uint8_t bag[FIGURES_COUNT];  ///< Оставшиеся фигуры текущей семерки
+  uint8_t height;  ///< Высота поля
+  uint8_t width;   ///< Ширина поля
+  uint64_t cleared_rows;  ///< Маска строк, удаленных последним сбросом
+  Rng_t rng;  ///< Генератор фигур этой игры
+  uint8_t heights[WIDTH_MAX];  ///< Высота столбцов (0 - пустой столбец)
+  uint32_t rows[BOARD_ROWS_MAX];  ///< Битборд занятости со стенами и полом
+  int high_score;  ///< Рекордный счет (не входит в снимок)
+  uint8_t field[HEIGHT_MAX][WIDTH_MAX];  ///< Цвета клеток (см. field_color())
+  uint64_t state_since;  ///< Вход в состояние state (нс, см. FsmStats_t)
 } GameInfo_t;
 
+/**
+ * @struct GameSnapshot_t
+ * @brief Снимок состояния игры для поиска и ключевых кадров
+ * @details Хранит только то, что нельзя восстановить: счетчики, фигуры,
+ * семерку, генератор, таймеры и строки поля 16-битными масками без стен.
+ * Стены, пол, высоты столбцов и маска последнего сброса строятся заново
+ * при восстановлении. Снимок не содержит указателей и дыр выравнивания,
+ * поэтому его можно копировать, сравнивать побайтно, хранить в файле той
+ * же сборки и восстанавливать в любой экземпляр с теми же параметрами.
+ * Значимы первые GAME_SNAPSHOT_SIZE_OF(высота поля) байт.
+ * @note Снимок - не копия памяти GameInfo_t: поля переносятся по одному,
+ * а строки сжимаются и разжимаются. Так снимок поля 20x10 занимает 108
+ * байт вместо 296 байт префикса GameInfo_t, зато восстановление
+ * пересчитывает стены и высоты столбцов. Цену обоих вариантов показывают
+ * случаи tetris_snapshot, tetris_restore и game_copy в tetris_bench.
+ */
+typedef struct {
+  int64_t timer;       ///< Таймер гравитации
+  int64_t clock;       ///< Виртуальное время в мс
+  Rng_t rng;           ///< Генератор фигур
+  int32_t score;       ///< Счет
+  int32_t lines;       ///< Удалено линий за игру
+  int32_t pieces;      ///< Выпущено фигур за игру
+  uint16_t speed;      ///< Скорость (в мс)
+  Tetramino current;   ///< Текущая фигура
+  Tetramino next;      ///< Следующая фигура
+  uint8_t state;       ///< Состояние автомата
+  uint8_t level;       ///< Уровень
+  uint8_t randomizer;  ///< Способ выбора фигур
+  uint8_t bag_left;    ///< Количество фигур в семерке
+  uint8_t bag[FIGURES_COUNT];  ///< Оставшиеся фигуры семерки
+  uint8_t height;    ///< Высота поля
+  uint8_t width;     ///< Ширина поля
+  uint8_t reserved;  ///< Выравнивание строк (всегда 0)
+  uint16_t rows[HEIGHT_MAX];  ///< Строки поля: бит j - столбец j
+} GameSnapshot_t;
+
+/// размер буфера снимка состояния
+#define GAME_SNAPSHOT_SIZE sizeof(GameSnapshot_t)
+/// значимая часть снимка игры с полем высоты h
+#define GAME_SNAPSHOT_SIZE_OF(h) \
+  (offsetof(GameSnapshot_t, rows) + sizeof(uint16_t) * (h))
+
+_Static_assert(offsetof(GameInfo_t, cleared_rows) <= GAME_CACHE_LINE,
+               "управляющие поля GameInfo_t должны умещаться в строку кэша");
+_Static_assert(offsetof(GameSnapshot_t, rows) ==
+                   offsetof(GameSnapshot_t, reserved) + 1,
+               "в снимке не должно быть дыр выравнивания");
+_Static_assert(GAME_SNAPSHOT_SIZE_OF(HEIGHT) <= 112,
+               "снимок поля по умолчанию должен занимать около сотни байт");
+_Static_assert(WIDTH_MAX <= 16, "строка снимка - 16 бит");
+_Static_assert(BOARD_WALL + WIDTH_MAX < 32,
+               "строка поля со стенами должна умещаться в 32 бита");
+_Static_assert(HEIGHT_MAX <= 64, "маска удаленных строк - 64 бита");
+
+/**
+ * @struct TetrisConfig_t
+ * @brief Параметры создания экземпляра игры
+ */
+typedef struct {
+  int flags;  ///< Флаги экземпляра (GAME_VIRTUAL_CLOCK, GAME_NO_PERSIST)
+  uint64_t seed;  ///< Начальное значение генератора фигур
+  int randomizer;  ///< Способ выбора фигур (RANDOMIZER_UNIFORM, ...)
+  int height;  ///< Высота поля (0 - HEIGHT)
+  int width;   ///< Ширина поля (0 - WIDTH)
+} TetrisConfig_t;
+
 /** @} */  // Конец группы backend_api
 
 /**
@@ -100,6 +278,15 @@ typedef struct {
  * @{
  */
 
+// Создание, шаг и удаление экземпляра игры
+GameInfo_t *tetris_create(const TetrisConfig_t *config);
+int tetris_size_valid(int height, int width);
+void tetris_step(GameInfo_t *game, UserAction_t action);
+void tetris_advance_clock(GameInfo_t *game, long long ms);
+void tetris_destroy(GameInfo_t *game);
+void tetris_snapshot(const GameInfo_t *game, GameSnapshot_t *snapshot);
+void tetris_restore(GameInfo_t *game, const GameSnapshot_t *snapshot);
+
 // Основные игровые функции
 GameInfo_t *updateCurrentState();
 UserAction_t get_action(int user_input);
@@ -116,22 +303,32 @@ void gameover_state_actions(GameInfo_t *game, UserAction_t action);
 
 // Вспомогательные функции
 void game_init(GameInfo_t *game);
-void reset_field();
+void reset_field(GameInfo_t *game);
+void set_field_cell(GameInfo_t *game, int y, int x, int color);
+int field_color(const GameInfo_t *game, int y, int x);
+void update_heights(GameInfo_t *game);
 long long int get_current_time();
+long long int monotonic_time();
+long long int game_time(const GameInfo_t *game);
 
 // Функции коллизий
-int collision();
-int check_figure_overlay();
-int check_leaving_field();
+int figure_overlay(const GameInfo_t *game, const Tetramino *figure);
+int collision(const GameInfo_t *game);
+void board_features(const uint32_t *rows, int height, int width,
+                    BoardFeatures_t *features);
+void board_features_batch(const uint32_t (*boards)[BOARD_ROWS_MAX], int count,
+                          int height, int width, BoardFeatures_t *features);
+int check_figure_overlay(const GameInfo_t *game);
+int check_leaving_field(const GameInfo_t *game);
+int landing_y(const GameInfo_t *game, const Tetramino *figure);
 
 // Функции работы с полем
-int remove_full_lines(int *lines);
-void drop_lines(int line);
+uint64_t clear_lines(GameInfo_t *game);
+int remove_full_lines(GameInfo_t *game, int *lines);
+void drop_lines(GameInfo_t *game, int line);
 
 // Функции счета и уровней
-void calculate_score();
-void update_level();
-void save_max_score(int high_score);
-int load_max_score();
+void calculate_score(GameInfo_t *game);
+void update_level(GameInfo_t *game);
 
 #endif  // BACKEND_TETRIS_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "channel.h"
+
+/**
+ * @brief Подготавливает пустой канал
+ * @param[out] channel Канал
+ * @note Вызывается до запуска потоков, которые работают с каналом
+ */
+void channel_init(FrameChannel_t *channel) {
+  memset(channel->frames, 0, sizeof(channel->frames));
+  channel->front = 0;
+  atomic_init(&channel->middle, 1);
+  channel->back = 2;
+}
+
+/**
+ * @brief Публикует новый кадр (только поток-производитель)
+ * @param channel Канал
+ * @param game Состояние игры, копируемое в кадр
+ * @details Непрочитанный прошлый кадр заменяется: потребителю нужен только
+ * последний
+ */
+void channel_publish(FrameChannel_t *channel, const GameInfo_t *game) {
+  memcpy(&channel->frames[channel->back], game, sizeof(GameInfo_t));
+  unsigned old = atomic_exchange_explicit(
+      &channel->middle, channel->back | CHANNEL_FRESH, memory_order_acq_rel);
+  channel->back = old & ~CHANNEL_FRESH;
+}
+
+/**
+ * @brief Возвращает последний опубликованный кадр (только потребитель)
+ * @param channel Канал
+ * @param[out] fresh true, если кадр новый с прошлого вызова
+ * @return Кадр; он не меняется до следующего вызова channel_latest().
+ *         До первой публикации - обнуленное состояние.
+ */
+const GameInfo_t *channel_latest(FrameChannel_t *channel, bool *fresh) {
+  *fresh = atomic_load_explicit(&channel->middle, memory_order_relaxed) &
+           CHANNEL_FRESH;
+  if (*fresh) {
+    unsigned old = atomic_exchange_explicit(&channel->middle, channel->front,
+                                            memory_order_acq_rel);
+    channel->front = old & ~CHANNEL_FRESH;
+  }
+  return &channel->frames[channel->front];
+}
@@ -0,0 +1,32 @@
+#ifndef CHANNEL_TETRIS_H
+#define CHANNEL_TETRIS_H
+
+#include <stdatomic.h>
+
+#include "backend_tetris.h"
+
+#define CHANNEL_FRESH 4  ///< в среднем кадре лежит еще не прочитанный кадр
+
+/**
+ * @struct FrameChannel_t
+ * @brief Тройной буфер кадров между потоком симуляции и отрисовки
+ * @details Производитель пишет кадр в свой задний буфер и одним обменом
+ * делает его средним; потребитель, если средний кадр свежий, обменом
+ * забирает его в передний. Ни один поток не ждет другой: производитель
+ * всегда пишет, а потребитель получает последний опубликованный кадр,
+ * пропуская промежуточные. Кадр - полная копия GameInfo_t, поэтому
+ * отрисовка работает с ним как с игрой.
+ */
+typedef struct {
+  GameInfo_t frames[3];  ///< Буферы кадров
+  /// Номер среднего буфера и флаг CHANNEL_FRESH
+  _Alignas(GAME_CACHE_LINE) _Atomic unsigned middle;
+  _Alignas(GAME_CACHE_LINE) unsigned back;  ///< Буфер производителя
+  _Alignas(GAME_CACHE_LINE) unsigned front;  ///< Буфер потребителя
+} FrameChannel_t;
+
+void channel_init(FrameChannel_t *channel);
+void channel_publish(FrameChannel_t *channel, const GameInfo_t *game);
+const GameInfo_t *channel_latest(FrameChannel_t *channel, bool *fresh);
+
+#endif  // CHANNEL_TETRIS_H
@@ -0,0 +1,298 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "corpus.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Дописывает данные в файл корпуса
+ * @param writer Состояние построения
+ * @param data Данные
+ * @param size Размер данных
+ */
+static void corpus_write(CorpusWriter_t *writer, const void *data,
+                         size_t size) {
+  if (!writer->error && size > 0 && fwrite(data, 1, size, writer->file) != size)
+    writer->error = 1;
+  writer->offset += size;
+}
+
+/**
+ * @brief Дополняет файл корпуса нулями до границы CORPUS_ALIGN
+ * @param writer Состояние построения
+ */
+static void corpus_pad(CorpusWriter_t *writer) {
+  static const uint8_t zeros[CORPUS_ALIGN] = {0};
+  size_t tail = writer->offset % CORPUS_ALIGN;
+  if (tail != 0) corpus_write(writer, zeros, CORPUS_ALIGN - tail);
+}
+
+/**
+ * @brief Создает файл корпуса
+ * @param path Путь к файлу (перезаписывается)
+ * @param keyframe_pieces Фигур между ключевыми кадрами (0 - без кадров)
+ * @return Состояние построения или NULL при ошибке
+ */
+CorpusWriter_t *corpus_writer_open(const char *path,
+                                   uint32_t keyframe_pieces) {
+  CorpusWriter_t *writer = calloc(1, sizeof(CorpusWriter_t));
+  if (writer != NULL) {
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+      free(writer);
+      writer = NULL;
+    }
+  }
+  if (writer != NULL) {
+    CorpusHeader_t header = {.version = CORPUS_VERSION,
+                             .keyframe_pieces = keyframe_pieces,
+                             .state_size = GAME_SNAPSHOT_SIZE};
+    memcpy(header.magic, CORPUS_MAGIC, 4);
+    writer->keyframe_pieces = keyframe_pieces;
+    corpus_write(writer, &header, sizeof(header));
+    corpus_pad(writer);
+  }
+  return writer;
+}
+
+/**
+ * @brief Добавляет игру в корпус
+ * @param writer Состояние построения
+ * @param replay Запись игры (см. ReplayReader_t)
+ * @param size Размер записи
+ * @return 0 при успехе, 1 - данные не являются записью или ошибка записи
+ * @details Запись проигрывается, и после каждой keyframe_pieces-й
+ * выпущенной фигуры в файл пишется ключевой кадр. Фигуры считаются от
+ * начала записи, а не по game->pieces, поэтому партии после рестарта
+ * (Start в GAMEOVER) получают свои кадры. Кадры игры лежат сразу за ее
+ * записью.
+ */
+int corpus_add(CorpusWriter_t *writer, const uint8_t *replay, size_t size) {
+  ReplayReader_t reader;
+  GameInfo_t *game = NULL;
+  CorpusGame_t entry = {0};
+  int status = 1;
+  if (writer->count == writer->capacity) {
+    uint64_t capacity = writer->capacity > 0 ? writer->capacity * 2 : 1024;
+    CorpusGame_t *grown =
+        realloc(writer->games, sizeof(CorpusGame_t) * capacity);
+    if (grown != NULL) {
+      writer->games = grown;
+      writer->capacity = capacity;
+    }
+  }
+  if (writer->count < writer->capacity &&
+      replay_reader_init(&reader, replay, size) == 0) {
+    reader.config.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST;
+    game = tetris_create(&reader.config);
+  }
+  if (game != NULL) {
+    entry.replay_offset = writer->offset;
+    entry.replay_size = size;
+    corpus_write(writer, replay, size);
+    corpus_pad(writer);
+    entry.keyframes_offset = writer->offset;
+    int pieces = game->pieces;
+    uint64_t issued = 0;
+    while (replay_step(game, &reader)) {
+      entry.steps++;
+      if (game->pieces != pieces) issued++;
+      if (writer->keyframe_pieces > 0 && game->pieces != pieces &&
+          issued % writer->keyframe_pieces == 0) {
+        CorpusKeyframe_t keyframe;
+        memset(&keyframe, 0, sizeof(keyframe));
+        keyframe.step = entry.steps;
+        keyframe.pos = reader.pos;
+        keyframe.time = reader.time;
+        tetris_snapshot(game, &keyframe.state);
+        corpus_write(writer, &keyframe, sizeof(keyframe));
+        entry.keyframes++;
+      }
+      pieces = game->pieces;
+    }
+    entry.score = game->score;
+    entry.lines = game->lines;
+    entry.pieces = game->pieces;
+    writer->games[writer->count++] = entry;
+    tetris_destroy(game);
+    status = writer->error;
+  }
+  return status;
+}
+
+/**
+ * @brief Дописывает индекс и окончание корпуса и закрывает файл
+ * @param writer Состояние построения (может быть NULL)
+ * @return 0 при успехе, 1 - корпус не записан целиком
+ */
+int corpus_writer_close(CorpusWriter_t *writer) {
+  int status = 0;
+  if (writer != NULL) {
+    CorpusFooter_t footer = {.games = writer->count,
+                             .version = CORPUS_VERSION};
+    memcpy(footer.magic, CORPUS_MAGIC, 4);
+    corpus_pad(writer);
+    footer.index_offset = writer->offset;
+    corpus_write(writer, writer->games, sizeof(CorpusGame_t) * writer->count);
+    corpus_write(writer, &footer, sizeof(footer));
+    if (fclose(writer->file) != 0) writer->error = 1;
+    status = writer->error;
+    free(writer->games);
+    free(writer);
+  }
+  return status;
+}
+
+/**
+ * @brief Отображает корпус в память
+ * @param path Путь к файлу корпуса
+ * @return Корпус или NULL, если файл не прочитан, не является корпусом
+ *         или собран программой с другим снимком состояния
+ */
+Corpus_t *corpus_open(const char *path) {
+  Corpus_t *corpus = NULL;
+  struct stat info;
+  int fd = open(path, O_RDONLY);
+  if (fd >= 0 && fstat(fd, &info) == 0 &&
+      (size_t)info.st_size >= CORPUS_ALIGN + sizeof(CorpusFooter_t)) {
+    void *base = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base != MAP_FAILED) corpus = calloc(1, sizeof(Corpus_t));
+    if (corpus != NULL) {
+      corpus->base = base;
+      corpus->size = info.st_size;
+    } else if (base != MAP_FAILED) {
+      munmap(base, info.st_size);
+    }
+  }
+  if (fd >= 0) close(fd);
+  if (corpus != NULL) {
+    const CorpusHeader_t *header = (const CorpusHeader_t *)corpus->base;
+    const CorpusFooter_t *footer =
+        (const CorpusFooter_t *)(corpus->base + corpus->size -
+                                 sizeof(CorpusFooter_t));
+    uint64_t index_end = corpus->size - sizeof(CorpusFooter_t);
+    if (memcmp(header->magic, CORPUS_MAGIC, 4) == 0 &&
+        header->version == CORPUS_VERSION &&
+        header->state_size == GAME_SNAPSHOT_SIZE &&
+        memcmp(footer->magic, CORPUS_MAGIC, 4) == 0 &&
+        footer->version == CORPUS_VERSION &&
+        footer->index_offset % CORPUS_ALIGN == 0 &&
+        footer->index_offset <= index_end &&
+        footer->games <=
+            (index_end - footer->index_offset) / sizeof(CorpusGame_t)) {
+      corpus->header = header;
+      corpus->games =
+          (const CorpusGame_t *)(corpus->base + footer->index_offset);
+      corpus->count = footer->games;
+    } else {
+      corpus_close(corpus);
+      corpus = NULL;
+    }
+  }
+  return corpus;
+}
+
+/**
+ * @brief Снимает отображение корпуса
+ * @param corpus Корпус (может быть NULL)
+ */
+void corpus_close(Corpus_t *corpus) {
+  if (corpus != NULL) {
+    munmap((void *)corpus->base, corpus->size);
+    free(corpus);
+  }
+}
+
+/**
+ * @brief Начинает чтение записи игры прямо из отображения
+ * @param corpus Корпус
+ * @param game Номер игры
+ * @param[out] reader Состояние чтения
+ * @return 0 при успехе, 1 - нет такой игры или запись повреждена
+ */
+int corpus_replay(const Corpus_t *corpus, uint64_t game,
+                  ReplayReader_t *reader) {
+  int status = 1;
+  if (game < corpus->count) {
+    const CorpusGame_t *entry = &corpus->games[game];
+    if (entry->replay_offset <= corpus->size &&
+        entry->replay_size <= corpus->size - entry->replay_offset)
+      status = replay_reader_init(reader, corpus->base + entry->replay_offset,
+                                  entry->replay_size);
+  }
+  return status;
+}
+
+/**
+ * @brief Возвращает ключевые кадры игры
+ * @param corpus Корпус
+ * @param game Номер игры
+ * @return Массив из corpus->games[game].keyframes кадров в отображении
+ *         или NULL, если кадров нет
+ */
+const CorpusKeyframe_t *corpus_keyframes(const Corpus_t *corpus,
+                                         uint64_t game) {
+  const CorpusKeyframe_t *keyframes = NULL;
+  if (game < corpus->count) {
+    const CorpusGame_t *entry = &corpus->games[game];
+    uint64_t offset = entry->keyframes_offset;
+    if (entry->keyframes > 0 && offset % CORPUS_ALIGN == 0 &&
+        offset <= corpus->size &&
+        entry->keyframes <=
+            (corpus->size - offset) / sizeof(CorpusKeyframe_t))
+      keyframes = (const CorpusKeyframe_t *)(corpus->base + offset);
+  }
+  return keyframes;
+}
+
+/**
+ * @brief Восстанавливает игру после заданного шага записи
+ * @param corpus Корпус
+ * @param game Номер игры
+ * @param step Количество шагов автомата от начала записи
+ * @param[out] reader Чтение записи, продолжающее с найденного места
+ * @return Состояние игры (освобождается tetris_destroy()) или NULL, если
+ *         нет такой игры. Если запись короче, возвращается ее последнее
+ *         состояние.
+ * @details Двоичным поиском берет последний ключевой кадр не дальше
+ * нужного шага и доигрывает остаток записи, так что проигрывается не
+ * больше keyframe_pieces фигур. Номер шага однозначен и в записи с
+ * несколькими партиями. Цветовой слой поля не восстанавливается.
+ */
+GameInfo_t *corpus_seek(const Corpus_t *corpus, uint64_t game,
+                        uint64_t step, ReplayReader_t *reader) {
+  GameInfo_t *state = NULL;
+  if (corpus_replay(corpus, game, reader) == 0) {
+    reader->config.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST;
+    state = tetris_create(&reader->config);
+  }
+  if (state != NULL) {
+    const CorpusKeyframe_t *keyframes = corpus_keyframes(corpus, game);
+    uint64_t low = 0;
+    uint64_t high = keyframes != NULL ? corpus->games[game].keyframes : 0;
+    while (low < high) {
+      uint64_t middle = low + (high - low) / 2;
+      if (keyframes[middle].step <= step)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    uint64_t done = 0;
+    if (low > 0) {
+      const CorpusKeyframe_t *keyframe = &keyframes[low - 1];
+      tetris_restore(state, &keyframe->state);
+      reader->pos = keyframe->pos;
+      reader->time = keyframe->time;
+      done = keyframe->step;
+    }
+    int stepping = 1;
+    while (stepping && done < step) {
+      stepping = replay_step(state, reader);
+      done++;
+    }
+  }
+  return state;
+}
@@ -0,0 +1,106 @@
+#ifndef CORPUS_TETRIS_H
+#define CORPUS_TETRIS_H
+
+#include "backend_tetris.h"
+#include "replay.h"
+
+#define CORPUS_MAGIC "TCRP"  ///< сигнатура файла корпуса
+#define CORPUS_VERSION 5     ///< версия формата корпуса
+#define CORPUS_ALIGN 64  ///< выравнивание разделов корпуса
+#define CORPUS_KEYFRAME_PIECES 16  ///< фигур между ключевыми кадрами
+
+/**
+ * @struct CorpusHeader_t
+ * @brief Заголовок корпуса (в начале файла)
+ */
+typedef struct {
+  char magic[4];     ///< CORPUS_MAGIC
+  uint32_t version;  ///< CORPUS_VERSION
+  uint32_t keyframe_pieces;  ///< Фигур между ключевыми кадрами
+  uint32_t state_size;  ///< GAME_SNAPSHOT_SIZE собравшей программы
+} CorpusHeader_t;
+
+/**
+ * @struct CorpusGame_t
+ * @brief Запись индекса об одной игре
+ */
+typedef struct {
+  uint64_t replay_offset;  ///< Смещение записи игры в файле
+  uint64_t replay_size;  ///< Размер записи игры
+  uint64_t keyframes_offset;  ///< Смещение ключевых кадров игры
+  uint64_t steps;      ///< Шагов автомата в записи
+  uint32_t keyframes;  ///< Количество ключевых кадров
+  int32_t score;       ///< Итоговый счет
+  int32_t lines;       ///< Удалено линий
+  int32_t pieces;      ///< Выпущено фигур
+} CorpusGame_t;
+
+/**
+ * @struct CorpusKeyframe_t
+ * @brief Ключевой кадр: снимок игры и место в записи, где он снят
+ * @details Кадры упорядочены по step: номер фигуры внутри записи не
+ * однозначен, потому что после рестарта (Start в GAMEOVER) счет фигур
+ * начинается заново
+ */
+typedef struct {
+  uint64_t step;  ///< Шагов автомата выполнено от начала записи
+  uint64_t pos;  ///< Позиция следующего шага в записи игры
+  int64_t time;  ///< Время последнего выполненного шага
+  GameSnapshot_t state;  ///< Снимок игры после этого шага
+} CorpusKeyframe_t;
+
+/**
+ * @struct CorpusFooter_t
+ * @brief Окончание корпуса (последние байты файла)
+ */
+typedef struct {
+  uint64_t index_offset;  ///< Смещение индекса (массива CorpusGame_t)
+  uint64_t games;    ///< Количество игр
+  uint32_t version;  ///< CORPUS_VERSION
+  char magic[4];     ///< CORPUS_MAGIC
+} CorpusFooter_t;
+
+/**
+ * @struct CorpusWriter_t
+ * @brief Построение корпуса
+ * @details Записи игр и их ключевые кадры пишутся в файл по мере
+ * добавления, в памяти остается только индекс
+ */
+typedef struct {
+  FILE *file;       ///< Файл корпуса
+  uint64_t offset;  ///< Текущий размер файла
+  uint32_t keyframe_pieces;  ///< Фигур между ключевыми кадрами
+  CorpusGame_t *games;  ///< Индекс
+  uint64_t count;       ///< Игр в индексе
+  uint64_t capacity;    ///< Емкость индекса
+  int error;  ///< Была ошибка записи или нехватка памяти
+} CorpusWriter_t;
+
+/**
+ * @struct Corpus_t
+ * @brief Корпус, отображенный в память только для чтения
+ * @details Все указатели ведут прямо в отображение: записи и кадры не
+ * копируются, и разные потоки могут читать один корпус одновременно
+ */
+typedef struct {
+  const uint8_t *base;           ///< Начало отображения
+  size_t size;                   ///< Размер файла
+  const CorpusHeader_t *header;  ///< Заголовок
+  const CorpusGame_t *games;     ///< Индекс
+  uint64_t count;                ///< Количество игр
+} Corpus_t;
+
+CorpusWriter_t *corpus_writer_open(const char *path, uint32_t keyframe_pieces);
+int corpus_add(CorpusWriter_t *writer, const uint8_t *replay, size_t size);
+int corpus_writer_close(CorpusWriter_t *writer);
+
+Corpus_t *corpus_open(const char *path);
+void corpus_close(Corpus_t *corpus);
+int corpus_replay(const Corpus_t *corpus, uint64_t game,
+                  ReplayReader_t *reader);
+const CorpusKeyframe_t *corpus_keyframes(const Corpus_t *corpus,
+                                         uint64_t game);
+GameInfo_t *corpus_seek(const Corpus_t *corpus, uint64_t game,
+                        uint64_t step, ReplayReader_t *reader);
+
+#endif  // CORPUS_TETRIS_H
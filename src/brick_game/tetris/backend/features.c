@@ -0,0 +1,187 @@
+#include "backend_tetris.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define FEATURES_X86 1
+#endif
+
+/// Пары соседних столбцов поля ширины w (бит j - столбцы j и j + 1)
+#define PAIRS_FIELD_OF(w) (((1u << ((w) - 1)) - 1) << BOARD_WALL)
+/// Пары соседних клеток строки поля ширины w от левой стены до правой
+#define PAIRS_ROW_OF(w) (((1u << ((w) + 1)) - 1) << (BOARD_WALL - 1))
+/// Наибольшая ширина поля, строка которого со стенами умещается в 16 бит
+#define FEATURES_NARROW_MAX (16 - BOARD_WALL - 1)
+
+/**
+ * @brief Ядро board_features() для заданных размеров поля
+ * @details Всегда встраивается: вызов с константными размерами дает
+ *          отдельную копию с масками и границей цикла, известными при
+ *          компиляции
+ */
+static inline __attribute__((always_inline)) void features_kernel(
+    const uint32_t *rows, int height, int width, BoardFeatures_t *features) {
+  const uint32_t field = ROW_FIELD_OF(width);
+  const uint32_t pairs_field = PAIRS_FIELD_OF(width);
+  const uint32_t pairs_row = PAIRS_ROW_OF(width);
+  BoardFeatures_t result = {0};
+  uint32_t seen = 0;
+  uint32_t above = rows[BOARD_TOP - 1];
+  for (int i = BOARD_TOP; i < BOARD_TOP + height; i++) {
+    uint32_t row = rows[i];
+    uint32_t cells = row & field;
+    result.holes += __builtin_popcount(seen & ~cells);
+    result.column_transitions += __builtin_popcount((row ^ above) & field);
+    result.wells += __builtin_popcount(~row & (row << 1) & (row >> 1) &
+                                       ~seen & field);
+    seen |= cells;
+    result.aggregate_height += __builtin_popcount(seen);
+    result.max_height += seen != 0;
+    result.bumpiness += __builtin_popcount((seen ^ (seen >> 1)) & pairs_field);
+    result.row_transitions +=
+        __builtin_popcount((row ^ (row >> 1)) & pairs_row);
+    above = row;
+  }
+  result.column_transitions +=
+      __builtin_popcount((rows[BOARD_TOP + height] ^ above) & field);
+  *features = result;
+}
+
+/**
+ * @brief Вычисляет признаки поля для оценки положений
+ * @param rows Битборд поля из BOARD_ROWS_MAX строк (как GameInfo_t.rows)
+ * @param height Высота поля
+ * @param width Ширина поля
+ * @param[out] features Признаки поля
+ * @details Все признаки считаются по строкам битборда одним проходом
+ *          сверху вниз: маска seen накапливает столбцы, уже встреченные
+ *          занятыми, поэтому высоты, дыры и неровность получаются подсчетом
+ *          битов без массива высот. Стены и пол считаются занятыми. Для поля
+ *          HEIGHT x WIDTH используется копия ядра с постоянными размерами.
+ */
+void board_features(const uint32_t *rows, int height, int width,
+                    BoardFeatures_t *features) {
+  if (height == HEIGHT && width == WIDTH)
+    features_kernel(rows, HEIGHT, WIDTH, features);
+  else
+    features_kernel(rows, height, width, features);
+}
+
+#ifdef FEATURES_X86
+
+/**
+ * @brief Векторные операции ядра признаков
+ * @details Ядро ниже разворачивается для SSE2 (8 полей за проход) и AVX2
+ *          (16 полей): в каждой 16-битной дорожке лежит строка своего поля,
+ *          биты считаются параллельным подсчетом внутри дорожки. Строки
+ *          сужаются до 16 бит при раскладке по дорожкам, поэтому ядро
+ *          работает для полей не шире FEATURES_NARROW_MAX. NAME##_rows
+ *          встраивается, и NAME вызывает его с постоянными размерами для
+ *          поля HEIGHT x WIDTH.
+ */
+#define FEATURES_KERNEL(NAME, LANES, VEC, SET1, LOADU, STOREU, AND, ANDNOT, \
+                        OR, XOR, ADD, SUB, SRLI, SLLI, CMPEQ)               \
+  static VEC NAME##_popcount(VEC v) {                                       \
+    v = SUB(v, AND(SRLI(v, 1), SET1(0x5555)));                              \
+    v = ADD(AND(v, SET1(0x3333)), AND(SRLI(v, 2), SET1(0x3333)));           \
+    v = AND(ADD(v, SRLI(v, 4)), SET1(0x0f0f));                              \
+    return AND(ADD(v, SRLI(v, 8)), SET1(0x001f));                           \
+  }                                                                         \
+                                                                            \
+  static inline __attribute__((always_inline)) void NAME##_rows(            \
+      const uint32_t (*boards)[BOARD_ROWS_MAX], int height, int width,      \
+      BoardFeatures_t *features) {                                          \
+    uint16_t lanes[BOARD_ROWS_MAX][LANES];                                  \
+    for (int b = 0; b < LANES; b++)                                         \
+      for (int i = BOARD_TOP - 1; i <= BOARD_TOP + height; i++)             \
+        lanes[i][b] = (uint16_t)boards[b][i];                               \
+    const VEC field = SET1((short)ROW_FIELD_OF(width)), one = SET1(1);      \
+    const VEC pairs_field = SET1((short)PAIRS_FIELD_OF(width));             \
+    const VEC pairs_row = SET1((short)PAIRS_ROW_OF(width)), zero = SET1(0); \
+    VEC seen = zero, holes = zero, column = zero, wells = zero;             \
+    VEC height_sum = zero, max_height = zero, bump = zero, row_tr = zero;   \
+    VEC above = LOADU((const VEC *)lanes[BOARD_TOP - 1]);                   \
+    for (int i = BOARD_TOP; i < BOARD_TOP + height; i++) {                  \
+      VEC row = LOADU((const VEC *)lanes[i]);                               \
+      VEC cells = AND(row, field);                                          \
+      holes = ADD(holes, NAME##_popcount(ANDNOT(cells, seen)));             \
+      column = ADD(column, NAME##_popcount(AND(XOR(row, above), field)));   \
+      VEC well = AND(AND(SLLI(row, 1), SRLI(row, 1)), field);               \
+      well = ANDNOT(row, ANDNOT(seen, well));                               \
+      wells = ADD(wells, NAME##_popcount(well));                            \
+      seen = OR(seen, cells);                                               \
+      height_sum = ADD(height_sum, NAME##_popcount(seen));                  \
+      max_height = ADD(max_height, ANDNOT(CMPEQ(seen, zero), one));         \
+      VEC steps = AND(XOR(seen, SRLI(seen, 1)), pairs_field);               \
+      bump = ADD(bump, NAME##_popcount(steps));                             \
+      VEC changes = AND(XOR(row, SRLI(row, 1)), pairs_row);                 \
+      row_tr = ADD(row_tr, NAME##_popcount(changes));                       \
+      above = row;                                                          \
+    }                                                                       \
+    VEC floor = LOADU((const VEC *)lanes[BOARD_TOP + height]);              \
+    column = ADD(column, NAME##_popcount(AND(XOR(floor, above), field)));   \
+    uint16_t out[7][LANES];                                                 \
+    STOREU((VEC *)out[0], height_sum);                                      \
+    STOREU((VEC *)out[1], holes);                                           \
+    STOREU((VEC *)out[2], bump);                                            \
+    STOREU((VEC *)out[3], row_tr);                                          \
+    STOREU((VEC *)out[4], column);                                          \
+    STOREU((VEC *)out[5], wells);                                           \
+    STOREU((VEC *)out[6], max_height);                                      \
+    for (int b = 0; b < LANES; b++)                                         \
+      features[b] = (BoardFeatures_t){out[0][b], out[1][b], out[2][b],      \
+                                      out[3][b], out[4][b], out[5][b],      \
+                                      out[6][b]};                           \
+  }                                                                         \
+                                                                            \
+  static void NAME(const uint32_t (*boards)[BOARD_ROWS_MAX], int height,    \
+                   int width, BoardFeatures_t *features) {                  \
+    if (height == HEIGHT && width == WIDTH)                                 \
+      NAME##_rows(boards, HEIGHT, WIDTH, features);                         \
+    else                                                                    \
+      NAME##_rows(boards, height, width, features);                         \
+  }
+
+FEATURES_KERNEL(features_sse2, 8, __m128i, _mm_set1_epi16, _mm_loadu_si128,
+                _mm_storeu_si128, _mm_and_si128, _mm_andnot_si128,
+                _mm_or_si128, _mm_xor_si128, _mm_add_epi16, _mm_sub_epi16,
+                _mm_srli_epi16, _mm_slli_epi16, _mm_cmpeq_epi16)
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+FEATURES_KERNEL(features_avx2, 16, __m256i, _mm256_set1_epi16,
+                _mm256_loadu_si256, _mm256_storeu_si256, _mm256_and_si256,
+                _mm256_andnot_si256, _mm256_or_si256, _mm256_xor_si256,
+                _mm256_add_epi16, _mm256_sub_epi16, _mm256_srli_epi16,
+                _mm256_slli_epi16, _mm256_cmpeq_epi16)
+#pragma GCC pop_options
+
+#endif  // FEATURES_X86
+
+/**
+ * @brief Вычисляет признаки для набора полей-кандидатов
+ * @param boards Битборды полей, по BOARD_ROWS_MAX строк каждый
+ * @param count Количество полей
+ * @param height Высота полей
+ * @param width Ширина полей
+ * @param[out] features Признаки полей, count элементов
+ * @details Результат совпадает с board_features() для каждого поля. На x86-64
+ *          поля не шире FEATURES_NARROW_MAX обрабатываются группами по 16
+ *          (AVX2, если процессор его поддерживает) и по 8 (SSE2), остаток и
+ *          более широкие поля - скалярно.
+ */
+void board_features_batch(const uint32_t (*boards)[BOARD_ROWS_MAX], int count,
+                          int height, int width, BoardFeatures_t *features) {
+  int done = 0;
+#ifdef FEATURES_X86
+  if (width <= FEATURES_NARROW_MAX) {
+    if (__builtin_cpu_supports("avx2")) {
+      for (; done + 16 <= count; done += 16)
+        features_avx2(boards + done, height, width, features + done);
+    }
+    for (; done + 8 <= count; done += 8)
+      features_sse2(boards + done, height, width, features + done);
+  }
+#endif
+  for (; done < count; done++)
+    board_features(boards[done], height, width, &features[done]);
+}
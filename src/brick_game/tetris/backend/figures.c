@@ -1,172 +1,270 @@
 #include "figures.h"
 
-#include <stdlib.h>
-#include <time.h>
-
 #include "backend_tetris.h"
 
+/**
+ * @brief Таблица фигур: все повороты каждой фигуры
+ * @details Повороты L, J, S, T, Z получены поворотом области 3x3 по часовой
+ * стрелке, I поворачивается обменом второй строки и второго столбца, O не
+ * поворачивается. Маски строк: бит j — столбец j матрицы 4x4. Поля формы:
+ * маски, верхняя/нижняя строка, левый/правый столбец, размер области,
+ * нижний профиль (нижняя занятая строка каждого столбца, -1 - пустой).
+ */
+static const FigureInfo FIGURES[FIGURES_COUNT + 1] = {
+    [FIGURE_NONE] = {.rotations = 1},
+    [FIGURE_I] = {.shapes = {{{0, 0b1111, 0, 0}, 1, 1, 0, 3, 2, 4,
+                              {1, 1, 1, 1}},
+                             {{0b0010, 0b0010, 0b0010, 0b0010}, 0, 3, 1, 1,
+                              4, 2, {-1, 3, -1, -1}}},
+                  .kicks = {0, 1, -1, -2},
+                  .kicks_count = 4,
+                  .rotations = 2,
+                  .spawn_y = -1,
+                  .type = 'I',
+                  .color = COLOR_RED},
+    [FIGURE_O] = {.shapes = {{{0b0110, 0b0110, 0, 0}, 0, 1, 1, 2, 2, 2,
+                              {-1, 1, 1, -1}}},
+                  .kicks = {0},
+                  .kicks_count = 1,
+                  .rotations = 1,
+                  .type = 'O',
+                  .color = COLOR_CUSTOM_MAGENTA},
+    [FIGURE_L] = {.shapes = {{{0b0100, 0b0111, 0, 0}, 0, 1, 0, 2, 3, 3,
+                              {1, 1, 1, -1}},
+                             {{0b0010, 0b0010, 0b0110, 0}, 0, 2, 1, 2, 3, 3,
+                              {-1, 2, 2, -1}},
+                             {{0, 0b0111, 0b0001, 0}, 1, 2, 0, 2, 3, 3,
+                              {2, 1, 1, -1}},
+                             {{0b0011, 0b0010, 0b0010, 0}, 0, 2, 0, 1, 3, 3,
+                              {0, 2, -1, -1}}},
+                  .kicks = {0, 1, -1},
+                  .kicks_count = 3,
+                  .rotations = 4,
+                  .type = 'L',
+                  .color = COLOR_CUSTOM_YELLOW},
+    [FIGURE_J] = {.shapes = {{{0b0001, 0b0111, 0, 0}, 0, 1, 0, 2, 3, 3,
+                              {1, 1, 1, -1}},
+                             {{0b0110, 0b0010, 0b0010, 0}, 0, 2, 1, 2, 3, 3,
+                              {-1, 2, 0, -1}},
+                             {{0, 0b0111, 0b0100, 0}, 1, 2, 0, 2, 3, 3,
+                              {1, 1, 2, -1}},
+                             {{0b0010, 0b0010, 0b0011, 0}, 0, 2, 0, 1, 3, 3,
+                              {2, 2, -1, -1}}},
+                  .kicks = {0, 1, -1},
+                  .kicks_count = 3,
+                  .rotations = 4,
+                  .type = 'J',
+                  .color = COLOR_ORANGE},
+    [FIGURE_S] = {.shapes = {{{0b0110, 0b0011, 0, 0}, 0, 1, 0, 2, 3, 3,
+                              {1, 1, 0, -1}},
+                             {{0b0010, 0b0110, 0b0100, 0}, 0, 2, 1, 2, 3, 3,
+                              {-1, 1, 2, -1}},
+                             {{0, 0b0110, 0b0011, 0}, 1, 2, 0, 2, 3, 3,
+                              {2, 2, 1, -1}},
+                             {{0b0001, 0b0011, 0b0010, 0}, 0, 2, 0, 1, 3, 3,
+                              {1, 2, -1, -1}}},
+                  .kicks = {0, 1, -1},
+                  .kicks_count = 3,
+                  .rotations = 4,
+                  .type = 'S',
+                  .color = COLOR_GREEN},
+    [FIGURE_T] = {.shapes = {{{0b0010, 0b0111, 0, 0}, 0, 1, 0, 2, 3, 3,
+                              {1, 1, 1, -1}},
+                             {{0b0010, 0b0110, 0b0010, 0}, 0, 2, 1, 2, 3, 3,
+                              {-1, 2, 1, -1}},
+                             {{0, 0b0111, 0b0010, 0}, 1, 2, 0, 2, 3, 3,
+                              {1, 2, 1, -1}},
+                             {{0b0010, 0b0011, 0b0010, 0}, 0, 2, 0, 1, 3, 3,
+                              {1, 2, -1, -1}}},
+                  .kicks = {0, 1, -1},
+                  .kicks_count = 3,
+                  .rotations = 4,
+                  .type = 'T',
+                  .color = COLOR_BLUE},
+    [FIGURE_Z] = {.shapes = {{{0b0011, 0b0110, 0, 0}, 0, 1, 0, 2, 3, 3,
+                              {0, 1, 1, -1}},
+                             {{0b0100, 0b0110, 0b0010, 0}, 0, 2, 1, 2, 3, 3,
+                              {-1, 2, 1, -1}},
+                             {{0, 0b0011, 0b0110, 0}, 1, 2, 0, 2, 3, 3,
+                              {1, 2, 2, -1}},
+                             {{0b0010, 0b0011, 0b0001, 0}, 0, 2, 0, 1, 3, 3,
+                              {2, 1, -1, -1}}},
+                  .kicks = {0, 1, -1},
+                  .kicks_count = 3,
+                  .rotations = 4,
+                  .type = 'Z',
+                  .color = COLOR_VIOLET},
+};
+
+/**
+ * @brief Возвращает описание фигуры из таблицы фигур
+ * @param id Номер фигуры (FIGURE_NONE для пустой фигуры)
+ * @return Указатель на запись таблицы
+ */
+const FigureInfo *figure_info(int id) { return &FIGURES[id]; }
+
+/**
+ * @brief Возвращает форму фигуры в ее текущем повороте
+ * @param figure Указатель на структуру тетромино
+ * @return Указатель на запись таблицы фигур
+ */
+const FigureShape *figure_shape(const Tetramino *figure) {
+  return &FIGURES[figure->id].shapes[figure->rotation];
+}
+
+/**
+ * @brief Заполняет фигуру по номеру из таблицы фигур
+ * @param figure Указатель на структуру тетромино
+ * @param id Номер фигуры
+ * @details Фигура получает начальный поворот
+ */
+void init_figure(Tetramino *figure, int id) {
+  figure->id = id;
+  figure->rotation = 0;
+}
+
 /**
  * @brief Сбрасывает фигуру в нулевое состояние
  * @param figure Указатель на структуру тетромино
- * @details Заполняет матрицу 4x4 нулями (пустая фигура)
+ * @details Делает фигуру пустой (FIGURE_NONE)
  */
 void reset_figure(Tetramino *figure) {
-  for (int i = 0; i < 4; i++)
-    for (int j = 0; j < 4; j++) figure->view[i][j] = 0;
+  figure->id = FIGURE_NONE;
+  figure->rotation = 0;
 }
 
 /**
- * @brief Генерирует случайную фигуру тетромино
- * @param figure Указатель на структуру для заполнения
+ * @brief Заполняет семерку фигур и перемешивает ее
+ * @param game Указатель на структуру состояния игры
+ * @details Перемешивание Фишера-Йетса на генераторе игры
  */
-void generate_figure(Tetramino *figure) {
-  int number = rand() % 7;
-  figure->rows = 3;
-  figure->cols = 3;
-  if (number == 0) {
-    figure->rows = 2;
-    figure->cols = 4;
-    for (int i = 0; i < 4; i++) figure->view[1][i] = COLOR_RED;
-    figure->type = 'I';
-  }
-  if (number == 1) {
-    figure->rows = 2;
-    figure->cols = 2;
-    for (int i = 1; i < 3; i++) figure->view[0][i] = COLOR_CUSTOM_MAGENTA;
-    for (int i = 1; i < 3; i++) figure->view[1][i] = COLOR_CUSTOM_MAGENTA;
-    figure->type = 'O';
-  }
-  if (number == 2) {
-    figure->view[0][2] = COLOR_CUSTOM_YELLOW;
-    for (int j = 0; j < 3; j++) figure->view[1][j] = COLOR_CUSTOM_YELLOW;
-    figure->type = 'L';
-  }
-  if (number == 3) {
-    figure->view[0][0] = COLOR_ORANGE;
-    for (int j = 0; j < 3; j++) figure->view[1][j] = COLOR_ORANGE;
-    figure->type = 'J';
-  }
-  if (number == 4) {
-    for (int i = 1; i < 3; i++) figure->view[0][i] = COLOR_GREEN;
-    for (int i = 0; i < 2; i++) figure->view[1][i] = COLOR_GREEN;
-    figure->type = 'S';
-  }
-  if (number == 5) {
-    figure->view[0][1] = COLOR_BLUE;
-    for (int i = 0; i < 3; i++) figure->view[1][i] = COLOR_BLUE;
-    figure->type = 'T';
-  }
-  if (number == 6) {
-    for (int i = 0; i < 2; i++) figure->view[0][i] = COLOR_VIOLET;
-    for (int i = 1; i < 3; i++) figure->view[1][i] = COLOR_VIOLET;
-    figure->type = 'Z';
+static void refill_bag(GameInfo_t *game) {
+  for (int i = 0; i < FIGURES_COUNT; i++) game->bag[i] = (uint8_t)(i + 1);
+  for (int i = FIGURES_COUNT - 1; i > 0; i--) {
+    int j = (int)rng_bounded(&game->rng, (uint32_t)i + 1);
+    uint8_t temp = game->bag[i];
+    game->bag[i] = game->bag[j];
+    game->bag[j] = temp;
   }
+  game->bag_left = FIGURES_COUNT;
 }
 
 /**
- * @brief Поворачивает текущую фигуру на 90 градусов
- * @details Особые случаи:
- *          - O-фигура не поворачивается
- *          - I-фигура требует особой обработки
- *          - Корректирует позицию при выходе за границы
+ * @brief Генерирует случайную фигуру тетромино
+ * @param game Указатель на структуру состояния игры
+ * @param figure Указатель на структуру для заполнения
+ * @details Фигура берется из генератора игры: при RANDOMIZER_BAG из
+ *          перемешанной семерки, иначе независимо и равновероятно
  */
-void rotate_figure() {
-  GameInfo_t *game = updateCurrentState();
-  int temp_view[4][4] = {0};
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
-      temp_view[i][j] = game->current.view[i][j];
-    }
-  }
-  if (game->current.type != 'O' && game->current.type != 'I') {
-    for (int i = 0; i < game->current.rows; i++) {
-      for (int j = 0; j < game->current.cols; j++)
-        game->current.view[i][j] = temp_view[game->current.cols - 1 - j][i];
-    }
-  }
-  if (game->current.type == 'I' && game->current.y >= 0) {
-    for (int i = 0; i < 4; i++) {
-      int temp = game->current.view[1][i];
-      game->current.view[1][i] = game->current.view[i][1];
-      game->current.view[i][1] = temp;
-    }
-    int cols_temp = game->current.cols;
-    game->current.cols = game->current.rows;
-    game->current.rows = cols_temp;
-  }
-
-  if (check_leaving_field() == 1)
-    if ((collision() & 0b001) != 1) game->current.x++;
-  if (check_leaving_field() == 2) {
-    if ((collision() & 0b010) != 2) game->current.x--;
-    if (game->current.type == 'I')
-      if ((collision() & 0b010) != 2) game->current.x--;
+void generate_figure(GameInfo_t *game, Tetramino *figure) {
+  int id;
+  if (game->randomizer == RANDOMIZER_BAG) {
+    if (game->bag_left == 0) refill_bag(game);
+    id = game->bag[--game->bag_left];
+  } else {
+    id = 1 + (int)rng_bounded(&game->rng, FIGURES_COUNT);
   }
+  init_figure(figure, id);
+}
 
-  if (check_figure_overlay() || check_leaving_field()) {
-    for (int i = 0; i < 4; i++) {
-      for (int j = 0; j < 4; j++) game->current.view[i][j] = temp_view[i][j];
+/**
+ * @brief Поворачивает фигуру на 90 градусов по правилам игры
+ * @param game Указатель на структуру состояния игры (только чтение поля)
+ * @param figure Поворачиваемая фигура
+ * @return 1 если поворот выполнен, 0 если отменен
+ * @details Следующий поворот берется из таблицы фигур. Затем по очереди
+ *          пробуются смещения фигуры по X из таблицы, пока фигура не встанет
+ *          без наложения; если ни одно не подходит, поворот отменяется.
+ *          Фигура, часть которой оказалась бы выше поля, не поворачивается.
+ */
+int rotate_tetramino(const GameInfo_t *game, Tetramino *figure) {
+  const FigureInfo *info = figure_info(figure->id);
+  Tetramino rotated = *figure;
+  rotated.rotation = (rotated.rotation + 1) % info->rotations;
+  const FigureShape *shape = &info->shapes[rotated.rotation];
+  int rotated_ok = 0;
+  if (rotated.rotation != figure->rotation && rotated.y + shape->top >= 0) {
+    for (int k = 0; k < info->kicks_count && !rotated_ok; k++) {
+      rotated.x = figure->x + info->kicks[k];
+      rotated_ok = !figure_overlay(game, &rotated);
     }
+    if (rotated_ok) *figure = rotated;
   }
+  return rotated_ok;
 }
 
+/**
+ * @brief Поворачивает текущую фигуру на 90 градусов
+ * @param game Указатель на структуру состояния игры
+ */
+void rotate_figure(GameInfo_t *game) { rotate_tetramino(game, &game->current); }
+
 /**
  * @brief Появление новой фигурки на поле
+ * @param game Указатель на структуру состояния игры
  * @details Берет следующую фигуру (game->next), помещает ее в текущую
  * (game->current) и генерирует новую следующую фигуру
  */
-void spawn_figure() {
-  GameInfo_t *game = updateCurrentState();
-  reset_figure(&game->current);
+void spawn_figure(GameInfo_t *game) {
   game->current = game->next;
 
-  game->current.x = WIDTH / 2 - 2;
-  game->current.y = game->current.type == 'I' ? -1 : 0;
+  game->current.x = (int8_t)(game->width / 2 - 2);
+  game->current.y = figure_info(game->current.id)->spawn_y;
 
   reset_figure(&game->next);
-  generate_figure(&game->next);
+  generate_figure(game, &game->next);
 }
 
 /**
  * @brief Двигает фигуру влево с проверкой коллизий
+ * @param game Указатель на структуру состояния игры
  */
-void move_left() {
-  GameInfo_t *game = updateCurrentState();
-  if ((collision() & 0b010) != 2) game->current.x--;
-  if (check_leaving_field()) game->current.x++;
+void move_left(GameInfo_t *game) {
+  if ((collision(game) & 0b010) != 2) game->current.x--;
+  if (check_leaving_field(game)) game->current.x++;
 }
 
 /**
  * @brief Двигает фигуру вправо с проверкой коллизий
+ * @param game Указатель на структуру состояния игры
  */
-void move_right() {
-  GameInfo_t *game = updateCurrentState();
-  if ((collision() & 0b001) != 1) game->current.x++;
-  if (check_leaving_field()) game->current.x--;
+void move_right(GameInfo_t *game) {
+  if ((collision(game) & 0b001) != 1) game->current.x++;
+  if (check_leaving_field(game)) game->current.x--;
 }
 
 /**
  * @brief Двигает фигуру вниз с проверкой коллизий
+ * @param game Указатель на структуру состояния игры
  */
-void move_down() {
-  GameInfo_t *game = updateCurrentState();
-  if (!check_leaving_field() && (collision() & 0b100) != 4) game->current.y++;
+void move_down(GameInfo_t *game) {
+  if (!check_leaving_field(game) && (collision(game) & 0b100) != 4)
+    game->current.y++;
 }
 
 /**
  * @brief Прикрепление фигуры к игровому полю
- * @details Переносит все непустые клетки фигуры в игровое поле
+ * @param game Указатель на структуру состояния игры
+ * @details Добавляет маски строк фигуры в битборд, переносит цвет фигуры
+ *          в занятые ею клетки цветового слоя поля и поднимает высоты
+ *          столбцов под фигурой
  */
-void attached_figure() {
-  GameInfo_t *game = updateCurrentState();
+void attached_figure(GameInfo_t *game) {
+  const FigureShape *shape = figure_shape(&game->current);
+  int color = figure_info(game->current.id)->color;
   int x = game->current.x;
-  int y = game->current.y;  // текущие координаты фигуры (левый верхний угол 4×4
-                            // матрицы фигуры)
-  for (int i = 0; i < 4; i++, y++) {
-    for (int j = 0; j < 4; j++, x++) {
-      if (game->current.view[i][j] != 0)
-        game->field[y][x] = game->current.view[i][j];
-    }  // значение ячейки фигуры копируется на соответствующую позицию поля
-    x = game->current.x;
+  for (int i = shape->top; i <= shape->bottom; i++) {
+    int y = game->current.y + i;
+    if (y >= 0 && y < game->height) {
+      game->rows[BOARD_TOP + y] |= (uint32_t)shape->mask[i]
+                                   << (x + BOARD_WALL);
+      for (int j = shape->left; j <= shape->right; j++) {
+        if (shape->mask[i] & (1u << j)) {
+          game->field[y][x + j] = (uint8_t)color;
+          if (game->heights[x + j] < game->height - y)
+            game->heights[x + j] = (uint8_t)(game->height - y);
+        }
+      }
+    }
   }
 }
@@ -4,13 +4,17 @@
 #include "backend_tetris.h"
 #include "figures.h"
 
+const FigureInfo *figure_info(int id);
+const FigureShape *figure_shape(const Tetramino *figure);
+void init_figure(Tetramino *figure, int id);
 void reset_figure(Tetramino *figure);
-void generate_figure(Tetramino *figure);
-void rotate_figure();
-void spawn_figure();
-void move_left();
-void move_right();
-void move_down();
-void attached_figure();
+void generate_figure(GameInfo_t *game, Tetramino *figure);
+int rotate_tetramino(const GameInfo_t *game, Tetramino *figure);
+void rotate_figure(GameInfo_t *game);
+void spawn_figure(GameInfo_t *game);
+void move_left(GameInfo_t *game);
+void move_right(GameInfo_t *game);
+void move_down(GameInfo_t *game);
+void attached_figure(GameInfo_t *game);
 
 #endif  // FIGURES_TETRIS_H
\ No newline at end of file
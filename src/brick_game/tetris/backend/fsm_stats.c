@@ -0,0 +1,210 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "fsm_stats.h"
+
+/// Счетчики текущего потока: шаги пишут их без синхронизации
+static _Thread_local FsmStats_t local;
+/// Счетчики, собранные со всех потоков fsm_stats_flush()
+static FsmStats_t total;
+/// Защищает total
+static pthread_mutex_t total_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Возвращает монотонное время
+ * @return Время в наносекундах
+ */
+uint64_t fsm_stats_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Начинает замер шага автомата
+ * @param game Указатель на состояние игры до шага
+ * @return Замер для fsm_stats_end()
+ */
+FsmSample_t fsm_stats_begin(const GameInfo_t *game) {
+  FsmSample_t sample = {.state = game->state,
+                        .pieces = game->pieces,
+                        .lines = game->lines};
+  sample.start = fsm_stats_now();
+  return sample;
+}
+
+/**
+ * @brief Заканчивает замер шага и добавляет его в счетчики потока
+ * @param sample Замер из fsm_stats_begin()
+ * @param game Указатель на состояние игры после шага
+ * @details При смене состояния время с game->state_since добавляется к
+ * пребыванию в прежнем состоянии, и отсчет начинается заново. Момент
+ * входа хранится в игре, поэтому игры одного потока не мешают друг другу.
+ */
+void fsm_stats_end(const FsmSample_t *sample, GameInfo_t *game) {
+  uint64_t now = fsm_stats_now();
+  uint64_t ns = now - sample->start;
+  if (game->state_since == 0) game->state_since = sample->start;
+  if (game->state != sample->state) {
+    local.dwell_ns[sample->state] += now - game->state_since;
+    game->state_since = now;
+  }
+  FsmHistogram_t *histogram = &local.states[sample->state];
+  int bucket = ns > 0 ? 64 - __builtin_clzll(ns) : 0;
+  if (bucket >= FSM_STATS_BUCKETS) bucket = FSM_STATS_BUCKETS - 1;
+  histogram->count++;
+  histogram->total_ns += ns;
+  if (ns > histogram->max_ns) histogram->max_ns = ns;
+  histogram->buckets[bucket]++;
+  local.transitions[sample->state][game->state]++;
+  if (game->pieces > sample->pieces)
+    local.pieces += game->pieces - sample->pieces;
+  if (game->lines > sample->lines) local.lines += game->lines - sample->lines;
+  if (local.started == 0) local.started = sample->start;
+}
+
+/**
+ * @brief Переносит счетчики текущего потока в общие и обнуляет их
+ * @note Рабочий поток должен вызвать ее перед завершением, иначе его
+ *       счетчики не попадут в fsm_stats_get()
+ */
+void fsm_stats_flush(void) {
+  pthread_mutex_lock(&total_lock);
+  for (int i = 0; i < FSM_STATES; i++) {
+    const FsmHistogram_t *from = &local.states[i];
+    FsmHistogram_t *to = &total.states[i];
+    to->count += from->count;
+    to->total_ns += from->total_ns;
+    if (from->max_ns > to->max_ns) to->max_ns = from->max_ns;
+    for (int j = 0; j < FSM_STATS_BUCKETS; j++)
+      to->buckets[j] += from->buckets[j];
+    total.dwell_ns[i] += local.dwell_ns[i];
+    for (int j = 0; j < FSM_STATES; j++)
+      total.transitions[i][j] += local.transitions[i][j];
+  }
+  total.pieces += local.pieces;
+  total.lines += local.lines;
+  if (local.started != 0 &&
+      (total.started == 0 || local.started < total.started))
+    total.started = local.started;
+  pthread_mutex_unlock(&total_lock);
+  memset(&local, 0, sizeof(local));
+}
+
+/**
+ * @brief Возвращает общие счетчики
+ * @param[out] stats Копия счетчиков
+ * @details Сначала переносит в общие счетчики текущего потока
+ */
+void fsm_stats_get(FsmStats_t *stats) {
+  fsm_stats_flush();
+  pthread_mutex_lock(&total_lock);
+  *stats = total;
+  pthread_mutex_unlock(&total_lock);
+}
+
+/**
+ * @brief Обнуляет общие счетчики и счетчики текущего потока
+ */
+void fsm_stats_reset(void) {
+  pthread_mutex_lock(&total_lock);
+  memset(&total, 0, sizeof(total));
+  pthread_mutex_unlock(&total_lock);
+  memset(&local, 0, sizeof(local));
+}
+
+/**
+ * @brief Оценивает процентиль времени шага по гистограмме
+ * @param histogram Гистограмма
+ * @param percent Процентиль (0-100)
+ * @return Верхняя граница корзины, в которую попал процентиль (нс), но не
+ *         больше самого долгого шага; 0, если шагов не было
+ */
+uint64_t fsm_histogram_percentile(const FsmHistogram_t *histogram,
+                                  double percent) {
+  uint64_t rank = (uint64_t)(percent / 100.0 * histogram->count + 0.5);
+  uint64_t seen = 0;
+  uint64_t bound = histogram->max_ns;
+  int found = 0;
+  if (rank < 1) rank = 1;
+  for (int i = 0; !found && i < FSM_STATS_BUCKETS - 1; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank) {
+      found = 1;
+      if ((1ull << i) < bound) bound = 1ull << i;
+    }
+  }
+  return histogram->count > 0 ? bound : 0;
+}
+
+/**
+ * @brief Печатает счетчики в текстовом виде
+ * @param stats Счетчики
+ * @param file Файл вывода
+ * @details Скорости фигур и линий даны на секунду от первого шага и на
+ * секунду времени, проведенного в шагах автомата (во всех потоках). Для
+ * каждого состояния печатается задержка шага (steps - p99) и рядом
+ * время пребывания в нем (dwell ms) с числом завершенных пребываний.
+ */
+void fsm_stats_print(const FsmStats_t *stats, FILE *file) {
+  static const char *names[FSM_STATES] = {
+      "START", "SPAWN", "MOVING", "SHIFTING",
+      "ATTACHING", "GAMEOVER", "PAUSE", "EXIT"};
+  uint64_t busy_ns = 0;
+  for (int i = 0; i < FSM_STATES; i++) busy_ns += stats->states[i].total_ns;
+  double wall = stats->started != 0
+                    ? (fsm_stats_now() - stats->started) / 1e9
+                    : 0.0;
+  double busy = busy_ns / 1e9;
+  fprintf(file, "wall: %.3f s, in steps: %.3f s\n", wall, busy);
+  fprintf(file, "pieces: %llu (%.1f/s, %.1f/step-s)\n",
+          (unsigned long long)stats->pieces,
+          wall > 0 ? stats->pieces / wall : 0.0,
+          busy > 0 ? stats->pieces / busy : 0.0);
+  fprintf(file, "lines: %llu (%.1f/s, %.1f/step-s)\n",
+          (unsigned long long)stats->lines,
+          wall > 0 ? stats->lines / wall : 0.0,
+          busy > 0 ? stats->lines / busy : 0.0);
+  fprintf(file, "%-10s %12s %10s %8s %8s %8s %10s %12s %10s\n", "state",
+          "steps", "total ms", "mean ns", "p50 ns", "p99 ns", "max ns",
+          "dwell ms", "visits");
+  for (int i = 0; i < FSM_STATES; i++) {
+    const FsmHistogram_t *histogram = &stats->states[i];
+    uint64_t visits = 0;
+    if (histogram->count == 0) continue;
+    for (int to = 0; to < FSM_STATES; to++)
+      if (to != i) visits += stats->transitions[i][to];
+    fprintf(file,
+            "%-10s %12llu %10.1f %8.0f %8llu %8llu %10llu %12.1f %10llu\n",
+            names[i], (unsigned long long)histogram->count,
+            histogram->total_ns / 1e6,
+            (double)histogram->total_ns / histogram->count,
+            (unsigned long long)fsm_histogram_percentile(histogram, 50),
+            (unsigned long long)fsm_histogram_percentile(histogram, 99),
+            (unsigned long long)histogram->max_ns, stats->dwell_ns[i] / 1e6,
+            (unsigned long long)visits);
+  }
+  fprintf(file, "transitions:\n");
+  for (int from = 0; from < FSM_STATES; from++) {
+    for (int to = 0; to < FSM_STATES; to++) {
+      if (stats->transitions[from][to] > 0)
+        fprintf(file, "%-10s -> %-10s %12llu\n", names[from], names[to],
+                (unsigned long long)stats->transitions[from][to]);
+    }
+  }
+}
+
+/**
+ * @brief Сохраняет общие счетчики в файл
+ * @param path Файл (NULL - стандартный вывод)
+ * @return 0 при успехе, 1 - файл не открылся
+ */
+int fsm_stats_dump(const char *path) {
+  FsmStats_t stats;
+  FILE *file = path != NULL ? fopen(path, "w") : stdout;
+  if (file != NULL) {
+    fsm_stats_get(&stats);
+    fsm_stats_print(&stats, file);
+    if (path != NULL) fclose(file);
+  }
+  return file == NULL;
+}
@@ -0,0 +1,84 @@
+#ifndef FSM_STATS_TETRIS_H
+#define FSM_STATS_TETRIS_H
+
+#include <pthread.h>
+
+#include "backend_tetris.h"
+
+/// файл, куда игра сохраняет статистику автомата при выходе
+#define FSM_STATS_PATH "build/fsm_stats.txt"
+#define FSM_STATS_BUCKETS 32  ///< корзин гистограммы времени шага
+#define FSM_STATES (EXIT_STATE + 1)  ///< количество состояний автомата
+
+/**
+ * @struct FsmHistogram_t
+ * @brief Гистограмма времени шагов в одном состоянии
+ * @details Корзина 0 - шаги короче 1 нс, корзина i - шаги от 2^(i-1) до
+ * 2^i нс; последняя корзина собирает все более долгие шаги
+ */
+typedef struct {
+  uint64_t count;     ///< Количество шагов
+  uint64_t total_ns;  ///< Суммарное время шагов
+  uint64_t max_ns;    ///< Самый долгий шаг
+  uint64_t buckets[FSM_STATS_BUCKETS];  ///< Шаги по корзинам
+} FsmHistogram_t;
+
+/**
+ * @struct FsmStats_t
+ * @brief Счетчики конечного автомата
+ * @details states - задержка вызова tetris_step() по состоянию до шага;
+ * время шага в состоянии ATTACHING - это время attaching_state_actions().
+ * dwell_ns - время пребывания в состоянии: от шага, который в него
+ * перевел, до шага, который из него вывел (по GameInfo_t::state_since).
+ * Незакрытое пребывание, как и время до первого шага игры, не считается.
+ */
+typedef struct {
+  FsmHistogram_t states[FSM_STATES];  ///< Время шагов
+  uint64_t dwell_ns[FSM_STATES];  ///< Время пребывания в состояниях
+  uint64_t transitions[FSM_STATES][FSM_STATES];  ///< Переходы [из][в]
+  uint64_t pieces;  ///< Выпущено фигур
+  uint64_t lines;   ///< Удалено линий
+  uint64_t started;  ///< Время первого шага (нс, 0 - шагов не было)
+} FsmStats_t;
+
+/**
+ * @struct FsmSample_t
+ * @brief Замер одного шага автомата
+ */
+typedef struct {
+  GameState_t state;  ///< Состояние до шага
+  int pieces;         ///< Фигур до шага
+  int lines;          ///< Линий до шага
+  uint64_t start;     ///< Начало шага (нс)
+} FsmSample_t;
+
+/**
+ * @brief Замеры шагов автомата
+ * @details Включаются сборкой с TETRIS_STATS (make STATS=1). Без него
+ * макросы раскрываются в пустые операторы, и tetris_step() не делает
+ * ничего лишнего.
+ */
+#ifdef TETRIS_STATS
+#define FSM_STATS_BEGIN(game) FsmSample_t fsm_sample = fsm_stats_begin(game)
+#define FSM_STATS_END(game) fsm_stats_end(&fsm_sample, (game))
+#define FSM_STATS_FLUSH() fsm_stats_flush()
+#define FSM_STATS_DUMP(path) fsm_stats_dump(path)
+#else
+#define FSM_STATS_BEGIN(game) (void)(game)
+#define FSM_STATS_END(game) (void)(game)
+#define FSM_STATS_FLUSH() (void)0
+#define FSM_STATS_DUMP(path) (void)(path)
+#endif
+
+uint64_t fsm_stats_now(void);
+FsmSample_t fsm_stats_begin(const GameInfo_t *game);
+void fsm_stats_end(const FsmSample_t *sample, GameInfo_t *game);
+void fsm_stats_flush(void);
+void fsm_stats_get(FsmStats_t *stats);
+void fsm_stats_reset(void);
+uint64_t fsm_histogram_percentile(const FsmHistogram_t *histogram,
+                                  double percent);
+void fsm_stats_print(const FsmStats_t *stats, FILE *file);
+int fsm_stats_dump(const char *path);
+
+#endif  // FSM_STATS_TETRIS_H
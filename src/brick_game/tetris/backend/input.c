@@ -0,0 +1,170 @@
+#include "input.h"
+
+/**
+ * @brief Очищает очередь ввода
+ * @param queue Очередь
+ * @note Вызывается до запуска потоков, которые работают с очередью
+ */
+void input_queue_init(InputQueue_t *queue) {
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+}
+
+/**
+ * @brief Добавляет клавишу в конец очереди (только поток-производитель)
+ * @param queue Очередь
+ * @param key Код клавиши
+ * @return true, если клавиша добавлена; false - очередь заполнена
+ */
+bool input_queue_push(InputQueue_t *queue, int key) {
+  unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+  bool added = tail - head < INPUT_QUEUE_SIZE;
+  if (added) {
+    queue->keys[tail % INPUT_QUEUE_SIZE] = key;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+  }
+  return added;
+}
+
+/**
+ * @brief Забирает клавишу из начала очереди (только поток-потребитель)
+ * @param queue Очередь
+ * @return Код клавиши или ERR, если очередь пуста
+ */
+int input_queue_pop(InputQueue_t *queue) {
+  unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+  int key = ERR;
+  if (head != tail) {
+    key = queue->keys[head % INPUT_QUEUE_SIZE];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+  }
+  return key;
+}
+
+/**
+ * @brief Задает параметры автоповтора и сбрасывает удержание
+ * @param shift Автоповтор
+ * @param config Параметры (NULL - INPUT_DAS_MS, INPUT_ARR_MS,
+ *        INPUT_RELEASE_MS); нулевые поля заменяются значениями по умолчанию
+ */
+void autoshift_init(AutoShift_t *shift, const InputConfig_t *config) {
+  AutoShift_t initial = AUTOSHIFT_INITIALIZER;
+  *shift = initial;
+  if (config != NULL) {
+    if (config->das_ms > 0) shift->config.das_ms = config->das_ms;
+    if (config->arr_ms > 0) shift->config.arr_ms = config->arr_ms;
+    if (config->release_ms > 0) shift->config.release_ms = config->release_ms;
+  }
+}
+
+/**
+ * @brief Вычисляет, когда удерживаемая клавиша будет считаться отпущенной
+ * @param shift Автоповтор с удерживаемым сдвигом
+ * @return Последний момент (мс), когда событие еще продолжает удержание
+ * @details До первого повтора терминала ждет его задержки, затем -
+ * release_ms между повторами
+ */
+static long long autoshift_release(const AutoShift_t *shift) {
+  return shift->seen + (shift->repeats == 0 ? INPUT_DELAY_MAX_MS
+                                            : shift->config.release_ms);
+}
+
+/**
+ * @brief Проверяет, продолжает ли событие клавиши ее удержание
+ * @param shift Автоповтор
+ * @param action Действие клавиши
+ * @param now Текущее время (мс)
+ * @return true, если это тот же сдвиг и событие похоже на повтор
+ *         терминала: первый - от INPUT_DELAY_MIN_MS до INPUT_DELAY_MAX_MS
+ *         после нажатия, следующие - не позже release_ms после прошлого
+ * @details Терминал не сообщает об отпускании клавиш, поэтому удержание
+ * узнается по повторам, которые он присылает сам. Событие раньше
+ * INPUT_DELAY_MIN_MS после нажатия - повторное нажатие.
+ */
+bool autoshift_is_hold(const AutoShift_t *shift, UserAction_t action,
+                       long long now) {
+  return shift->action != (UserAction_t)-1 && shift->action == action &&
+         now <= autoshift_release(shift) &&
+         (shift->repeats > 0 || now - shift->seen >= INPUT_DELAY_MIN_MS);
+}
+
+/**
+ * @brief Пропускает действие пользователя через автоповтор
+ * @param shift Автоповтор
+ * @param action Действие (-1 - нет действия)
+ * @param hold Клавиша удерживается (событие повтора, а не нажатие)
+ * @param now Текущее время (мс)
+ * @return Действие для шага автомата: нажатие проходит сразу, повтор
+ *         сдвига - только если с нажатия прошло das_ms и подошло время
+ *         повтора, иначе -1
+ * @details Любое другое действие прекращает удержание сдвига
+ */
+UserAction_t autoshift_input(AutoShift_t *shift, UserAction_t action,
+                             bool hold, long long now) {
+  UserAction_t result = action;
+  if (action == Left || action == Right) {
+    if (hold && shift->action == action) {
+      shift->seen = now;
+      shift->repeats++;
+      result = (UserAction_t)-1;
+      if (now >= shift->next) {
+        shift->next = now + shift->config.arr_ms;
+        shift->shifted = true;
+        result = action;
+      }
+    } else {
+      shift->action = action;
+      shift->seen = now;
+      shift->next = now + shift->config.das_ms;
+      shift->repeats = 0;
+      shift->shifted = false;
+    }
+  } else if (action != (UserAction_t)-1) {
+    shift->action = (UserAction_t)-1;
+  }
+  return result;
+}
+
+/**
+ * @brief Выдает повтор удерживаемого сдвига, если подошло его время
+ * @param shift Автоповтор
+ * @param now Текущее время (мс)
+ * @return Удерживаемый сдвиг или -1
+ * @details Пропущенные повторы не догоняются: следующий назначается через
+ * arr_ms от текущего. Клавиша без событий дольше autoshift_release()
+ * считается отпущенной. Если до отпускания был всего один повтор и он
+ * пришел раньше das_ms, это было повторное нажатие: оно сдвигает фигуру
+ * при отпускании.
+ */
+UserAction_t autoshift_repeat(AutoShift_t *shift, long long now) {
+  UserAction_t result = (UserAction_t)-1;
+  if (shift->action != (UserAction_t)-1 && now > autoshift_release(shift)) {
+    if (shift->repeats == 1 && !shift->shifted) result = shift->action;
+    shift->action = (UserAction_t)-1;
+  } else if (shift->action != (UserAction_t)-1 && shift->repeats >= 2 &&
+             now >= shift->next) {
+    shift->next = now + shift->config.arr_ms;
+    shift->shifted = true;
+    result = shift->action;
+  }
+  return result;
+}
+
+/**
+ * @brief Вычисляет, сколько можно ждать до следующего события автоповтора
+ * @param shift Автоповтор
+ * @param now Текущее время (мс)
+ * @return Время в мс до повтора или до отпускания клавиши, -1 - сдвиг не
+ *         удерживается
+ */
+int autoshift_timeout(const AutoShift_t *shift, long long now) {
+  int timeout = -1;
+  if (shift->action != (UserAction_t)-1) {
+    long long wake = autoshift_release(shift) + 1;
+    if (shift->repeats >= 2 && shift->next < wake) wake = shift->next;
+    timeout = wake > now ? (int)(wake - now) : 0;
+  }
+  return timeout;
+}
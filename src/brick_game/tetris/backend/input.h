@@ -0,0 +1,83 @@
+#ifndef INPUT_TETRIS_H
+#define INPUT_TETRIS_H
+
+#include <stdatomic.h>
+
+#include "backend_tetris.h"
+
+#define INPUT_QUEUE_SIZE 64  ///< клавиш в очереди ввода (степень двойки)
+#define INPUT_DAS_MS 170  ///< задержка автоповтора по умолчанию (мс)
+#define INPUT_ARR_MS 50  ///< период автоповтора по умолчанию (мс)
+/// пауза в повторах клавиши, после которой она считается отпущенной (мс)
+#define INPUT_RELEASE_MS 60
+/// границы задержки первого повтора клавиши у терминалов (мс): раньше
+/// INPUT_DELAY_MIN_MS терминал не повторяет, позже INPUT_DELAY_MAX_MS
+/// клавиша без повторов считается отпущенной
+#define INPUT_DELAY_MIN_MS 200
+#define INPUT_DELAY_MAX_MS 700
+
+/// начальное состояние автоповтора с параметрами по умолчанию
+#define AUTOSHIFT_INITIALIZER                                        \
+  {{INPUT_DAS_MS, INPUT_ARR_MS, INPUT_RELEASE_MS}, (UserAction_t)-1, \
+   0, 0, 0, false}
+
+/**
+ * @struct InputQueue_t
+ * @brief Кольцевая очередь кодов клавиш без блокировок
+ * @details Один поток (ввода) добавляет клавиши, другой (симуляции)
+ * забирает их по порядку. Счетчики head и tail только растут, индекс в
+ * keys - их остаток от INPUT_QUEUE_SIZE; каждый счетчик пишет один поток,
+ * и лежат они в разных строках кэша.
+ */
+typedef struct {
+  _Alignas(GAME_CACHE_LINE) _Atomic unsigned head;  ///< Забрано клавиш
+  _Alignas(GAME_CACHE_LINE) _Atomic unsigned tail;  ///< Добавлено клавиш
+  int keys[INPUT_QUEUE_SIZE];  ///< Коды клавиш
+} InputQueue_t;
+
+/**
+ * @struct InputConfig_t
+ * @brief Параметры автоповтора сдвига (DAS/ARR)
+ */
+typedef struct {
+  int das_ms;  ///< Задержка от нажатия до первого повтора
+  int arr_ms;      ///< Период повторов
+  int release_ms;  ///< Пауза в повторах, означающая отпускание клавиши
+} InputConfig_t;
+
+/**
+ * @struct AutoShift_t
+ * @brief Состояние автоповтора сдвига
+ * @details Повторяются только сдвиги Left и Right. Нажатие сдвигает фигуру
+ * сразу, события удержания (hold) лишь продлевают его, а сами повторы
+ * идут по часам: первый через das_ms после нажатия, следующие - каждые
+ * arr_ms. Поэтому частые повторы клавиши не копятся в очереди, и задержка
+ * от ввода до экрана не растет.
+ *
+ * Терминал сообщает об удержании только своими повторами, а первый из них
+ * приходит через 250-660 мс после нажатия. Поэтому нажатие ждет первого
+ * повтора до INPUT_DELAY_MAX_MS, и DAS отсчитывается от нажатия. Повторы
+ * по часам начинаются со второго повтора терминала: одиночное событие
+ * может быть и повторным нажатием, и оно сдвигает фигуру ровно один раз.
+ */
+typedef struct {
+  InputConfig_t config;  ///< Параметры
+  UserAction_t action;   ///< Удерживаемый сдвиг (-1 - нет)
+  long long seen;  ///< Время последнего события клавиши (мс)
+  long long next;  ///< Время следующего повтора (мс)
+  int repeats;     ///< Повторов терминала с нажатия
+  bool shifted;  ///< Удержание уже сдвигало фигуру после нажатия
+} AutoShift_t;
+
+void input_queue_init(InputQueue_t *queue);
+bool input_queue_push(InputQueue_t *queue, int key);
+int input_queue_pop(InputQueue_t *queue);
+void autoshift_init(AutoShift_t *shift, const InputConfig_t *config);
+bool autoshift_is_hold(const AutoShift_t *shift, UserAction_t action,
+                       long long now);
+UserAction_t autoshift_input(AutoShift_t *shift, UserAction_t action,
+                             bool hold, long long now);
+UserAction_t autoshift_repeat(AutoShift_t *shift, long long now);
+int autoshift_timeout(const AutoShift_t *shift, long long now);
+
+#endif  // INPUT_TETRIS_H
@@ -0,0 +1,317 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "leaderboard.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Вставляет запись в таблицу рекордов
+ * @param board Таблица
+ * @param entry Запись
+ * @return Место записи в таблице (с 0) или -1, если счет не попал в
+ *         таблицу или равен нулю
+ * @details При равном счете новая запись встает ниже прежних
+ */
+int leaderboard_insert(Leaderboard_t *board, const ScoreEntry_t *entry) {
+  int rank = 0;
+  while (rank < board->count && board->entries[rank].score >= entry->score)
+    rank++;
+  if (entry->score <= 0 || rank >= LEADERBOARD_SIZE) {
+    rank = -1;
+  } else {
+    int last = board->count < LEADERBOARD_SIZE ? board->count
+                                               : LEADERBOARD_SIZE - 1;
+    memmove(&board->entries[rank + 1], &board->entries[rank],
+            sizeof(ScoreEntry_t) * (last - rank));
+    board->entries[rank] = *entry;
+    if (board->count < LEADERBOARD_SIZE) board->count++;
+  }
+  return rank;
+}
+
+/**
+ * @brief Читает таблицу рекордов из файла
+ * @param[out] board Таблица
+ * @param path Файл таблицы
+ * @return 0 при успехе, 1 - файл не открылся (таблица пуста)
+ * @details Формат - строки "счет линии уровень время"; строки, которые
+ * начинаются с '#' или не разбираются, пропускаются
+ */
+int leaderboard_load(Leaderboard_t *board, const char *path) {
+  FILE *file = fopen(path, "r");
+  char line[128];
+  memset(board, 0, sizeof(*board));
+  while (file != NULL && fgets(line, sizeof(line), file) != NULL) {
+    ScoreEntry_t entry;
+    if (line[0] != '#' && sscanf(line, "%d %d %d %lld", &entry.score,
+                                 &entry.lines, &entry.level,
+                                 &entry.time) == 4)
+      leaderboard_insert(board, &entry);
+  }
+  if (file != NULL) fclose(file);
+  return file == NULL;
+}
+
+/**
+ * @brief Сбрасывает на диск каталог, в котором лежит файл
+ * @param path Путь к файлу
+ * @return 0 при успехе, 1 при ошибке
+ * @details Без этого rename() может не пережить сбой питания: новое имя
+ * хранится в записи каталога, а не в самом файле
+ */
+static int sync_parent(const char *path) {
+  char *dir = malloc(strlen(path) + 2);
+  int status = 1;
+  if (dir != NULL) {
+    strcpy(dir, path);
+    char *slash = strrchr(dir, '/');
+    if (slash == NULL)
+      strcpy(dir, ".");
+    else if (slash == dir)
+      dir[1] = '\0';
+    else
+      *slash = '\0';
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+      status = fsync(fd) != 0;
+      close(fd);
+    }
+  }
+  free(dir);
+  return status;
+}
+
+/**
+ * @brief Атомарно сохраняет таблицу рекордов в файл
+ * @param board Таблица
+ * @param path Файл таблицы
+ * @return 0 при успехе, 1 при ошибке (прежний файл не тронут, если
+ *         ошибка случилась до rename())
+ * @details Пишет path.tmp, сбрасывает его на диск, переименовывает
+ * поверх path и сбрасывает на диск каталог с новой записью
+ */
+int leaderboard_save(const Leaderboard_t *board, const char *path) {
+  size_t len = strlen(path);
+  char *temp = malloc(len + sizeof(".tmp"));
+  FILE *file = NULL;
+  int status = 1;
+  if (temp != NULL) {
+    memcpy(temp, path, len);
+    memcpy(temp + len, ".tmp", sizeof(".tmp"));
+    file = fopen(temp, "w");
+  }
+  if (file != NULL) {
+    int failed = fprintf(file, "# score lines level time\n") < 0;
+    for (int i = 0; i < board->count; i++) {
+      const ScoreEntry_t *entry = &board->entries[i];
+      if (fprintf(file, "%d %d %d %lld\n", entry->score, entry->lines,
+                  entry->level, entry->time) < 0)
+        failed = 1;
+    }
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) failed = 1;
+    if (fclose(file) != 0) failed = 1;
+    if (!failed && rename(temp, path) == 0)
+      status = sync_parent(path);
+    else
+      remove(temp);
+  }
+  free(temp);
+  return status;
+}
+
+/**
+ * @brief Строит путь к таблице рекордов по умолчанию
+ * @param data_home Значение $XDG_DATA_HOME (может быть NULL)
+ * @param home Значение $HOME (может быть NULL)
+ * @return Путь (освобождается free()) или NULL без памяти
+ * @details data_home/LEADERBOARD_DIR/LEADERBOARD_FILE; относительный или
+ * пустой data_home не считается (так велит XDG Base Directory), вместо
+ * него берется home/LEADERBOARD_DATA_HOME. Без home - LEADERBOARD_PATH
+ * относительно текущего каталога.
+ */
+char *leaderboard_path(const char *data_home, const char *home) {
+  static const char tail[] = "/" LEADERBOARD_DIR "/" LEADERBOARD_FILE;
+  const char *base = data_home;
+  const char *middle = "";
+  if (base == NULL || base[0] != '/') {
+    base = home != NULL && home[0] != '\0' ? home : NULL;
+    middle = "/" LEADERBOARD_DATA_HOME;
+  }
+  size_t size = base != NULL
+                    ? strlen(base) + strlen(middle) + sizeof(tail)
+                    : sizeof(LEADERBOARD_PATH);
+  char *path = malloc(size);
+  if (path != NULL && base != NULL)
+    snprintf(path, size, "%s%s%s", base, middle, tail);
+  else if (path != NULL)
+    strcpy(path, LEADERBOARD_PATH);
+  return path;
+}
+
+/**
+ * @brief Создает недостающие каталоги на пути к файлу
+ * @param path Путь к файлу
+ * @details Ошибки не проверяются: если каталог не создан, их покажет
+ * первое сохранение таблицы
+ */
+static void make_parents(char *path) {
+  for (char *slash = strchr(path + 1, '/'); slash != NULL;
+       slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    mkdir(path, 0700);
+    *slash = '/';
+  }
+}
+
+/**
+ * @brief Тело потока сохранения
+ * @param arg Указатель на ScoreStore_t
+ * @return NULL
+ * @details Сохраняет копию таблицы после каждого изменения; несколько
+ * изменений подряд сохраняются одной записью
+ */
+static void *score_store_thread(void *arg) {
+  ScoreStore_t *store = arg;
+  int active = 1;
+  pthread_mutex_lock(&store->lock);
+  while (active) {
+    while (!store->stop && store->version == store->saved)
+      pthread_cond_wait(&store->wake, &store->lock);
+    if (store->version != store->saved) {
+      Leaderboard_t board = store->board;
+      unsigned long version = store->version;
+      pthread_mutex_unlock(&store->lock);
+      int status = leaderboard_save(&board, store->path);
+      pthread_mutex_lock(&store->lock);
+      if (status != 0) store->error = 1;
+      store->saved = version;
+    } else {
+      active = 0;
+    }
+  }
+  pthread_mutex_unlock(&store->lock);
+  return NULL;
+}
+
+/**
+ * @brief Загружает таблицу рекордов и запускает поток сохранения
+ * @param path Файл таблицы (NULL - по умолчанию, см. leaderboard_path())
+ * @return Таблица или NULL при ошибке
+ * @details Для файла по умолчанию создаются недостающие каталоги. Если
+ * его еще нет, таблица переносится из LEADERBOARD_PATH прежних версий
+ * или рекорд - из файла прежнего формата LEADERBOARD_LEGACY_PATH.
+ */
+ScoreStore_t *score_store_open(const char *path) {
+  ScoreStore_t *store = calloc(1, sizeof(ScoreStore_t));
+  if (store != NULL && path == NULL) {
+    store->path = leaderboard_path(getenv("XDG_DATA_HOME"), getenv("HOME"));
+    if (store->path != NULL) make_parents(store->path);
+  } else if (store != NULL) {
+    store->path = malloc(strlen(path) + 1);
+    if (store->path != NULL) strcpy(store->path, path);
+  }
+  if (store != NULL && store->path != NULL) {
+    if (leaderboard_load(&store->board, store->path) != 0 && path == NULL) {
+      FILE *legacy = NULL;
+      if (strcmp(store->path, LEADERBOARD_PATH) != 0 &&
+          leaderboard_load(&store->board, LEADERBOARD_PATH) == 0)
+        store->version = 1;
+      else
+        legacy = fopen(LEADERBOARD_LEGACY_PATH, "r");
+      ScoreEntry_t entry = {0};
+      if (legacy != NULL) {
+        if (fscanf(legacy, "%d", &entry.score) == 1 &&
+            leaderboard_insert(&store->board, &entry) >= 0)
+          store->version = 1;
+        fclose(legacy);
+      }
+    }
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->wake, NULL);
+    if (pthread_create(&store->thread, NULL, score_store_thread, store) !=
+        0) {
+      pthread_mutex_destroy(&store->lock);
+      pthread_cond_destroy(&store->wake);
+      free(store->path);
+      store->path = NULL;
+    }
+  }
+  if (store != NULL && store->path == NULL) {
+    free(store);
+    store = NULL;
+  }
+  return store;
+}
+
+/**
+ * @brief Возвращает лучший счет таблицы
+ * @param store Таблица (NULL - таблицы нет)
+ * @return Лучший счет или 0
+ */
+int score_store_best(ScoreStore_t *store) {
+  int best = 0;
+  if (store != NULL) {
+    pthread_mutex_lock(&store->lock);
+    if (store->board.count > 0) best = store->board.entries[0].score;
+    pthread_mutex_unlock(&store->lock);
+  }
+  return best;
+}
+
+/**
+ * @brief Копирует текущую таблицу
+ * @param store Таблица
+ * @param[out] board Копия
+ */
+void score_store_get(ScoreStore_t *store, Leaderboard_t *board) {
+  pthread_mutex_lock(&store->lock);
+  *board = store->board;
+  pthread_mutex_unlock(&store->lock);
+}
+
+/**
+ * @brief Добавляет результат игры
+ * @param store Таблица (NULL - таблицы нет)
+ * @param entry Результат; нулевое время заменяется текущим
+ * @return Место в таблице (с 0) или -1, если результат в нее не попал
+ * @details Не обращается к диску: сохранение идет в потоке таблицы
+ */
+int score_store_submit(ScoreStore_t *store, const ScoreEntry_t *entry) {
+  int rank = -1;
+  if (store != NULL) {
+    ScoreEntry_t stamped = *entry;
+    if (stamped.time == 0) stamped.time = (long long)time(NULL);
+    pthread_mutex_lock(&store->lock);
+    rank = leaderboard_insert(&store->board, &stamped);
+    if (rank >= 0) {
+      store->version++;
+      pthread_cond_signal(&store->wake);
+    }
+    pthread_mutex_unlock(&store->lock);
+  }
+  return rank;
+}
+
+/**
+ * @brief Дожидается сохранения, останавливает поток и освобождает таблицу
+ * @param store Таблица (может быть NULL)
+ * @return 0 при успехе, 1 - какое-то сохранение не удалось
+ */
+int score_store_close(ScoreStore_t *store) {
+  int status = 0;
+  if (store != NULL) {
+    pthread_mutex_lock(&store->lock);
+    store->stop = 1;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+    pthread_join(store->thread, NULL);
+    status = store->error;
+    pthread_mutex_destroy(&store->lock);
+    pthread_cond_destroy(&store->wake);
+    free(store->path);
+    free(store);
+  }
+  return status;
+}
@@ -0,0 +1,70 @@
+#ifndef LEADERBOARD_TETRIS_H
+#define LEADERBOARD_TETRIS_H
+
+#include <pthread.h>
+
+#include "backend_tetris.h"
+
+#define LEADERBOARD_SIZE 10  ///< записей в таблице рекордов
+/// каталог таблицы рекордов по умолчанию внутри $XDG_DATA_HOME
+#define LEADERBOARD_DIR "tetris"
+/// файл таблицы рекордов по умолчанию внутри LEADERBOARD_DIR
+#define LEADERBOARD_FILE "leaderboard.txt"
+/// каталог данных, если $XDG_DATA_HOME не задан (относительно $HOME)
+#define LEADERBOARD_DATA_HOME ".local/share"
+/// таблица рекордов прежних версий и запасной путь без $HOME
+#define LEADERBOARD_PATH "build/leaderboard.txt"
+/// файл рекорда прежнего формата (одно число), читается при первом запуске
+#define LEADERBOARD_LEGACY_PATH "build/high_score.txt"
+
+/**
+ * @struct ScoreEntry_t
+ * @brief Запись таблицы рекордов
+ */
+typedef struct {
+  int score;  ///< Счет
+  int lines;  ///< Удалено линий
+  int level;  ///< Достигнутый уровень
+  long long time;  ///< Время окончания игры (секунды Unix)
+} ScoreEntry_t;
+
+/**
+ * @struct Leaderboard_t
+ * @brief Таблица рекордов, упорядоченная по убыванию счета
+ */
+typedef struct {
+  ScoreEntry_t entries[LEADERBOARD_SIZE];  ///< Записи
+  int count;  ///< Количество записей
+} Leaderboard_t;
+
+/**
+ * @struct ScoreStore_t
+ * @brief Таблица рекордов с сохранением в фоновом потоке
+ * @details Игра только меняет таблицу в памяти под мьютексом; файл
+ * переписывается в отдельном потоке через временный файл и rename(),
+ * поэтому на диске всегда целая таблица - старая или новая
+ */
+typedef struct {
+  char *path;             ///< Файл таблицы
+  pthread_t thread;       ///< Поток сохранения
+  pthread_mutex_t lock;   ///< Защищает board, version и stop
+  pthread_cond_t wake;    ///< Сигнал потоку сохранения
+  Leaderboard_t board;    ///< Таблица
+  unsigned long version;  ///< Номер изменения таблицы
+  unsigned long saved;  ///< Номер сохраненного изменения
+  int stop;   ///< Запрос завершения потока
+  int error;  ///< Была ошибка сохранения
+} ScoreStore_t;
+
+int leaderboard_insert(Leaderboard_t *board, const ScoreEntry_t *entry);
+int leaderboard_load(Leaderboard_t *board, const char *path);
+int leaderboard_save(const Leaderboard_t *board, const char *path);
+char *leaderboard_path(const char *data_home, const char *home);
+
+ScoreStore_t *score_store_open(const char *path);
+int score_store_best(ScoreStore_t *store);
+void score_store_get(ScoreStore_t *store, Leaderboard_t *board);
+int score_store_submit(ScoreStore_t *store, const ScoreEntry_t *entry);
+int score_store_close(ScoreStore_t *store);
+
+#endif  // LEADERBOARD_TETRIS_H
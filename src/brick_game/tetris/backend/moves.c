@@ -0,0 +1,251 @@
+#include "moves.h"
+
+#include "figures.h"
+
+/// Число возможных X фигуры (левый край области может уйти в стену)
+#define MOVES_COLS(game) ((game)->width + BOARD_WALL)
+/// Число возможных Y фигуры (верх области может уйти в буфер над полем)
+#define MOVES_ROWS(game) ((game)->height + BOARD_TOP)
+/// Наибольшее число состояний (x, y, поворот) в поиске
+#define MOVES_STATES (4 * (HEIGHT_MAX + BOARD_TOP) * (WIDTH_MAX + BOARD_WALL))
+
+/**
+ * @struct MoveNode_t
+ * @brief Состояние фигуры в очереди поиска в ширину
+ */
+typedef struct {
+  int8_t x, y, rotation;  ///< Положение фигуры
+  uint8_t move;  ///< Ход, которым состояние достигнуто
+  int16_t parent;  ///< Индекс предыдущего состояния (-1 - начало)
+} MoveNode_t;
+
+/**
+ * @brief Номер состояния фигуры в таблице посещенных
+ * @param game Указатель на структуру состояния игры (размеры поля)
+ * @param x X-координата фигуры
+ * @param y Y-координата фигуры
+ * @param rotation Поворот фигуры
+ * @return Номер состояния или -1, если положение вне таблицы
+ */
+static int state_index(const GameInfo_t *game, int x, int y, int rotation) {
+  int cols = MOVES_COLS(game), rows = MOVES_ROWS(game);
+  int col = x + BOARD_WALL, row = y + BOARD_TOP;
+  if (col < 0 || col >= cols || row < 0 || row >= rows) return -1;
+  return (rotation * rows + row) * cols + col;
+}
+
+/**
+ * @brief Отпечаток клеток фигуры на поле
+ * @param figure Фигура в конечном положении
+ * @param[out] top Строка поля верхней занятой строки фигуры
+ * @return Маски строк фигуры, прижатые к левому краю занятых столбцов, по
+ *         4 бита на строку, и над ними столбец поля левого края фигуры
+ * @details Разные повороты с одинаковыми клетками (S, Z) дают один отпечаток
+ */
+static uint64_t footprint(const Tetramino *figure, int *top) {
+  const FigureShape *shape = figure_shape(figure);
+  uint64_t key = (uint64_t)(uint8_t)(figure->x + shape->left) << 16;
+  for (int i = shape->top; i <= shape->bottom; i++)
+    key |= (uint64_t)(shape->mask[i] >> shape->left) << (4 * (i - shape->top));
+  *top = figure->y + shape->top;
+  return key;
+}
+
+/**
+ * @brief Добавляет состояние в очередь поиска, если оно еще не посещено
+ * @return Индекс нового узла в очереди или -1
+ */
+static int push_node(const GameInfo_t *game, MoveNode_t *queue, int *tail,
+                     uint8_t *visited, const Tetramino *figure, int parent,
+                     Move_t move) {
+  int index = state_index(game, figure->x, figure->y, figure->rotation);
+  int node = -1;
+  if (index >= 0 && !visited[index]) {
+    visited[index] = 1;
+    node = (*tail)++;
+    queue[node] = (MoveNode_t){(int8_t)figure->x, (int8_t)figure->y,
+                               (int8_t)figure->rotation, (uint8_t)move,
+                               (int16_t)parent};
+  }
+  return node;
+}
+
+/**
+ * @brief Записывает путь до узла очереди в конечное положение
+ * @return 1 если путь поместился в PLACEMENT_PATH_MAX, иначе 0
+ */
+static int fill_path(const MoveNode_t *queue, int node, Placement_t *place) {
+  int length = 0;
+  for (int i = node; queue[i].parent >= 0; i = queue[i].parent) length++;
+  int fits = length <= PLACEMENT_PATH_MAX;
+  if (fits) {
+    place->x = queue[node].x;
+    place->y = queue[node].y;
+    place->rotation = queue[node].rotation;
+    place->path_len = (uint8_t)length;
+    for (int i = node; queue[i].parent >= 0; i = queue[i].parent)
+      place->path[--length] = queue[i].move;
+  }
+  return fits;
+}
+
+/**
+ * @brief Перечисляет все достижимые конечные положения фигуры
+ * @param game Указатель на структуру состояния игры (только чтение поля)
+ * @param figure Начальное положение фигуры
+ * @param[out] out Массив для конечных положений
+ * @param capacity Размер массива out
+ * @return Количество записанных положений
+ * @details Поиск в ширину по состояниям (x, y, поворот) с ходами сдвига,
+ *          поворота по правилам rotate_tetramino(), опускания на строку и
+ *          сброса. Конечное положение - состояние, из которого фигура не
+ *          может опуститься; из него поиск не продолжается, потому что
+ *          лежащую на опоре фигуру фиксирует ближайший шаг гравитации.
+ *          Положения с одинаковыми клетками выдаются один раз, с кратчайшим
+ *          путем; сдвиги и повороты просматриваются раньше опускания, поэтому
+ *          путь обычно заканчивается сбросом. Память не выделяется.
+ */
+int generate_placements(const GameInfo_t *game, const Tetramino *figure,
+                        Placement_t *out, int capacity) {
+  MoveNode_t queue[MOVES_STATES];
+  uint8_t visited[MOVES_STATES];
+  uint64_t keys[PLACEMENTS_MAX];
+  int tops[PLACEMENTS_MAX];
+  int head = 0, tail = 0, count = 0;
+  if (capacity > PLACEMENTS_MAX) capacity = PLACEMENTS_MAX;
+  memset(visited, 0, 4 * MOVES_ROWS(game) * MOVES_COLS(game));
+  if (!figure_overlay(game, figure))
+    push_node(game, queue, &tail, visited, figure, -1, MOVE_DROP);
+  while (head < tail && count < capacity) {
+    int node = head++;
+    Tetramino current = *figure;
+    current.x = queue[node].x;
+    current.y = queue[node].y;
+    current.rotation = queue[node].rotation;
+
+    Tetramino next = current;
+    next.y++;
+    if (figure_overlay(game, &next)) {
+      int top, duplicate = 0;
+      uint64_t key = footprint(&current, &top);
+      for (int i = 0; i < count && !duplicate; i++)
+        duplicate = keys[i] == key && tops[i] == top;
+      if (!duplicate && fill_path(queue, node, &out[count])) {
+        keys[count] = key;
+        tops[count] = top;
+        count++;
+      }
+    } else {
+      Tetramino shifted = current;
+      shifted.x--;
+      if (!figure_overlay(game, &shifted))
+        push_node(game, queue, &tail, visited, &shifted, node, MOVE_LEFT);
+      shifted.x += 2;
+      if (!figure_overlay(game, &shifted))
+        push_node(game, queue, &tail, visited, &shifted, node, MOVE_RIGHT);
+      shifted = current;
+      if (rotate_tetramino(game, &shifted))
+        push_node(game, queue, &tail, visited, &shifted, node, MOVE_ROTATE);
+      shifted = current;
+      shifted.y = landing_y(game, &current);
+      push_node(game, queue, &tail, visited, &shifted, node, MOVE_DROP);
+      push_node(game, queue, &tail, visited, &next, node, MOVE_SOFT);
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Перечисляет положения фигуры, достижимые поворотом, сдвигом и сбросом
+ * @param game Указатель на структуру состояния игры (только чтение поля)
+ * @param figure Начальное положение фигуры
+ * @param[out] out Массив для конечных положений
+ * @param capacity Размер массива out
+ * @return Количество записанных положений
+ * @details Быстрый вариант generate_placements() без поиска: фигура
+ *          поворачивается на месте (если поворот запрещен над полем, сначала
+ *          опускается), затем сдвигается влево или вправо до упора, и на
+ *          каждом столбце сбрасывается. Подкладывания под нависающие клетки
+ *          не находятся, зато на одно положение уходит несколько проверок
+ *          наложения.
+ */
+int generate_drops(const GameInfo_t *game, const Tetramino *figure,
+                   Placement_t *out, int capacity) {
+  uint64_t keys[PLACEMENTS_MAX];
+  int tops[PLACEMENTS_MAX];
+  int count = 0;
+  int rotations = figure_info(figure->id)->rotations;
+  if (capacity > PLACEMENTS_MAX) capacity = PLACEMENTS_MAX;
+  Tetramino turned = *figure;
+  Placement_t base = {0};
+  int reachable = !figure_overlay(game, figure);
+  for (int r = 0; r < rotations && reachable; r++) {
+    if (r > 0) {
+      while (reachable && !rotate_tetramino(game, &turned)) {
+        Tetramino lower = turned;
+        lower.y++;
+        reachable = turned.y < 0 && !figure_overlay(game, &lower) &&
+                    base.path_len < PLACEMENT_PATH_MAX - game->width - 1;
+        if (reachable) {
+          turned = lower;
+          base.path[base.path_len++] = MOVE_SOFT;
+        }
+      }
+      if (reachable) base.path[base.path_len++] = MOVE_ROTATE;
+    }
+    for (int dir = -1; dir <= 1 && reachable; dir += 2) {
+      Tetramino shifted = turned;
+      Placement_t place = base;
+      if (dir == 1) {
+        shifted.x++;
+        place.path[place.path_len++] = MOVE_RIGHT;
+      }
+      while (count < capacity && !figure_overlay(game, &shifted)) {
+        Tetramino landed = shifted;
+        landed.y = landing_y(game, &shifted);
+        int top, duplicate = 0;
+        uint64_t key = footprint(&landed, &top);
+        for (int i = 0; i < count && !duplicate; i++)
+          duplicate = keys[i] == key && tops[i] == top;
+        if (!duplicate) {
+          out[count] = place;
+          out[count].x = (int8_t)landed.x;
+          out[count].y = (int8_t)landed.y;
+          out[count].rotation = (int8_t)landed.rotation;
+          out[count].path[out[count].path_len++] = MOVE_DROP;
+          keys[count] = key;
+          tops[count] = top;
+          count++;
+        }
+        shifted.x += dir;
+        place.path[place.path_len++] = dir < 0 ? MOVE_LEFT : MOVE_RIGHT;
+      }
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Выполняет ход генератора положений над текущей фигурой
+ * @param game Указатель на структуру состояния игры
+ * @param move Ход из пути Placement_t
+ */
+void apply_move(GameInfo_t *game, Move_t move) {
+  switch (move) {
+    case MOVE_LEFT:
+      move_left(game);
+      break;
+    case MOVE_RIGHT:
+      move_right(game);
+      break;
+    case MOVE_ROTATE:
+      rotate_figure(game);
+      break;
+    case MOVE_SOFT:
+      move_down(game);
+      break;
+    case MOVE_DROP:
+      game->current.y = landing_y(game, &game->current);
+      break;
+  }
+}
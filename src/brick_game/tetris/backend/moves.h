@@ -0,0 +1,40 @@
+#ifndef MOVES_TETRIS_H
+#define MOVES_TETRIS_H
+
+#include "backend_tetris.h"
+
+/// Наибольшее число конечных положений, которое может вернуть генератор
+#define PLACEMENTS_MAX 256
+/// Наибольшая длина пути до конечного положения
+#define PLACEMENT_PATH_MAX 64
+
+/**
+ * @enum Move_t
+ * @brief Элементарные ходы фигуры для генератора положений
+ */
+typedef enum {
+  MOVE_LEFT,    ///< Сдвиг влево (move_left)
+  MOVE_RIGHT,   ///< Сдвиг вправо (move_right)
+  MOVE_ROTATE,  ///< Поворот со смещениями (rotate_figure)
+  MOVE_SOFT,  ///< Опускание на одну строку (шаг гравитации)
+  MOVE_DROP  ///< Сброс до упора (Down)
+} Move_t;
+
+/**
+ * @struct Placement_t
+ * @brief Достижимое конечное положение фигуры и путь к нему
+ */
+typedef struct {
+  int8_t x, y;       ///< Координаты фигуры на поле
+  int8_t rotation;   ///< Поворот фигуры
+  uint8_t path_len;  ///< Количество ходов в пути
+  uint8_t path[PLACEMENT_PATH_MAX];  ///< Ходы от начального положения
+} Placement_t;
+
+int generate_placements(const GameInfo_t *game, const Tetramino *figure,
+                        Placement_t *out, int capacity);
+int generate_drops(const GameInfo_t *game, const Tetramino *figure,
+                   Placement_t *out, int capacity);
+void apply_move(GameInfo_t *game, Move_t move);
+
+#endif  // MOVES_TETRIS_H
@@ -0,0 +1,239 @@
+#include "protocol.h"
+
+/**
+ * @brief Записывает число в little-endian
+ * @param[out] out Буфер
+ * @param value Число
+ * @param bytes Сколько младших байт записать (1-8)
+ */
+void proto_put(uint8_t *out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) out[i] = (uint8_t)(value >> 8 * i);
+}
+
+/**
+ * @brief Читает число в little-endian
+ * @param in Буфер
+ * @param bytes Сколько байт прочитать (1-8)
+ * @return Число
+ */
+uint64_t proto_get(const uint8_t *in, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++) value |= (uint64_t)in[i] << 8 * i;
+  return value;
+}
+
+/**
+ * @brief Записывает заголовок сообщения
+ * @param[out] out Буфер не меньше PROTO_HEADER_SIZE байт
+ * @param header Заголовок
+ */
+void proto_put_header(uint8_t *out, const ProtoHeader_t *header) {
+  proto_put(out, header->size, 4);
+  out[4] = header->type;
+  out[5] = header->status;
+  proto_put(out + 6, header->count, 2);
+}
+
+/**
+ * @brief Разбирает заголовок сообщения
+ * @param in Буфер не меньше PROTO_HEADER_SIZE байт
+ * @param[out] header Заголовок
+ */
+void proto_get_header(const uint8_t *in, ProtoHeader_t *header) {
+  header->size = (uint32_t)proto_get(in, 4);
+  header->type = in[4];
+  header->status = in[5];
+  header->count = (uint16_t)proto_get(in + 6, 2);
+}
+
+/**
+ * @brief Определяет, пришло ли сообщение целиком
+ * @param data Начало принятых данных
+ * @param size Принято байт
+ * @return Размер первого сообщения, если оно пришло целиком; 0 - нужно
+ *         больше данных; -1 - размер в заголовке меньше заголовка или
+ *         больше PROTO_REQUEST_MAX
+ */
+long proto_frame_size(const uint8_t *data, size_t size) {
+  long frame = 0;
+  if (size >= PROTO_HEADER_SIZE) {
+    uint32_t declared = (uint32_t)proto_get(data, 4);
+    if (declared < PROTO_HEADER_SIZE || declared > PROTO_REQUEST_MAX)
+      frame = -1;
+    else if (declared <= size)
+      frame = (long)declared;
+  }
+  return frame;
+}
+
+/**
+ * @brief Обеспечивает место в буфере сообщений
+ * @param buffer Буфер
+ * @param extra Сколько байт нужно дописать
+ * @return 0 при успехе, 1 при нехватке памяти
+ */
+int proto_buffer_reserve(ProtoBuffer_t *buffer, size_t extra) {
+  int status = 0;
+  if (buffer->len + extra > buffer->cap) {
+    size_t cap = buffer->cap > 0 ? buffer->cap : 4096;
+    while (cap < buffer->len + extra) cap *= 2;
+    uint8_t *grown = realloc(buffer->data, cap);
+    if (grown != NULL) {
+      buffer->data = grown;
+      buffer->cap = cap;
+    } else {
+      status = 1;
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Освобождает буфер сообщений
+ * @param buffer Буфер
+ */
+void proto_buffer_free(ProtoBuffer_t *buffer) {
+  free(buffer->data);
+  memset(buffer, 0, sizeof(*buffer));
+}
+
+/**
+ * @brief Задает исходное состояние игры, от которого идет первая дельта
+ * @param[out] view Состояние
+ * @param height Высота поля
+ * @param width Ширина поля
+ */
+void game_view_init(GameView_t *view, int height, int width) {
+  memset(view, 0, sizeof(*view));
+  view->height = (uint8_t)height;
+  view->width = (uint8_t)width;
+}
+
+/**
+ * @brief Записывает дельту состояния игры и обновляет видимое состояние
+ * @param view Состояние, которое видел клиент; становится текущим
+ * @param game Указатель на состояние игры
+ * @param[out] out Буфер не меньше PROTO_DELTA_MAX байт
+ * @return Длина дельты в байтах
+ * @details Строки сравниваются по битборду, поэтому дельта шага без
+ * фиксации фигуры - несколько байт
+ */
+int game_view_delta(GameView_t *view, const GameInfo_t *game, uint8_t *out) {
+  int len = 2;
+  uint8_t flags = 0;
+  uint64_t changed = 0;
+  uint16_t mask = (uint16_t)((1u << view->width) - 1);
+  view->state = (uint8_t)game->state;
+  if (memcmp(&view->current, &game->current, sizeof(Tetramino)) != 0) {
+    view->current = game->current;
+    memcpy(out + len, &game->current, sizeof(Tetramino));
+    len += 4;
+    flags |= DELTA_PIECE;
+  }
+  if (memcmp(&view->next, &game->next, sizeof(Tetramino)) != 0) {
+    view->next = game->next;
+    memcpy(out + len, &game->next, sizeof(Tetramino));
+    len += 4;
+    flags |= DELTA_NEXT;
+  }
+  if (view->score != game->score || view->lines != (uint32_t)game->lines ||
+      view->level != game->level) {
+    view->score = game->score;
+    view->lines = (uint32_t)game->lines;
+    view->level = (uint8_t)game->level;
+    proto_put(out + len, (uint32_t)view->score, 4);
+    proto_put(out + len + 4, view->lines, 4);
+    out[len + 8] = view->level;
+    len += 9;
+    flags |= DELTA_STATS;
+  }
+  for (int y = 0; y < view->height; y++) {
+    uint16_t row = (uint16_t)(game->rows[BOARD_TOP + y] >> BOARD_WALL) & mask;
+    if (row != view->rows[y]) changed |= 1ull << y;
+  }
+  if (changed != 0) {
+    proto_put(out + len, changed, 8);
+    len += 8;
+    for (uint64_t rest = changed; rest != 0; rest &= rest - 1) {
+      int y = __builtin_ctzll(rest);
+      view->rows[y] =
+          (uint16_t)(game->rows[BOARD_TOP + y] >> BOARD_WALL) & mask;
+      proto_put(out + len, view->rows[y], 2);
+      len += 2;
+    }
+    flags |= DELTA_ROWS;
+  }
+  out[0] = view->state;
+  out[1] = flags;
+  return len;
+}
+
+/**
+ * @brief Вычисляет длину дельты в ответе
+ * @param view Состояние игры у клиента (нужна высота поля)
+ * @param data Начало дельты
+ * @param size Байт от начала дельты до конца ответа
+ * @return Длина дельты или 0, если она обрезана
+ */
+static size_t delta_size(const GameView_t *view, const uint8_t *data,
+                         size_t size) {
+  size_t len = 0;
+  if (size >= 2) {
+    uint8_t flags = data[1];
+    len = 2 + (flags & DELTA_PIECE ? 4 : 0) + (flags & DELTA_NEXT ? 4 : 0) +
+          (flags & DELTA_STATS ? 9 : 0) + (flags & DELTA_ROWS ? 8 : 0);
+    if (len <= size && (flags & DELTA_ROWS)) {
+      uint64_t changed = proto_get(data + len - 8, 8);
+      if (view->height < 64) changed &= (1ull << view->height) - 1;
+      len += 2 * (size_t)__builtin_popcountll(changed);
+    }
+    if (len > size) len = 0;
+  }
+  return len;
+}
+
+/**
+ * @brief Накладывает дельту из ответа на видимое состояние игры
+ * @param view Состояние игры у клиента
+ * @param data Данные ответа
+ * @param size Размер данных
+ * @param pos Позиция дельты; сдвигается за нее, если дельта не обрезана
+ * @return 0 при успехе, 1 - дельта обрезана или в ней флаг DELTA_NO_GAME
+ */
+int game_view_apply(GameView_t *view, const uint8_t *data, size_t size,
+                    size_t *pos) {
+  const uint8_t *delta = data + *pos;
+  size_t len = *pos < size ? delta_size(view, delta, size - *pos) : 0;
+  int status = len == 0 || (delta[1] & DELTA_NO_GAME);
+  if (status == 0) {
+    uint8_t flags = delta[1];
+    size_t at = 2;
+    view->state = delta[0];
+    if (flags & DELTA_PIECE) {
+      memcpy(&view->current, delta + at, sizeof(Tetramino));
+      at += 4;
+    }
+    if (flags & DELTA_NEXT) {
+      memcpy(&view->next, delta + at, sizeof(Tetramino));
+      at += 4;
+    }
+    if (flags & DELTA_STATS) {
+      view->score = (int32_t)proto_get(delta + at, 4);
+      view->lines = (uint32_t)proto_get(delta + at + 4, 4);
+      view->level = delta[at + 8];
+      at += 9;
+    }
+    if (flags & DELTA_ROWS) {
+      uint64_t changed = proto_get(delta + at, 8);
+      if (view->height < 64) changed &= (1ull << view->height) - 1;
+      at += 8;
+      for (; changed != 0; changed &= changed - 1) {
+        view->rows[__builtin_ctzll(changed)] =
+            (uint16_t)proto_get(delta + at, 2);
+        at += 2;
+      }
+    }
+  }
+  *pos += len;
+  return status;
+}
@@ -0,0 +1,127 @@
+#ifndef PROTOCOL_TETRIS_H
+#define PROTOCOL_TETRIS_H
+
+#include "backend_tetris.h"
+
+/**
+ * @defgroup protocol Протокол игрового сервера
+ * @brief Двоичные сообщения между tetris_server и ботами
+ * @details Все числа - little-endian. Сообщение начинается заголовком
+ * PROTO_HEADER_SIZE байт: размер всего сообщения (u32), тип (u8), статус
+ * (u8, в запросе 0) и количество записей (u16). Ответ имеет тип запроса с
+ * битом PROTO_REPLY.
+ *
+ * - CREATE: seed (u64), способ выбора фигур, высота, ширина (u8, 0 - по
+ *   умолчанию), резерв (u8). Ответ: номер игры (u32), высота и ширина
+ *   (u8), затем полная дельта состояния.
+ * - STEP: count записей по PROTO_STEP_SIZE байт: номер игры (u32),
+ *   приращение виртуальных часов в мс (u16), действие (i8, -1 - шаг без
+ *   ввода). Ответ: count дельт, по одной на шаг, в том же порядке.
+ * - DESTROY: номер игры (u32). Ответ без данных.
+ *
+ * Дельта: состояние автомата (u8), флаги изменений (u8), затем по
+ * флагам: текущая фигура (4 байта: x, y, номер, поворот), следующая
+ * фигура (4 байта), счет (i32), линии (u32) и уровень (u8), маска
+ * изменившихся строк поля (u64) и занятость этих строк сверху вниз (u16,
+ * бит j - столбец j). Дельта считается от состояния, которое владелец
+ * игры видел после прошлого ответа (см. GameView_t).
+ * @{
+ */
+
+#define PROTO_HEADER_SIZE 8  ///< размер заголовка сообщения
+#define PROTO_CREATE_SIZE 12  ///< данные запроса CREATE
+#define PROTO_STEP_SIZE 7     ///< запись шага в запросе STEP
+#define PROTO_STEPS_MAX 4096  ///< наибольшее число шагов в запросе STEP
+#define PROTO_REPLY 0x80  ///< бит ответа в типе сообщения
+/// наибольший размер запроса
+#define PROTO_REQUEST_MAX \
+  (PROTO_HEADER_SIZE + PROTO_STEPS_MAX * PROTO_STEP_SIZE)
+/// наибольший размер дельты
+#define PROTO_DELTA_MAX (2 + 4 + 4 + 9 + 8 + 2 * HEIGHT_MAX)
+
+/// флаги изменений в дельте
+#define DELTA_PIECE 0x01  ///< изменилась текущая фигура
+#define DELTA_NEXT 0x02  ///< изменилась следующая фигура
+#define DELTA_STATS 0x04  ///< изменились счет, линии или уровень
+#define DELTA_ROWS 0x08  ///< изменились строки поля
+#define DELTA_NO_GAME 0x80  ///< игры с таким номером у клиента нет
+
+/**
+ * @enum ProtoType_t
+ * @brief Типы сообщений
+ */
+typedef enum {
+  PROTO_CREATE = 1,  ///< Создать игру
+  PROTO_STEP,        ///< Выполнить пачку шагов
+  PROTO_DESTROY      ///< Удалить игру
+} ProtoType_t;
+
+/**
+ * @enum ProtoStatus_t
+ * @brief Статусы ответа
+ */
+typedef enum {
+  PROTO_OK = 0,       ///< Запрос выполнен
+  PROTO_BAD_MESSAGE,  ///< Неизвестный тип или неверный размер запроса
+  PROTO_BAD_GAME,  ///< Игры с таким номером у клиента нет
+  PROTO_BAD_CONFIG,  ///< Недопустимые параметры игры
+  PROTO_FULL  ///< Достигнут предел игр или нет памяти
+} ProtoStatus_t;
+
+/**
+ * @struct ProtoHeader_t
+ * @brief Разобранный заголовок сообщения
+ */
+typedef struct {
+  uint32_t size;   ///< Размер всего сообщения
+  uint8_t type;    ///< Тип (ProtoType_t, в ответе с PROTO_REPLY)
+  uint8_t status;  ///< Статус ответа (ProtoStatus_t)
+  uint16_t count;  ///< Количество записей
+} ProtoHeader_t;
+
+/**
+ * @struct GameView_t
+ * @brief Состояние игры, каким его видит клиент
+ * @details Сервер хранит его для каждой игры и считает от него дельты,
+ * клиент накладывает на него дельты из ответов
+ */
+typedef struct {
+  uint8_t state;      ///< Состояние автомата (GameState_t)
+  uint8_t height;     ///< Высота поля
+  uint8_t width;      ///< Ширина поля
+  Tetramino current;  ///< Текущая фигура
+  Tetramino next;     ///< Следующая фигура
+  int32_t score;      ///< Счет
+  uint32_t lines;     ///< Удалено линий
+  uint8_t level;      ///< Уровень
+  uint16_t rows[HEIGHT_MAX];  ///< Занятость строк поля (бит j - столбец j)
+} GameView_t;
+
+/**
+ * @struct ProtoBuffer_t
+ * @brief Растущий буфер сообщений
+ */
+typedef struct {
+  uint8_t *data;  ///< Данные
+  size_t len;     ///< Заполнено байт
+  size_t cap;     ///< Емкость
+} ProtoBuffer_t;
+
+_Static_assert(WIDTH_MAX <= 16, "строка поля в дельте - 16 бит");
+
+void proto_put(uint8_t *out, uint64_t value, int bytes);
+uint64_t proto_get(const uint8_t *in, int bytes);
+void proto_put_header(uint8_t *out, const ProtoHeader_t *header);
+void proto_get_header(const uint8_t *in, ProtoHeader_t *header);
+long proto_frame_size(const uint8_t *data, size_t size);
+int proto_buffer_reserve(ProtoBuffer_t *buffer, size_t extra);
+void proto_buffer_free(ProtoBuffer_t *buffer);
+
+void game_view_init(GameView_t *view, int height, int width);
+int game_view_delta(GameView_t *view, const GameInfo_t *game, uint8_t *out);
+int game_view_apply(GameView_t *view, const uint8_t *data, size_t size,
+                    size_t *pos);
+
+/** @} */  // Конец группы protocol
+
+#endif  // PROTOCOL_TETRIS_H
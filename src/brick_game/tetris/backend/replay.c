@@ -0,0 +1,374 @@
+#include "replay.h"
+
+/**
+ * @brief Записывает число в формате varint (LEB128)
+ * @param out Буфер не меньше REPLAY_VARINT_MAX байт
+ * @param value Число
+ * @return Количество записанных байт
+ */
+int replay_put_varint(uint8_t *out, uint64_t value) {
+  int len = 0;
+  while (value >= 0x80) {
+    out[len++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[len++] = (uint8_t)value;
+  return len;
+}
+
+/**
+ * @brief Читает число в формате varint (LEB128)
+ * @param data Данные
+ * @param size Размер данных
+ * @param[in,out] pos Позиция чтения, сдвигается за прочитанное число
+ * @param[out] value Число
+ * @return 1 при успехе, 0 - данные кончились или число длиннее
+ *         REPLAY_VARINT_MAX байт (pos при этом не меняется)
+ */
+int replay_get_varint(const uint8_t *data, size_t size, size_t *pos,
+                      uint64_t *value) {
+  uint64_t result = 0;
+  size_t i = *pos;
+  int done = 0;
+  for (int shift = 0; !done && i < size && shift < 7 * REPLAY_VARINT_MAX;
+       shift += 7) {
+    result |= (uint64_t)(data[i] & 0x7F) << shift;
+    done = !(data[i++] & 0x80);
+  }
+  if (done) {
+    *pos = i;
+    *value = result;
+  }
+  return done;
+}
+
+/**
+ * @brief Формирует заголовок записи
+ * @param config Параметры игры (seed, способ выбора фигур и размеры поля)
+ * @param[out] header Заголовок
+ */
+void replay_header(const TetrisConfig_t *config,
+                   uint8_t header[REPLAY_HEADER_SIZE]) {
+  memset(header, 0, REPLAY_HEADER_SIZE);
+  memcpy(header, REPLAY_MAGIC, 4);
+  header[4] = REPLAY_VERSION;
+  header[5] = (uint8_t)config->randomizer;
+  header[6] = (uint8_t)config->height;
+  header[7] = (uint8_t)config->width;
+  for (int i = 0; i < 8; i++) header[8 + i] = (uint8_t)(config->seed >> 8 * i);
+}
+
+/**
+ * @brief Начинает чтение записи
+ * @param[out] reader Состояние чтения
+ * @param data Данные записи (должны жить, пока идет чтение)
+ * @param size Размер данных
+ * @return 0 при успехе, 1 - данные не являются записью этой версии
+ */
+int replay_reader_init(ReplayReader_t *reader, const uint8_t *data,
+                       size_t size) {
+  int status = 1;
+  memset(reader, 0, sizeof(*reader));
+  if (data != NULL && size >= REPLAY_HEADER_SIZE &&
+      memcmp(data, REPLAY_MAGIC, 4) == 0 && data[4] == REPLAY_VERSION) {
+    reader->data = data;
+    reader->size = size;
+    reader->pos = REPLAY_HEADER_SIZE;
+    reader->config.randomizer = data[5];
+    reader->config.height = data[6];
+    reader->config.width = data[7];
+    for (int i = 0; i < 8; i++)
+      reader->config.seed |= (uint64_t)data[8 + i] << 8 * i;
+    status = 0;
+  }
+  return status;
+}
+
+/**
+ * @brief Читает следующий шаг записи
+ * @param reader Состояние чтения
+ * @param[out] record Шаг
+ * @return 1, если шаг прочитан, 0 - запись кончилась
+ */
+int replay_next(ReplayReader_t *reader, ReplayRecord_t *record) {
+  uint64_t value;
+  int found = replay_get_varint(reader->data, reader->size, &reader->pos,
+                                &value);
+  if (found) {
+    reader->time += (long long)(value >> REPLAY_ACTION_BITS);
+    record->time = reader->time;
+    record->action =
+        (UserAction_t)((int)(value & ((1u << REPLAY_ACTION_BITS) - 1)) - 1);
+  }
+  return found;
+}
+
+/**
+ * @brief Читает файл записи в память
+ * @param path Путь к файлу
+ * @param[out] size Размер прочитанных данных
+ * @return Данные (освобождаются free()) или NULL при ошибке
+ */
+uint8_t *replay_load(const char *path, size_t *size) {
+  FILE *file = fopen(path, "rb");
+  uint8_t *data = NULL;
+  *size = 0;
+  if (file != NULL) {
+    long length = -1;
+    if (fseek(file, 0, SEEK_END) == 0) length = ftell(file);
+    if (length > 0 && fseek(file, 0, SEEK_SET) == 0)
+      data = malloc((size_t)length);
+    if (data != NULL && fread(data, 1, (size_t)length, file) !=
+                            (size_t)length) {
+      free(data);
+      data = NULL;
+    }
+    if (data != NULL) *size = (size_t)length;
+    fclose(file);
+  }
+  return data;
+}
+
+/**
+ * @brief Выполняет следующий шаг записи
+ * @param game Игра на виртуальных часах (GAME_VIRTUAL_CLOCK)
+ * @param reader Состояние чтения записи этой игры
+ * @return 1, если шаг выполнен, 0 - запись кончилась
+ * @details Часы игры перед шагом выставляются на записанное время
+ */
+int replay_step(GameInfo_t *game, ReplayReader_t *reader) {
+  ReplayRecord_t record;
+  int found = replay_next(reader, &record);
+  if (found) {
+    tetris_advance_clock(game, record.time - game->clock);
+    tetris_step(game, record.action);
+  }
+  return found;
+}
+
+/**
+ * @brief Проигрывает запись с полной скоростью
+ * @param data Данные записи
+ * @param size Размер данных
+ * @return Состояние игры после последнего шага (освобождается
+ *         tetris_destroy()) или NULL, если данные не являются записью
+ * @details Игра идет на виртуальных часах, которые перед каждым шагом
+ * выставляются на записанное время, поэтому шаги повторяются в точности
+ */
+GameInfo_t *replay_play(const uint8_t *data, size_t size) {
+  ReplayReader_t reader;
+  GameInfo_t *game = NULL;
+  if (replay_reader_init(&reader, data, size) == 0) {
+    reader.config.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST;
+    game = tetris_create(&reader.config);
+  }
+  int stepping = game != NULL;
+  while (stepping) stepping = replay_step(game, &reader);
+  return game;
+}
+
+/**
+ * @brief Тело потока записи
+ * @param arg Указатель на ReplayWriter_t
+ * @return NULL
+ * @details Забирает переданный буфер, отдает взамен свой пустой и пишет
+ * данные в файл уже без мьютекса
+ */
+static void *replay_writer_thread(void *arg) {
+  ReplayWriter_t *writer = arg;
+  uint8_t *buffer = NULL;
+  size_t cap = 0;
+  int active = 1;
+  while (active) {
+    size_t len = 0;
+    pthread_mutex_lock(&writer->lock);
+    while (!writer->stop && writer->pending_len == 0)
+      pthread_cond_wait(&writer->wake, &writer->lock);
+    if (writer->pending_len > 0) {
+      uint8_t *full = writer->pending;
+      size_t full_cap = writer->pending_cap;
+      len = writer->pending_len;
+      writer->pending = buffer;
+      writer->pending_cap = cap;
+      writer->pending_len = 0;
+      buffer = full;
+      cap = full_cap;
+    } else {
+      active = 0;
+    }
+    pthread_mutex_unlock(&writer->lock);
+    if (len > 0 && (fwrite(buffer, 1, len, writer->file) != len ||
+                    fflush(writer->file) != 0))
+      writer->error = 1;
+  }
+  free(buffer);
+  return NULL;
+}
+
+/**
+ * @brief Начинает запись игры в буфер в памяти
+ * @param buffer Буфер (пустой или уже использованный)
+ * @param config Параметры игры: seed и способ выбора фигур
+ * @return 0 при успехе, 1 при нехватке памяти
+ * @details Прежнее содержимое отбрасывается, память переиспользуется
+ */
+int replay_buffer_start(ReplayBuffer_t *buffer, const TetrisConfig_t *config) {
+  buffer->len = 0;
+  buffer->time = 0;
+  int status = replay_buffer_reserve(buffer, REPLAY_HEADER_SIZE);
+  if (status == 0) {
+    replay_header(config, buffer->data);
+    buffer->len = REPLAY_HEADER_SIZE;
+  }
+  return status;
+}
+
+/**
+ * @brief Обеспечивает место в буфере записи
+ * @param buffer Буфер
+ * @param extra Сколько байт нужно дописать
+ * @return 0 при успехе, 1 при нехватке памяти
+ */
+int replay_buffer_reserve(ReplayBuffer_t *buffer, size_t extra) {
+  int status = 0;
+  if (buffer->len + extra > buffer->cap) {
+    size_t cap = buffer->cap > 0 ? buffer->cap : REPLAY_BUFFER;
+    while (cap < buffer->len + extra) cap *= 2;
+    uint8_t *grown = realloc(buffer->data, cap);
+    if (grown != NULL) {
+      buffer->data = grown;
+      buffer->cap = cap;
+    } else {
+      status = 1;
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Дописывает шаг автомата в буфер записи
+ * @param buffer Буфер
+ * @param time Время игры на этом шаге
+ * @param action Действие шага
+ * @return 0 при успехе, 1 при нехватке памяти (шаг не записан)
+ */
+int replay_buffer_record(ReplayBuffer_t *buffer, long long time,
+                         UserAction_t action) {
+  long long delta = time > buffer->time ? time - buffer->time : 0;
+  uint64_t value =
+      (uint64_t)delta << REPLAY_ACTION_BITS | (uint64_t)(action + 1);
+  int status = replay_buffer_reserve(buffer, REPLAY_VARINT_MAX);
+  if (status == 0) {
+    buffer->len += replay_put_varint(buffer->data + buffer->len, value);
+    buffer->time += delta;
+  }
+  return status;
+}
+
+/**
+ * @brief Освобождает память буфера записи
+ * @param buffer Буфер
+ */
+void replay_buffer_free(ReplayBuffer_t *buffer) {
+  free(buffer->data);
+  memset(buffer, 0, sizeof(*buffer));
+}
+
+/**
+ * @brief Открывает файл записи и запускает поток записи
+ * @param path Путь к файлу (перезаписывается)
+ * @param config Параметры игры: seed и способ выбора фигур
+ * @return Состояние записи или NULL при ошибке
+ * @details Время шагов отсчитывается от нуля, поэтому игра должна идти на
+ * виртуальных часах, запущенных с нуля (GAME_VIRTUAL_CLOCK)
+ */
+ReplayWriter_t *replay_writer_open(const char *path,
+                                   const TetrisConfig_t *config) {
+  ReplayWriter_t *writer = calloc(1, sizeof(ReplayWriter_t));
+  if (writer != NULL) {
+    int status = replay_buffer_start(&writer->active, config);
+    writer->file = fopen(path, "wb");
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->wake, NULL);
+    if (status != 0 || writer->file == NULL ||
+        pthread_create(&writer->thread, NULL, replay_writer_thread,
+                       writer) != 0) {
+      if (writer->file != NULL) fclose(writer->file);
+      pthread_mutex_destroy(&writer->lock);
+      pthread_cond_destroy(&writer->wake);
+      replay_buffer_free(&writer->active);
+      free(writer);
+      writer = NULL;
+    }
+  }
+  return writer;
+}
+
+/**
+ * @brief Записывает шаг автомата
+ * @param writer Состояние записи (NULL - запись выключена)
+ * @param time Время игры на этом шаге
+ * @param action Действие шага
+ * @details Не ждет ввода-вывода: заполненный буфер передается потоку
+ * записи, только если тот свободен, иначе игровой буфер растет
+ */
+void replay_record(ReplayWriter_t *writer, long long time,
+                   UserAction_t action) {
+  if (writer != NULL) {
+    if (replay_buffer_record(&writer->active, time, action) != 0)
+      writer->lost = 1;
+    if (writer->active.len >= REPLAY_BUFFER) replay_flush(writer);
+  }
+}
+
+/**
+ * @brief Передает накопленные шаги потоку записи
+ * @param writer Состояние записи (NULL - запись выключена)
+ * @details Если поток записи еще занят предыдущим буфером, шаги остаются
+ * в игровом буфере до следующего вызова
+ */
+void replay_flush(ReplayWriter_t *writer) {
+  if (writer != NULL && writer->active.len > 0) {
+    pthread_mutex_lock(&writer->lock);
+    if (writer->pending_len == 0) {
+      uint8_t *empty = writer->pending;
+      size_t empty_cap = writer->pending_cap;
+      writer->pending = writer->active.data;
+      writer->pending_cap = writer->active.cap;
+      writer->pending_len = writer->active.len;
+      writer->active.data = empty;
+      writer->active.cap = empty_cap;
+      writer->active.len = 0;
+      pthread_cond_signal(&writer->wake);
+    }
+    pthread_mutex_unlock(&writer->lock);
+  }
+}
+
+/**
+ * @brief Дописывает все шаги, останавливает поток и закрывает файл
+ * @param writer Состояние записи (может быть NULL)
+ * @return 0 при успехе, 1 - часть записи потеряна
+ */
+int replay_writer_close(ReplayWriter_t *writer) {
+  int status = 0;
+  if (writer != NULL) {
+    pthread_mutex_lock(&writer->lock);
+    writer->stop = 1;
+    pthread_cond_signal(&writer->wake);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+    if (writer->active.len > 0 &&
+        fwrite(writer->active.data, 1, writer->active.len, writer->file) !=
+            writer->active.len)
+      writer->error = 1;
+    if (fclose(writer->file) != 0) writer->error = 1;
+    status = writer->error || writer->lost;
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->wake);
+    replay_buffer_free(&writer->active);
+    free(writer->pending);
+    free(writer);
+  }
+  return status;
+}
@@ -0,0 +1,98 @@
+#ifndef REPLAY_TETRIS_H
+#define REPLAY_TETRIS_H
+
+#include <pthread.h>
+
+#include "backend_tetris.h"
+
+#define REPLAY_MAGIC "TRPL"  ///< сигнатура файла записи
+#define REPLAY_VERSION 1     ///< версия формата записи
+#define REPLAY_HEADER_SIZE 16  ///< размер заголовка записи в байтах
+#define REPLAY_BUFFER 4096  ///< порог передачи буфера потоку записи
+#define REPLAY_ACTION_BITS 4  ///< бит на действие в записи шага
+#define REPLAY_VARINT_MAX 10  ///< наибольшая длина varint в байтах
+
+/**
+ * @struct ReplayRecord_t
+ * @brief Один шаг автомата из записи
+ */
+typedef struct {
+  long long time;  ///< Время игры на этом шаге (мс от начала записи)
+  UserAction_t action;  ///< Действие шага (-1 - шаг без ввода)
+} ReplayRecord_t;
+
+/**
+ * @struct ReplayReader_t
+ * @brief Чтение записи из памяти
+ * @details Формат: заголовок REPLAY_HEADER_SIZE байт (сигнатура, версия,
+ * способ выбора фигур, высота и ширина поля (0 - по умолчанию), seed в
+ * little-endian), затем по одному varint на
+ * шаг автомата: (приращение времени << REPLAY_ACTION_BITS) |
+ * (действие + 1). Незавершенный последний varint отбрасывается.
+ */
+typedef struct {
+  const uint8_t *data;  ///< Данные записи
+  size_t size;          ///< Размер данных
+  size_t pos;           ///< Позиция следующего шага
+  TetrisConfig_t config;  ///< Параметры игры из заголовка
+  long long time;  ///< Время последнего прочитанного шага
+} ReplayReader_t;
+
+/**
+ * @struct ReplayBuffer_t
+ * @brief Запись игры в растущий буфер в памяти
+ */
+typedef struct {
+  uint8_t *data;  ///< Заголовок и шаги
+  size_t len;     ///< Заполнено байт
+  size_t cap;     ///< Емкость буфера
+  long long time;  ///< Время последнего записанного шага
+} ReplayBuffer_t;
+
+/**
+ * @struct ReplayWriter_t
+ * @brief Буферизованная запись игры в файл в фоновом потоке
+ * @details Игровой поток дописывает шаги в свой буфер и только меняет
+ * буферы местами под мьютексом; запись в файл идет в отдельном потоке.
+ * Если поток записи не успевает, игровой буфер просто растет.
+ */
+typedef struct {
+  FILE *file;             ///< Файл записи
+  pthread_t thread;       ///< Поток записи
+  pthread_mutex_t lock;   ///< Защищает pending и stop
+  pthread_cond_t wake;    ///< Сигнал потоку записи
+  ReplayBuffer_t active;  ///< Буфер игрового потока
+  uint8_t *pending;  ///< Буфер, переданный потоку записи
+  size_t pending_len;  ///< Заполнено в pending (0 - свободен)
+  size_t pending_cap;  ///< Емкость pending
+  int stop;            ///< Запрос завершения потока
+  int error;  ///< Была ошибка записи (поток записи)
+  int lost;  ///< Шаг потерян без памяти (игровой поток)
+} ReplayWriter_t;
+
+int replay_put_varint(uint8_t *out, uint64_t value);
+int replay_get_varint(const uint8_t *data, size_t size, size_t *pos,
+                      uint64_t *value);
+void replay_header(const TetrisConfig_t *config,
+                   uint8_t header[REPLAY_HEADER_SIZE]);
+int replay_reader_init(ReplayReader_t *reader, const uint8_t *data,
+                       size_t size);
+int replay_next(ReplayReader_t *reader, ReplayRecord_t *record);
+uint8_t *replay_load(const char *path, size_t *size);
+int replay_step(GameInfo_t *game, ReplayReader_t *reader);
+GameInfo_t *replay_play(const uint8_t *data, size_t size);
+
+int replay_buffer_start(ReplayBuffer_t *buffer, const TetrisConfig_t *config);
+int replay_buffer_reserve(ReplayBuffer_t *buffer, size_t extra);
+int replay_buffer_record(ReplayBuffer_t *buffer, long long time,
+                         UserAction_t action);
+void replay_buffer_free(ReplayBuffer_t *buffer);
+
+ReplayWriter_t *replay_writer_open(const char *path,
+                                   const TetrisConfig_t *config);
+void replay_record(ReplayWriter_t *writer, long long time,
+                   UserAction_t action);
+void replay_flush(ReplayWriter_t *writer);
+int replay_writer_close(ReplayWriter_t *writer);
+
+#endif  // REPLAY_TETRIS_H
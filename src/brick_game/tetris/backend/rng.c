@@ -0,0 +1,41 @@
+#include "rng.h"
+
+/**
+ * @brief Инициализирует генератор начальным значением
+ * @param rng Указатель на состояние генератора
+ * @param seed Начальное значение
+ * @details Одинаковые начальные значения дают одинаковые последовательности
+ */
+void rng_seed(Rng_t *rng, uint64_t seed) {
+  rng->state = 0;
+  rng->inc = (0xda3e39cb94b95bdbULL << 1u) | 1u;
+  rng_next(rng);
+  rng->state += seed;
+  rng_next(rng);
+}
+
+/**
+ * @brief Возвращает следующее 32-битное число последовательности
+ * @param rng Указатель на состояние генератора
+ * @return Равномерно распределенное число
+ */
+uint32_t rng_next(Rng_t *rng) {
+  uint64_t old = rng->state;
+  rng->state = old * 6364136223846793005ULL + rng->inc;
+  uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+  uint32_t rot = (uint32_t)(old >> 59u);
+  return (xorshifted >> rot) | (xorshifted << ((-rot) & 31u));
+}
+
+/**
+ * @brief Возвращает число в диапазоне [0, bound) без смещения
+ * @param rng Указатель на состояние генератора
+ * @param bound Верхняя граница (больше 0)
+ * @return Равномерно распределенное число меньше bound
+ */
+uint32_t rng_bounded(Rng_t *rng, uint32_t bound) {
+  uint32_t threshold = -bound % bound;
+  uint32_t value = rng_next(rng);
+  while (value < threshold) value = rng_next(rng);
+  return value % bound;
+}
@@ -0,0 +1,24 @@
+#ifndef RNG_TETRIS_H
+#define RNG_TETRIS_H
+
+#include <stdint.h>
+
+/// начальное состояние генератора до явной инициализации (PCG32)
+#define RNG_INITIALIZER {0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL}
+
+/**
+ * @struct Rng_t
+ * @brief Состояние генератора псевдослучайных чисел PCG32
+ * @details Каждая игра хранит свой генератор, поэтому последовательность
+ *          фигур определяется только начальным значением
+ */
+typedef struct {
+  uint64_t state;  ///< Внутреннее состояние
+  uint64_t inc;    ///< Номер потока (всегда нечетный)
+} Rng_t;
+
+void rng_seed(Rng_t *rng, uint64_t seed);
+uint32_t rng_next(Rng_t *rng);
+uint32_t rng_bounded(Rng_t *rng, uint32_t bound);
+
+#endif  // RNG_TETRIS_H
@@ -0,0 +1,219 @@
+#include "server.h"
+
+/**
+ * @brief Подготавливает пустой сервер
+ * @param[out] server Сервер
+ * @param max_games Предел одновременных игр (0 - SERVER_GAMES_MAX)
+ */
+void server_init(GameServer_t *server, uint32_t max_games) {
+  memset(server, 0, sizeof(*server));
+  server->max = max_games > 0 ? max_games : SERVER_GAMES_MAX;
+}
+
+/**
+ * @brief Удаляет все игры сервера
+ * @param server Сервер
+ */
+void server_free(GameServer_t *server) {
+  for (uint32_t i = 0; i < server->slots; i++)
+    tetris_destroy(server->games[i].game);
+  free(server->games);
+  memset(server, 0, sizeof(*server));
+}
+
+/**
+ * @brief Находит игру соединения по номеру
+ * @param server Сервер
+ * @param owner Соединение
+ * @param id Номер игры
+ * @return Слот игры или NULL, если у соединения такой игры нет
+ */
+static ServerGame_t *server_game(GameServer_t *server, int owner,
+                                 uint32_t id) {
+  ServerGame_t *slot = NULL;
+  if (id >= 1 && id <= server->slots) slot = &server->games[id - 1];
+  if (slot != NULL && (slot->game == NULL || slot->owner != owner))
+    slot = NULL;
+  return slot;
+}
+
+/**
+ * @brief Занимает слот для новой игры
+ * @param server Сервер
+ * @return Номер игры или 0, если достигнут предел или нет памяти
+ */
+static uint32_t server_alloc(GameServer_t *server) {
+  uint32_t id = server->free;
+  if (id != 0) {
+    server->free = server->games[id - 1].free;
+  } else if (server->slots < server->max) {
+    if (server->slots == server->cap) {
+      uint32_t cap = server->cap > 0 ? server->cap * 2 : 64;
+      ServerGame_t *grown = realloc(server->games, sizeof(ServerGame_t) * cap);
+      if (grown != NULL) {
+        server->games = grown;
+        server->cap = cap;
+      }
+    }
+    if (server->slots < server->cap) id = ++server->slots;
+  }
+  return id;
+}
+
+/**
+ * @brief Освобождает слот игры
+ * @param server Сервер
+ * @param id Номер игры
+ */
+static void server_release(GameServer_t *server, uint32_t id) {
+  ServerGame_t *slot = &server->games[id - 1];
+  if (slot->game != NULL) server->active--;
+  tetris_destroy(slot->game);
+  slot->game = NULL;
+  slot->free = server->free;
+  server->free = id;
+}
+
+/**
+ * @brief Создает игру по запросу CREATE
+ * @param server Сервер
+ * @param owner Соединение
+ * @param data Данные запроса после заголовка
+ * @param[out] out Данные ответа после заголовка
+ * @param[out] len Длина данных ответа
+ * @return Статус ответа
+ */
+static ProtoStatus_t server_create(GameServer_t *server, int owner,
+                                   const uint8_t *data, uint8_t *out,
+                                   size_t *len) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = proto_get(data, 8),
+                           .randomizer = data[8],
+                           .height = data[9],
+                           .width = data[10]};
+  ProtoStatus_t status = PROTO_OK;
+  uint32_t id = 0;
+  GameInfo_t *game = NULL;
+  if (config.randomizer > RANDOMIZER_BAG ||
+      !tetris_size_valid(config.height, config.width))
+    status = PROTO_BAD_CONFIG;
+  else if ((id = server_alloc(server)) == 0)
+    status = PROTO_FULL;
+  else if ((game = tetris_create(&config)) == NULL)
+    status = PROTO_FULL;
+  if (status == PROTO_OK) {
+    ServerGame_t *slot = &server->games[id - 1];
+    slot->game = game;
+    slot->owner = owner;
+    game_view_init(&slot->view, game->height, game->width);
+    server->active++;
+    proto_put(out, id, 4);
+    out[4] = game->height;
+    out[5] = game->width;
+    *len = 6 + (size_t)game_view_delta(&slot->view, game, out + 6);
+  } else if (id != 0) {
+    server->games[id - 1].game = NULL;
+    server_release(server, id);
+  }
+  return status;
+}
+
+/**
+ * @brief Выполняет пачку шагов по запросу STEP
+ * @param server Сервер
+ * @param owner Соединение
+ * @param data Записи шагов
+ * @param count Количество записей
+ * @param[out] out Данные ответа после заголовка
+ * @param[out] len Длина данных ответа
+ * @return Статус ответа
+ * @details Сначала проверяет все действия, чтобы неверный запрос не
+ * выполнился частично. Шаг игры, которой у соединения нет, дает дельту
+ * с флагом DELTA_NO_GAME.
+ */
+static ProtoStatus_t server_step(GameServer_t *server, int owner,
+                                 const uint8_t *data, int count, uint8_t *out,
+                                 size_t *len) {
+  ProtoStatus_t status = PROTO_OK;
+  for (int i = 0; i < count; i++) {
+    int8_t action = (int8_t)data[i * PROTO_STEP_SIZE + 6];
+    if (action < -1 || action > Action) status = PROTO_BAD_MESSAGE;
+  }
+  for (int i = 0; status == PROTO_OK && i < count; i++) {
+    const uint8_t *entry = data + i * PROTO_STEP_SIZE;
+    ServerGame_t *slot =
+        server_game(server, owner, (uint32_t)proto_get(entry, 4));
+    if (slot != NULL) {
+      tetris_advance_clock(slot->game, (long long)proto_get(entry + 4, 2));
+      tetris_step(slot->game, (UserAction_t)(int8_t)entry[6]);
+      *len += (size_t)game_view_delta(&slot->view, slot->game, out + *len);
+    } else {
+      out[*len] = 0;
+      out[*len + 1] = DELTA_NO_GAME;
+      *len += 2;
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Обрабатывает одно сообщение клиента
+ * @param server Сервер
+ * @param owner Соединение, приславшее сообщение
+ * @param request Сообщение целиком (см. proto_frame_size())
+ * @param size Размер сообщения
+ * @param reply Буфер, в конец которого дописывается ответ
+ * @return 0 при успехе, 1 - не хватило памяти на ответ
+ * @details На любой запрос приходит ровно один ответ; при ошибке в нем
+ * только заголовок со статусом
+ */
+int server_handle(GameServer_t *server, int owner, const uint8_t *request,
+                  size_t size, ProtoBuffer_t *reply) {
+  ProtoHeader_t header;
+  proto_get_header(request, &header);
+  size_t body = size - PROTO_HEADER_SIZE;
+  size_t deltas = body / PROTO_STEP_SIZE + 1;  // не больше, чем шагов
+  int failed = proto_buffer_reserve(
+      reply, PROTO_HEADER_SIZE + 6 + deltas * PROTO_DELTA_MAX);
+  if (!failed) {
+    uint8_t *out = reply->data + reply->len;
+    const uint8_t *data = request + PROTO_HEADER_SIZE;
+    ProtoStatus_t status = PROTO_BAD_MESSAGE;
+    size_t len = 0;
+    int count = 0;
+    if (header.type == PROTO_CREATE && body == PROTO_CREATE_SIZE) {
+      status = server_create(server, owner, data, out + PROTO_HEADER_SIZE,
+                             &len);
+      count = status == PROTO_OK;
+    } else if (header.type == PROTO_STEP &&
+               body == (size_t)header.count * PROTO_STEP_SIZE) {
+      status = server_step(server, owner, data, header.count,
+                           out + PROTO_HEADER_SIZE, &len);
+      count = status == PROTO_OK ? header.count : 0;
+    } else if (header.type == PROTO_DESTROY && body == 4) {
+      uint32_t id = (uint32_t)proto_get(data, 4);
+      status = server_game(server, owner, id) != NULL ? PROTO_OK
+                                                      : PROTO_BAD_GAME;
+      if (status == PROTO_OK) server_release(server, id);
+    }
+    ProtoHeader_t answer = {.size = (uint32_t)(PROTO_HEADER_SIZE + len),
+                            .type = header.type | PROTO_REPLY,
+                            .status = (uint8_t)status,
+                            .count = (uint16_t)count};
+    if (status != PROTO_OK) answer.size = PROTO_HEADER_SIZE;
+    proto_put_header(out, &answer);
+    reply->len += answer.size;
+  }
+  return failed;
+}
+
+/**
+ * @brief Удаляет все игры соединения
+ * @param server Сервер
+ * @param owner Закрытое соединение
+ */
+void server_drop_owner(GameServer_t *server, int owner) {
+  for (uint32_t id = 1; id <= server->slots; id++) {
+    if (server_game(server, owner, id) != NULL) server_release(server, id);
+  }
+}
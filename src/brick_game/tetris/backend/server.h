@@ -0,0 +1,42 @@
+#ifndef SERVER_TETRIS_H
+#define SERVER_TETRIS_H
+
+#include "protocol.h"
+
+#define SERVER_GAMES_MAX 65536  ///< предел игр сервера по умолчанию
+
+/**
+ * @struct ServerGame_t
+ * @brief Игра на сервере
+ */
+typedef struct {
+  GameInfo_t *game;  ///< Экземпляр игры (NULL - слот свободен)
+  int owner;      ///< Соединение, создавшее игру
+  uint32_t free;  ///< Следующий свободный слот (для свободного слота)
+  GameView_t view;  ///< Состояние, которое видел владелец
+} ServerGame_t;
+
+/**
+ * @struct GameServer_t
+ * @brief Игры сервера и обработка запросов
+ * @details Не работает с сокетами: транспорт передает в server_handle()
+ * целые сообщения и отправляет ответы. Номер игры - номер слота плюс 1;
+ * слоты удаленных игр используются повторно, поэтому каждая игра
+ * доступна только создавшему ее соединению.
+ */
+typedef struct {
+  ServerGame_t *games;  ///< Слоты игр
+  uint32_t slots;       ///< Занято слотов (с удаленными)
+  uint32_t cap;         ///< Емкость массива слотов
+  uint32_t max;         ///< Предел слотов
+  uint32_t free;  ///< Первый свободный слот + 1 (0 - нет)
+  uint32_t active;  ///< Живых игр
+} GameServer_t;
+
+void server_init(GameServer_t *server, uint32_t max_games);
+void server_free(GameServer_t *server);
+int server_handle(GameServer_t *server, int owner, const uint8_t *request,
+                  size_t size, ProtoBuffer_t *reply);
+void server_drop_owner(GameServer_t *server, int owner);
+
+#endif  // SERVER_TETRIS_H
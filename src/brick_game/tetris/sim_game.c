@@ -0,0 +1,100 @@
+/**
+ * @file sim_game.c
+ * @brief Проведение одной безголовой игры
+ * @ingroup sim_module
+ * @details Общая часть симулятора и пакетного прогона: игра идет на
+ * виртуальных часах, ввод дает сценарий, случайный генератор или
+ * автоигрок.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_sim.h"
+
+/**
+ * @brief Выбирает действие для очередного шага автомата
+ * @param options Параметры симуляции
+ * @param rng Состояние генератора случайного ввода
+ * @param step Номер шага в текущей игре
+ * @return Действие из сценария или случайное действие
+ */
+UserAction_t sim_action(const SimOptions_t *options, Rng_t *rng, long step) {
+  static const UserAction_t random_actions[] = {Left, Right, Down, Action};
+  UserAction_t action = -1;
+  if (options->script != NULL) {
+    switch (options->script[step % (long)strlen(options->script)]) {
+      case 'L':
+        action = Left;
+        break;
+      case 'R':
+        action = Right;
+        break;
+      case 'D':
+        action = Down;
+        break;
+      case 'A':
+        action = Action;
+        break;
+      default:
+        break;
+    }
+  } else {
+    uint32_t roll = rng_bounded(rng, 8);
+    if (roll < 4) action = random_actions[roll];
+  }
+  return action;
+}
+
+/**
+ * @brief Проводит одну игру до ее окончания
+ * @param options Параметры симуляции
+ * @param ai Автоигрок (NULL - ввод из сценария или случайный)
+ * @param seed Начальное значение генераторов фигур и ввода этой игры
+ * @param[out] result Итоги игры: шаги, счет, линии, уровень и фигуры
+ * @param replay Буфер для записи игры (NULL - не записывать)
+ */
+void sim_game(const SimOptions_t *options, AiPlayer_t *ai, uint64_t seed,
+              SimGame_t *result, ReplayBuffer_t *replay) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = seed,
+                           .randomizer = options->randomizer,
+                           .height = options->height,
+                           .width = options->width};
+  GameInfo_t *game = tetris_create(&config);
+  Rng_t input_rng;
+  long step = 0;
+  rng_seed(&input_rng, ~seed);
+  memset(result, 0, sizeof(*result));
+  if (ai != NULL) ai_reset(ai);
+  if (replay != NULL) replay_buffer_start(replay, &config);
+  if (game != NULL) {
+    if (replay != NULL) replay_buffer_record(replay, game->clock, Start);
+    tetris_step(game, Start);
+    while (game->state != GAMEOVER && step < options->max_steps) {
+      UserAction_t action = ai != NULL
+                                ? ai_action(ai, game)
+                                : sim_action(options, &input_rng, step);
+      if (replay != NULL) replay_buffer_record(replay, game->clock, action);
+      tetris_step(game, action);
+      tetris_advance_clock(game, options->tick_ms);
+      step++;
+    }
+    result->score = game->score;
+    result->lines = game->lines;
+    result->level = game->level;
+    result->pieces = game->pieces;
+    tetris_destroy(game);
+  }
+  result->steps = step;
+}
+
+/**
+ * @brief Возвращает монотонное время в секундах
+ * @return Время CLOCK_MONOTONIC в секундах
+ */
+double monotonic_seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
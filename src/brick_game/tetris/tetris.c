@@ -5,42 +5,428 @@
  * @{
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "tetris.h"
 
 /**
  * @brief Точка входа в программу
- * @return 0 при успешном завершении
+ * @param argc Количество аргументов
+ * @param argv Аргументы: -a запускает игру в режиме автоигрока,
+ *        -r файл записывает игру в файл, -p файл проигрывает запись,
+ *        -l файл задает таблицу рекордов (по умолчанию
+ *        $XDG_DATA_HOME/tetris/leaderboard.txt или
+ *        ~/.local/share/tetris/leaderboard.txt, см. leaderboard_path()),
+ *        -H высота и -W ширина задают размеры поля (по умолчанию
+ *        HEIGHT x WIDTH), -D и -R - задержку и период автоповтора сдвига в
+ *        мс (по умолчанию INPUT_DAS_MS и INPUT_ARR_MS)
+ * @return 0 при успешном завершении, 1 - недопустимые размеры поля
  * @details Инициализирует ncurses, запускает главный игровой цикл
- * и корректно завершает работу с ncurses.
+ * (или проигрывание записи) и корректно завершает работу с ncurses.
+ * В сборке с TETRIS_STATS при выходе сохраняет статистику автомата в
+ * FSM_STATS_PATH.
  */
-int main(void) {
+int main(int argc, char *argv[]) {
+  GameOptions_t options = {.autoplay = false};
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-a") == 0) options.autoplay = true;
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) options.record = argv[++i];
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) options.replay = argv[++i];
+    if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) options.scores = argv[++i];
+    if (strcmp(argv[i], "-H") == 0 && i + 1 < argc)
+      options.height = atoi(argv[++i]);
+    if (strcmp(argv[i], "-W") == 0 && i + 1 < argc)
+      options.width = atoi(argv[++i]);
+    if (strcmp(argv[i], "-D") == 0 && i + 1 < argc)
+      options.das_ms = atoi(argv[++i]);
+    if (strcmp(argv[i], "-R") == 0 && i + 1 < argc)
+      options.arr_ms = atoi(argv[++i]);
+  }
+  if (!tetris_size_valid(options.height, options.width)) {
+    fprintf(stderr, "field size must be %d-%d rows by %d-%d columns\n",
+            SIZE_MIN, HEIGHT_MAX, SIZE_MIN, WIDTH_MAX);
+    return 1;
+  }
   init_ncurses();
-  main_game_loop();
+  if (options.replay != NULL)
+    replay_game_loop(options.replay);
+  else
+    main_game_loop(&options);
   endwin();
+  FSM_STATS_DUMP(FSM_STATS_PATH);
 
   return 0;
 }
 
 /**
  * @brief Основной игровой цикл
- * @details Управляет:
- * - Отрисовкой игрового состояния
- * - Обработкой пользовательского ввода
- * - Обновлением экрана
- * Работает до перехода игры в состояние EXIT_STATE
+ * @details Запускает поток симуляции (simulation_thread()) и ведет в
+ * текущем потоке ввод и отрисовку (render_loop()), пока игра не перейдет в
+ * состояние EXIT_STATE
+ *
+ * @note Автомат шагает в своем потоке, поэтому медленный вывод в
+ * терминал не сдвигает гравитацию. Поток спит до ближайшего события по
+ * времени (гравитация, повтор сдвига, ход автоигрока) или до клавиши; на
+ * экранах START, PAUSE и GAMEOVER без автоигрока - только до клавиши.
+ * Потоки не ждут друг друга: клавиши идут в симуляцию через очередь без
+ * блокировок, а кадры в отрисовку - через тройной буфер (FrameChannel_t),
+ * из которого она берет только последний кадр.
+ *
+ * @note Игра идет на виртуальных часах, которые перед каждым шагом
+ * догоняют монотонное время (sync_clock()): так шаг видит ровно то время,
+ * что попадает в запись игры, а перевод системных часов не трогает
+ * гравитацию
  *
- * @note Частота обновления экрана зависит от скорости ввода пользователя
- * @see GameInfo_t, userInput(), print_game_screen()
+ * @note Таблица рекордов читается один раз при запуске, а результаты
+ * партий сохраняет ее фоновый поток (см. ScoreStore_t)
+ *
+ * @param options Параметры запуска: автоигрок (переключается клавишей
+ * AI_KEY; пока клавиши не нажимаются, действия выбирает ai_action()),
+ * файл записи игры, файл таблицы рекордов, размеры поля и автоповтор
+ * @see GameLoop_t, tetris_step(), print_game_screen()
+ */
+void main_game_loop(const GameOptions_t *options) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK,
+                           .seed = (uint64_t)time(NULL),  // новые фигуры
+                           .height = options->height,
+                           .width = options->width};
+  InputConfig_t input = {.das_ms = options->das_ms,
+                         .arr_ms = options->arr_ms};
+  static GameLoop_t loop;  // кадры занимают несколько килобайт
+  pthread_t simulation;
+  loop.game = tetris_create(&config);  // Инициализация состояния игры
+  loop.wake = eventfd(0, EFD_CLOEXEC);
+  loop.keys = eventfd(0, EFD_CLOEXEC);
+  if (loop.game != NULL && loop.wake >= 0 && loop.keys >= 0) {
+    loop.writer = options->record != NULL
+                      ? replay_writer_open(options->record, &config)
+                      : NULL;
+    loop.scores = score_store_open(options->scores);
+    loop.game->high_score = score_store_best(loop.scores);
+    loop.ai = options->autoplay ? toggle_autoplay(NULL) : NULL;
+    loop.start = monotonic_time();
+    loop.ai_next = 0;
+    input_queue_init(&loop.input);
+    autoshift_init(&loop.shift, &input);
+    channel_init(&loop.frames);
+    channel_publish(&loop.frames, loop.game);
+    if (pthread_create(&simulation, NULL, simulation_thread, &loop) == 0) {
+      render_loop(&loop);
+      pthread_join(simulation, NULL);
+    }
+    ai_destroy(loop.ai);
+    replay_writer_close(loop.writer);
+    score_store_close(loop.scores);
+  }
+  if (loop.wake >= 0) close(loop.wake);
+  if (loop.keys >= 0) close(loop.keys);
+  tetris_destroy(loop.game);
+}
+
+/**
+ * @brief Тело потока симуляции
+ * @param arg Указатель на GameLoop_t
+ * @return NULL
+ * @details Спит в poll() на eventfd клавиш не дольше
+ * simulation_timeout() и выполняет такт. Кадр публикуется только после
+ * изменений.
+ */
+void *simulation_thread(void *arg) {
+  GameLoop_t *loop = arg;
+  struct pollfd keys = {.fd = loop->keys, .events = POLLIN};
+  while (loop->game->state != EXIT_STATE) {
+    int timeout = simulation_timeout(loop);
+    if (timeout != 0 && poll(&keys, 1, timeout) > 0) {
+      eventfd_t count;
+      eventfd_read(loop->keys, &count);
+    }
+    if (simulation_tick(loop)) {
+      channel_publish(&loop->frames, loop->game);
+      eventfd_write(loop->wake, 1);
+    }
+  }
+  FSM_STATS_FLUSH();
+  return NULL;
+}
+
+/**
+ * @brief Вычисляет, сколько поток симуляции может спать без клавиш
+ * @param loop Состояние игрового цикла
+ * @return Время в мс до ближайшего события по времени: гравитации и
+ *         повтора сдвига в MOVING или хода автоигрока; -1 - таких нет
+ */
+int simulation_timeout(const GameLoop_t *loop) {
+  const GameInfo_t *game = loop->game;
+  long long now = monotonic_time() - loop->start;
+  long long wake = -1;  // время игры ближайшего события
+  if (game->state == MOVING) {
+    int shift = autoshift_timeout(&loop->shift, now);
+    wake = game->timer + game->speed;
+    if (shift >= 0 && now + shift < wake) wake = now + shift;
+  }
+  if (loop->ai != NULL && (wake < 0 || loop->ai_next < wake))
+    wake = loop->ai_next;
+  int timeout = -1;
+  if (wake >= 0) timeout = wake > now ? (int)(wake - now) : 0;
+  return timeout;
+}
+
+/**
+ * @brief Выполняет один такт симуляции
+ * @param loop Состояние игрового цикла
+ * @return true, если изменилось что-то видимое и нужен новый кадр
+ * @details Обрабатывает по порядку все клавиши из очереди, затем шаг без
+ * клавиши, если он что-то меняет: повтор сдвига, ход автоигрока (не чаще
+ * AI_STEP_MS) или наступившую гравитацию. Пустые шаги не выполняются и не
+ * попадают в запись игры. Промежуточные состояния проходятся сразу,
+ * поэтому кадр всегда показывает состояние, ждущее ввода.
+ */
+bool simulation_tick(GameLoop_t *loop) {
+  GameInfo_t *game = loop->game;
+  GameState_t before = game->state;
+  bool changed = false;
+  int key;
+  sync_clock(game, loop->start);
+  while (game->state != EXIT_STATE &&
+         (key = input_queue_pop(&loop->input)) != ERR) {
+    if (key == AI_KEY) loop->ai = toggle_autoplay(loop->ai);
+    input_step(game, loop->writer, loop->scores, &loop->shift, key);
+    changed = true;
+  }
+  while (is_transient_state(game->state))
+    game_step(game, loop->writer, loop->scores, -1);
+  if (game->state != EXIT_STATE) {
+    UserAction_t action = autoshift_repeat(&loop->shift, game->clock);
+    if (action == (UserAction_t)-1 && loop->ai != NULL &&
+        game->clock >= loop->ai_next) {
+      action = ai_action(loop->ai, game);
+      loop->ai_next = game->clock + AI_STEP_MS;
+    }
+    bool fall = game->state == MOVING &&
+                game->clock - game->timer >= game->speed;  // гравитация
+    if (action != (UserAction_t)-1 || fall) {
+      game_step(game, loop->writer, loop->scores, action);
+      changed = true;
+    }
+    while (is_transient_state(game->state))
+      game_step(game, loop->writer, loop->scores, -1);
+  }
+  return changed || game->state != before;
+}
+
+/**
+ * @brief Цикл ввода и отрисовки
+ * @param loop Состояние игрового цикла
+ * @details Спит в poll() на stdin и eventfd симуляции. Забирает все
+ * накопившиеся клавиши в очередь симуляции (если она полна, клавиша
+ * теряется) и будит симуляцию, затем выводит последний кадр, если он
+ * новый или экран изменил размер. Выводятся только изменившиеся клетки
+ * (см. print_game_screen()). Завершается, получив кадр с EXIT_STATE.
+ */
+void render_loop(GameLoop_t *loop) {
+  struct pollfd events[2] = {{.fd = STDIN_FILENO, .events = POLLIN},
+                             {.fd = loop->wake, .events = POLLIN}};
+  bool redraw = true;
+  bool done = false;
+  while (!done) {
+    bool fresh;
+    bool pushed = false;
+    int key;
+    while ((key = getch()) != ERR) {
+      if (key == KEY_RESIZE) {
+        invalidate_screen();
+        redraw = true;
+      } else {
+        pushed = input_queue_push(&loop->input, key) || pushed;
+      }
+    }
+    if (pushed) eventfd_write(loop->keys, 1);
+    const GameInfo_t *frame = channel_latest(&loop->frames, &fresh);
+    if (fresh || redraw) {
+      print_game_screen(frame);  // вывод изменившихся клеток и статистики
+      refresh();  // обновление экрана (ncurses)
+      redraw = false;
+    }
+    done = frame->state == EXIT_STATE;
+    if (!done && poll(events, 2, -1) > 0 && (events[1].revents & POLLIN)) {
+      eventfd_t count;
+      eventfd_read(loop->wake, &count);
+    }
+  }
+}
+
+/**
+ * @brief Проверяет, закончилась ли на этом шаге партия
+ * @param before Состояние автомата до шага
+ * @param after Состояние автомата после шага
+ * @return true при проигрыше и при выходе из начатой партии
+ */
+bool is_game_finished(GameState_t before, GameState_t after) {
+  return before != after &&
+         (after == GAMEOVER ||
+          (after == EXIT_STATE && before != START && before != GAMEOVER));
+}
+
+/**
+ * @brief Отправляет результат партии в таблицу рекордов
+ * @param scores Таблица рекордов (NULL - таблицы нет)
+ * @param game Указатель на состояние игры
+ * @details Только обновляет таблицу в памяти, на диск ее пишет поток
+ * таблицы. Партии с флагом GAME_NO_PERSIST не учитываются.
+ */
+void submit_score(ScoreStore_t *scores, const GameInfo_t *game) {
+  ScoreEntry_t entry = {.score = game->score,
+                        .lines = game->lines,
+                        .level = game->level};
+  if (!(game->flags & GAME_NO_PERSIST)) score_store_submit(scores, &entry);
+}
+
+/**
+ * @brief Догоняет виртуальные часы игры до монотонного времени
+ * @param game Указатель на состояние игры
+ * @param start Время начала игры по monotonic_time() (мс)
+ */
+void sync_clock(GameInfo_t *game, long long start) {
+  long long now = monotonic_time() - start;
+  if (now > game->clock) tetris_advance_clock(game, now - game->clock);
+}
+
+/**
+ * @brief Выполняет шаг автомата и дописывает его в запись игры
+ * @details К концу партии запись передается на диск, не дожидаясь
+ * заполнения буфера
+ * @param game Указатель на состояние игры
+ * @param writer Запись игры (NULL - не записывать)
+ * @param action Действие пользователя
+ */
+void recorded_step(GameInfo_t *game, ReplayWriter_t *writer,
+                   UserAction_t action) {
+  replay_record(writer, game->clock, action);
+  tetris_step(game, action);
+  if (game->state == GAMEOVER) replay_flush(writer);
+}
+
+/**
+ * @brief Выполняет шаг игрового цикла
+ * @param game Указатель на состояние игры
+ * @param writer Запись игры (NULL - не записывать)
+ * @param scores Таблица рекордов (NULL - таблицы нет)
+ * @param action Действие пользователя
+ * @details Закончившаяся на этом шаге партия отправляется в таблицу
+ * рекордов
+ */
+void game_step(GameInfo_t *game, ReplayWriter_t *writer, ScoreStore_t *scores,
+               UserAction_t action) {
+  GameState_t before = game->state;
+  recorded_step(game, writer, action);
+  if (is_game_finished(before, game->state)) submit_score(scores, game);
+}
+
+/**
+ * @brief Обрабатывает клавишу из очереди ввода
+ * @param game Указатель на состояние игры
+ * @param writer Запись игры (NULL - не записывать)
+ * @param scores Таблица рекордов (NULL - таблицы нет)
+ * @param shift Автоповтор сдвига
+ * @param key Код клавиши
+ * @details Повтор той же клавиши сдвига считается удержанием (см.
+ * autoshift_is_hold()). Перед шагом проходит промежуточные состояния,
+ * оставленные предыдущей клавишей, чтобы следующее действие не потерялось.
+ * Клавиша без действия (неизвестная или повтор сдвига до срока) шага не
+ * дает.
+ */
+void input_step(GameInfo_t *game, ReplayWriter_t *writer, ScoreStore_t *scores,
+                AutoShift_t *shift, int key) {
+  UserAction_t action = get_action(key);
+  bool hold = autoshift_is_hold(shift, action, game->clock);
+  action = autoshift_input(shift, action, hold, game->clock);
+  if (action != (UserAction_t)-1) {
+    while (is_transient_state(game->state))
+      game_step(game, writer, scores, -1);
+    game_step(game, writer, scores, action);
+  }
+}
+
+/**
+ * @brief Проигрывает запись игры в реальном времени
+ * @param path Файл записи
+ * @details Шаги выполняются в записанные моменты времени, между ними
+ * выводится экран. Клавиша ESCAPE_KEY прерывает проигрывание; после
+ * конца записи экран остается до нажатия любой клавиши.
+ */
+void replay_game_loop(const char *path) {
+  size_t size = 0;
+  uint8_t *data = replay_load(path, &size);
+  ReplayReader_t reader;
+  GameInfo_t *game = NULL;
+  if (replay_reader_init(&reader, data, size) == 0) {
+    reader.config.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST;
+    game = tetris_create(&reader.config);
+  }
+  long long start = monotonic_time();
+  ReplayRecord_t record;
+  int key = ERR;
+  while (game != NULL && key != ESCAPE_KEY && replay_next(&reader, &record)) {
+    long long wait = record.time - (monotonic_time() - start);
+    if (wait > 0 && !is_transient_state(game->state)) {
+      print_game_screen(game);
+      refresh();
+      key = wait_for_key(wait);
+    }
+    tetris_advance_clock(game, record.time - game->clock);
+    tetris_step(game, record.action);
+  }
+  if (game != NULL && key != ESCAPE_KEY && game->state != EXIT_STATE) {
+    print_game_screen(game);
+    refresh();
+    wait_for_key(-1);
+  }
+  tetris_destroy(game);
+  free(data);
+}
+
+/**
+ * @brief Включает или выключает автоигрока
+ * @param ai Текущий автоигрок (NULL - выключен)
+ * @return Новый автоигрок или NULL, если он был включен
+ * @details Потоков поиска - по числу процессоров, но не больше AI_THREADS;
+ * поиск хода ограничен сроком, чтобы не задерживать игру
+ */
+AiPlayer_t *toggle_autoplay(AiPlayer_t *ai) {
+  AiPlayer_t *result = NULL;
+  if (ai != NULL) {
+    ai_destroy(ai);
+  } else {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus < AI_THREADS ? (int)cpus : AI_THREADS;
+    AiConfig_t config = {.threads = threads, .timed = 1};
+    result = ai_create(&config);
+  }
+  return result;
+}
+
+/**
+ * @brief Проверяет, проходит ли состояние автомата без участия игрока
+ * @param state Состояние автомата
+ * @return true для SPAWN, SHIFTING и ATTACHING
+ */
+bool is_transient_state(GameState_t state) {
+  return state == SPAWN || state == SHIFTING || state == ATTACHING;
+}
+
+/**
+ * @brief Ждет нажатия клавиши не дольше заданного времени
+ * @param timeout Время ожидания в мс (-1 - без ограничения)
+ * @return Код клавиши или ERR, если время ожидания истекло
  */
-void main_game_loop() {
-  GameInfo_t *game = updateCurrentState();
-  game_init(game);  // Инициализация состояния игры
-  while (game->state != EXIT_STATE) {
-    erase();                   // очистка экрана (ncurses)
-    print_game_screen(*game);  // отображение игрового поля, фигур и статистики
-    userInput(get_action(getch()), 0);  // обработка пользовательского ввода
-    refresh();  // обновление экрана (ncurses)
+int wait_for_key(long long timeout) {
+  int key = getch();
+  if (key == ERR) {
+    struct pollfd input = {.fd = STDIN_FILENO, .events = POLLIN};
+    if (poll(&input, 1, timeout > INT_MAX ? INT_MAX : (int)timeout) > 0)
+      key = getch();
   }
+  return key;
 }
 
-/** @} */  // Конец группы main_module
\ No newline at end of file
+/** @} */  // Конец группы main_module
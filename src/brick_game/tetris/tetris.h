@@ -1,18 +1,86 @@
 #ifndef TETRIS_H
 #define TETRIS_H
 
+#include <limits.h>
 #include <ncurses.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "../../gui/cli/frontend_tetris.h"
+#include "backend/ai.h"
 #include "backend/backend_tetris.h"
+#include "backend/channel.h"
 #include "backend/figures.h"
+#include "backend/fsm_stats.h"
+#include "backend/input.h"
+#include "backend/leaderboard.h"
+#include "backend/replay.h"
 
-void main_game_loop();
+#define AI_KEY 'a'  ///< включение и выключение автоигрока
+#define AI_STEP_MS 40  ///< пауза между действиями автоигрока (мс)
+#define AI_THREADS 4  ///< потоков поиска автоигрока
+
+/**
+ * @struct GameOptions_t
+ * @brief Параметры запуска игры
+ */
+typedef struct {
+  bool autoplay;  ///< Начать в режиме автоигрока
+  const char *record;  ///< Файл для записи игры (NULL - не записывать)
+  const char *replay;  ///< Файл записи для проигрывания (NULL - игра)
+  const char *scores;  ///< Файл таблицы рекордов (NULL - по умолчанию)
+  int height;  ///< Высота поля (0 - HEIGHT)
+  int width;   ///< Ширина поля (0 - WIDTH)
+  int das_ms;  ///< Задержка автоповтора сдвига (0 - INPUT_DAS_MS)
+  int arr_ms;  ///< Период автоповтора сдвига (0 - INPUT_ARR_MS)
+} GameOptions_t;
+
+/**
+ * @struct GameLoop_t
+ * @brief Общее состояние потоков симуляции и отрисовки
+ * @details Игру, запись, таблицу рекордов, автоигрока и автоповтор
+ * трогает только поток симуляции. С потоком отрисовки он связан лишь
+ * очередью клавиш, каналом кадров и двумя eventfd, которыми потоки будят
+ * друг друга.
+ */
+typedef struct {
+  FrameChannel_t frames;  ///< Кадры: симуляция -> отрисовка
+  InputQueue_t input;  ///< Клавиши: отрисовка -> симуляция
+  GameInfo_t *game;  ///< Игра
+  ReplayWriter_t *writer;  ///< Запись игры (NULL - не записывать)
+  ScoreStore_t *scores;  ///< Таблица рекордов (NULL - таблицы нет)
+  AiPlayer_t *ai;     ///< Автоигрок (NULL - выключен)
+  AutoShift_t shift;  ///< Автоповтор сдвига
+  long long start;  ///< Время начала игры по monotonic_time() (мс)
+  long long ai_next;  ///< Время игры следующего хода автоигрока
+  int wake;  ///< eventfd: опубликован новый кадр
+  int keys;  ///< eventfd: в очереди появились клавиши
+} GameLoop_t;
+
+void main_game_loop(const GameOptions_t *options);
+void replay_game_loop(const char *path);
+bool is_game_finished(GameState_t before, GameState_t after);
+void submit_score(ScoreStore_t *scores, const GameInfo_t *game);
+void sync_clock(GameInfo_t *game, long long start);
+void recorded_step(GameInfo_t *game, ReplayWriter_t *writer,
+                   UserAction_t action);
+void game_step(GameInfo_t *game, ReplayWriter_t *writer, ScoreStore_t *scores,
+               UserAction_t action);
+void input_step(GameInfo_t *game, ReplayWriter_t *writer, ScoreStore_t *scores,
+                AutoShift_t *shift, int key);
+bool is_transient_state(GameState_t state);
+void *simulation_thread(void *arg);
+int simulation_timeout(const GameLoop_t *loop);
+bool simulation_tick(GameLoop_t *loop);
+void render_loop(GameLoop_t *loop);
+int wait_for_key(long long timeout);
+AiPlayer_t *toggle_autoplay(AiPlayer_t *ai);
 
 #endif
\ No newline at end of file
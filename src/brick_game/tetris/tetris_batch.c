@@ -0,0 +1,410 @@
+/**
+ * @file tetris_batch.c
+ * @brief Пакетный прогон игр Tetris на всех ядрах
+ * @ingroup sim_module
+ * @details Проводит N безголовых игр с seed, seed + 1, ... в нескольких
+ * потоках. Каждая игра - полный экземпляр автомата на виртуальных часах,
+ * ход выбирает сценарий, случайный ввод или автоигрок. Игры заранее
+ * делятся между потоками поровну, а длительность игр сильно разнится,
+ * поэтому освободившийся поток крадет у другого половину его оставшегося
+ * диапазона. Итоги игр складываются по номерам, так что сводка не зависит
+ * от числа потоков.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_batch.h"
+
+/// Упаковывает диапазон [lo, hi) в слово очереди
+#define BATCH_RANGE(lo, hi) ((uint64_t)(lo) | (uint64_t)(hi) << 32)
+#define BATCH_LO(range) ((uint32_t)(range))  ///< Начало диапазона
+#define BATCH_HI(range) ((uint32_t)((range) >> 32))  ///< Конец диапазона
+
+/**
+ * @brief Точка входа пакетного прогона
+ * @return 0 при успешном завершении, 1 при ошибке
+ * @details Параметры те же, что у tetris_sim, кроме -j: здесь это число
+ * рабочих потоков, а автоигрок каждого потока ищет в один поток.
+ * С -c файл вместо новых игр проигрываются все игры корпуса.
+ * В сборке с TETRIS_STATS после сводки печатает статистику автомата.
+ */
+int main(int argc, char *argv[]) {
+  BatchOptions_t options;
+  int status = parse_batch_options(argc, argv, &options);
+  SimGame_t *results = NULL;
+  Corpus_t *corpus = NULL;
+  if (status == 0 && options.corpus != NULL) {
+    corpus = corpus_open(options.corpus);
+    if (corpus == NULL || corpus->count == 0 || corpus->count > INT_MAX) {
+      fprintf(stderr, "%s: not a corpus or no games\n", options.corpus);
+      status = 1;
+    } else {
+      options.sim.games = (int)corpus->count;
+      if (options.workers > options.sim.games)
+        options.workers = options.sim.games;
+    }
+  }
+  if (status == 0) {
+    results = malloc(sizeof(SimGame_t) * options.sim.games);
+    if (results == NULL) status = 1;
+  }
+  if (status == 0) {
+    long steals = 0;
+    double start = monotonic_seconds();
+    status = run_batch(&options, corpus, results, &steals);
+    if (status == 0) {
+      print_batch_summary(&options, results, steals,
+                          monotonic_seconds() - start);
+      FSM_STATS_DUMP(NULL);
+    }
+  }
+  free(results);
+  corpus_close(corpus);
+  return status;
+}
+
+/**
+ * @brief Разбирает параметры командной строки
+ * @param argc Количество аргументов
+ * @param argv Аргументы
+ * @param[out] options Заполняемые параметры прогона
+ * @return 0 при успехе, 1 при ошибке
+ */
+int parse_batch_options(int argc, char *argv[], BatchOptions_t *options) {
+  SimOptions_t *sim = &options->sim;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int status = 0;
+  int opt;
+  sim->games = BATCH_GAMES;
+  sim->seed = (uint64_t)time(NULL);
+  sim->randomizer = RANDOMIZER_UNIFORM;
+  sim->height = 0;
+  sim->width = 0;
+  sim->tick_ms = SIM_TICK_MS;
+  sim->max_steps = SIM_MAX_STEPS;
+  sim->script = NULL;
+  sim->ai = 0;
+  sim->ai_threads = 1;
+  sim->replay = NULL;
+  sim->corpus = NULL;
+  sim->keyframe_pieces = 0;
+  options->workers = cpus > 0 ? (int)cpus : 1;
+  options->corpus = NULL;
+  while (status == 0 &&
+         (opt = getopt(argc, argv, "g:s:t:m:bH:W:S:aj:c:")) != -1) {
+    switch (opt) {
+      case 'g':
+        sim->games = atoi(optarg);
+        break;
+      case 's':
+        sim->seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'b':
+        sim->randomizer = RANDOMIZER_BAG;
+        break;
+      case 'H':
+        sim->height = atoi(optarg);
+        break;
+      case 'W':
+        sim->width = atoi(optarg);
+        break;
+      case 't':
+        sim->tick_ms = atoi(optarg);
+        break;
+      case 'm':
+        sim->max_steps = atol(optarg);
+        break;
+      case 'S':
+        sim->script = optarg;
+        break;
+      case 'a':
+        sim->ai = 1;
+        break;
+      case 'j':
+        options->workers = atoi(optarg);
+        break;
+      case 'c':
+        options->corpus = optarg;
+        break;
+      default:
+        status = 1;
+        break;
+    }
+  }
+  if (sim->games <= 0 || sim->tick_ms <= 0 || options->workers <= 0 ||
+      !tetris_size_valid(sim->height, sim->width) ||
+      (sim->script != NULL && sim->script[0] == '\0'))
+    status = 1;
+  if (status != 0)
+    fprintf(stderr,
+            "usage: %s [-g games] [-s seed] [-t tick_ms] [-m max_steps] [-b] "
+            "[-H height] [-W width] [-S script] [-a] [-j workers] "
+            "[-c corpus]\n",
+            argv[0]);
+  if (status == 0 && options->workers > sim->games)
+    options->workers = sim->games;
+  return status;
+}
+
+/**
+ * @brief Забирает из своей очереди следующую игру
+ * @param queue Очередь потока
+ * @param[out] game Номер игры
+ * @return 1, если игра получена, 0 - очередь пуста
+ * @details Владелец забирает игры с начала диапазона, воры - с конца,
+ * поэтому CAS владельца проигрывает только при одновременной краже
+ */
+int batch_pop(BatchQueue_t *queue, uint32_t *game) {
+  uint64_t range = atomic_load(&queue->range);
+  int found = 0;
+  while (!found && BATCH_LO(range) < BATCH_HI(range)) {
+    uint64_t next = BATCH_RANGE(BATCH_LO(range) + 1, BATCH_HI(range));
+    if (atomic_compare_exchange_weak(&queue->range, &range, next)) {
+      *game = BATCH_LO(range);
+      found = 1;
+    }
+  }
+  return found;
+}
+
+/**
+ * @brief Крадет половину оставшихся игр у другого потока
+ * @param run Общее состояние прогона
+ * @param thief Номер потока, у которого кончились игры
+ * @return 1, если игры украдены в очередь вора, 0 - все очереди пусты
+ * @details Жертвы перебираются по кругу начиная со следующего потока.
+ * У жертвы остается нижняя половина диапазона, вор забирает верхнюю
+ * (при одной оставшейся игре - ее). Свою очередь вор пишет простым
+ * store: она пуста, и другие воры ее не трогают.
+ */
+int batch_steal(BatchRun_t *run, int thief) {
+  int workers = run->options->workers;
+  int stolen = 0;
+  for (int i = 1; i < workers && !stolen; i++) {
+    BatchQueue_t *victim = &run->queues[(thief + i) % workers];
+    uint64_t range = atomic_load(&victim->range);
+    while (!stolen && BATCH_LO(range) < BATCH_HI(range)) {
+      uint32_t lo = BATCH_LO(range), hi = BATCH_HI(range);
+      uint32_t mid = hi - (hi - lo + 1) / 2;
+      if (atomic_compare_exchange_weak(&victim->range, &range,
+                                       BATCH_RANGE(lo, mid))) {
+        atomic_store(&run->queues[thief].range, BATCH_RANGE(mid, hi));
+        stolen = 1;
+      }
+    }
+  }
+  return stolen;
+}
+
+/**
+ * @brief Тело рабочего потока
+ * @param arg Указатель на BatchWorker_t
+ * @return NULL
+ * @details Играет (или проигрывает из корпуса) игры своей очереди, затем
+ * крадет, пока есть что. Счетчики автомата потока (сборка с TETRIS_STATS)
+ * в конце переносятся в общие.
+ */
+static void *batch_worker(void *arg) {
+  BatchWorker_t *worker = arg;
+  BatchRun_t *run = worker->run;
+  const SimOptions_t *sim = &run->options->sim;
+  AiConfig_t ai_config = {.threads = 1};
+  AiPlayer_t *ai =
+      sim->ai && run->corpus == NULL ? ai_create(&ai_config) : NULL;
+  BatchQueue_t *queue = &run->queues[worker->id];
+  int active = 1;
+  while (active) {
+    uint32_t game;
+    if (batch_pop(queue, &game)) {
+      if (run->corpus != NULL)
+        batch_replay_game(run->corpus, game, &run->results[game]);
+      else
+        sim_game(sim, ai, sim->seed + game, &run->results[game], NULL);
+      worker->games++;
+    } else if (batch_steal(run, worker->id)) {
+      worker->steals++;
+    } else {
+      active = 0;
+    }
+  }
+  ai_destroy(ai);
+  FSM_STATS_FLUSH();
+  return NULL;
+}
+
+/**
+ * @brief Проводит все игры прогона
+ * @param options Параметры прогона
+ * @param corpus Корпус, игры которого проигрываются (NULL - новые игры)
+ * @param[out] results Итоги игр, options->sim.games элементов
+ * @param[out] steals Общее число удачных краж
+ * @return 0 при успехе, 1 при нехватке памяти
+ * @details Вызывающий поток работает как поток 0
+ */
+int run_batch(const BatchOptions_t *options, const Corpus_t *corpus,
+              SimGame_t *results, long *steals) {
+  int workers = options->workers;
+  uint32_t games = (uint32_t)options->sim.games;
+  BatchRun_t run = {.options = options, .results = results, .corpus = corpus};
+  int status = 0;
+  run.queues = aligned_alloc(BATCH_LINE, sizeof(BatchQueue_t) * workers);
+  run.workers = calloc(workers, sizeof(BatchWorker_t));
+  if (run.queues == NULL || run.workers == NULL) status = 1;
+  for (int i = 0; status == 0 && i < workers; i++) {
+    uint32_t lo = (uint32_t)((uint64_t)games * i / workers);
+    uint32_t hi = (uint32_t)((uint64_t)games * (i + 1) / workers);
+    atomic_init(&run.queues[i].range, BATCH_RANGE(lo, hi));
+    run.workers[i].run = &run;
+    run.workers[i].id = i;
+  }
+  int started = 1;
+  for (; status == 0 && started < workers; started++) {
+    if (pthread_create(&run.workers[started].thread, NULL, batch_worker,
+                       &run.workers[started]) != 0)
+      break;
+  }
+  *steals = 0;
+  if (status == 0) {
+    batch_worker(&run.workers[0]);
+    for (int i = 1; i < started; i++) pthread_join(run.workers[i].thread, NULL);
+    for (int i = 0; i < workers; i++) *steals += run.workers[i].steals;
+  }
+  free(run.queues);
+  free(run.workers);
+  return status;
+}
+
+/**
+ * @brief Проигрывает игру корпуса целиком
+ * @param corpus Корпус
+ * @param game Номер игры
+ * @param[out] result Итоги игры (шаги - количество шагов записи)
+ * @details Запись читается прямо из отображения корпуса, без копирования
+ */
+void batch_replay_game(const Corpus_t *corpus, uint64_t game,
+                       SimGame_t *result) {
+  ReplayReader_t reader;
+  GameInfo_t *state = NULL;
+  memset(result, 0, sizeof(*result));
+  if (corpus_replay(corpus, game, &reader) == 0) {
+    reader.config.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST;
+    state = tetris_create(&reader.config);
+  }
+  if (state != NULL) {
+    while (replay_step(state, &reader)) result->steps++;
+    result->score = state->score;
+    result->lines = state->lines;
+    result->level = state->level;
+    result->pieces = state->pieces;
+    tetris_destroy(state);
+  }
+}
+
+/**
+ * @brief Возвращает значение метрики одной игры
+ * @param game Итоги игры
+ * @param metric Метрика
+ * @return Значение метрики
+ */
+static long long batch_metric(const SimGame_t *game, BatchMetric_t metric) {
+  long long value = 0;
+  switch (metric) {
+    case BATCH_SCORE:
+      value = game->score;
+      break;
+    case BATCH_LINES:
+      value = game->lines;
+      break;
+    case BATCH_LEVEL:
+      value = game->level;
+      break;
+    case BATCH_PIECES:
+      value = game->pieces;
+      break;
+    default:
+      break;
+  }
+  return value;
+}
+
+/**
+ * @brief Сравнивает два значения для qsort()
+ * @param a Указатель на первое значение
+ * @param b Указатель на второе значение
+ * @return Отрицательное, ноль или положительное число
+ */
+static int compare_values(const void *a, const void *b) {
+  long long x = *(const long long *)a, y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Вычисляет перцентиль по методу ближайшего ранга
+ * @param sorted Отсортированные значения
+ * @param count Количество значений
+ * @param percent Перцентиль (0..100)
+ * @return Значение перцентиля
+ */
+static long long percentile(const long long *sorted, int count, int percent) {
+  long long rank = ((long long)count * percent + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * @brief Строит распределение метрики по всем играм
+ * @param results Итоги игр
+ * @param count Количество игр
+ * @param metric Метрика
+ * @param[out] stat Среднее, минимум, p50, p90, p99 и максимум
+ */
+void batch_stat(const SimGame_t *results, int count, BatchMetric_t metric,
+                BatchStat_t *stat) {
+  long long *values = malloc(sizeof(long long) * count);
+  memset(stat, 0, sizeof(*stat));
+  if (values != NULL && count > 0) {
+    double sum = 0;
+    for (int i = 0; i < count; i++) {
+      values[i] = batch_metric(&results[i], metric);
+      sum += (double)values[i];
+    }
+    qsort(values, count, sizeof(long long), compare_values);
+    stat->mean = sum / count;
+    stat->min = values[0];
+    stat->p50 = percentile(values, count, 50);
+    stat->p90 = percentile(values, count, 90);
+    stat->p99 = percentile(values, count, 99);
+    stat->max = values[count - 1];
+  }
+  free(values);
+}
+
+/**
+ * @brief Печатает сводку прогона
+ * @param options Параметры прогона
+ * @param results Итоги игр
+ * @param steals Число удачных краж
+ * @param seconds Затраченное время
+ */
+void print_batch_summary(const BatchOptions_t *options,
+                         const SimGame_t *results, long steals,
+                         double seconds) {
+  static const char *names[BATCH_METRICS] = {"score", "lines", "level",
+                                             "pieces"};
+  int games = options->sim.games;
+  long long steps = 0;
+  for (int i = 0; i < games; i++) steps += results[i].steps;
+  printf("games: %d\n", games);
+  printf("workers: %d\n", options->workers);
+  printf("steals: %ld\n", steals);
+  printf("steps: %lld\n", steps);
+  printf("time: %.3f s\n", seconds);
+  printf("games/sec: %.1f\n", games / seconds);
+  printf("%-8s %12s %10s %10s %10s %10s %10s\n", "", "mean", "min", "p50",
+         "p90", "p99", "max");
+  for (int m = 0; m < BATCH_METRICS; m++) {
+    BatchStat_t stat;
+    batch_stat(results, games, (BatchMetric_t)m, &stat);
+    printf("%-8s %12.1f %10lld %10lld %10lld %10lld %10lld\n", names[m],
+           stat.mean, stat.min, stat.p50, stat.p90, stat.p99, stat.max);
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef TETRIS_BATCH_H
+#define TETRIS_BATCH_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "tetris_sim.h"
+
+#define BATCH_GAMES 100000  ///< количество игр по умолчанию
+#define BATCH_LINE 64  ///< размер строки кэша для очередей потоков
+
+/**
+ * @enum BatchMetric_t
+ * @brief Метрики игры, по которым строится сводка
+ */
+typedef enum {
+  BATCH_SCORE,   ///< Счет
+  BATCH_LINES,   ///< Удаленные линии
+  BATCH_LEVEL,   ///< Достигнутый уровень
+  BATCH_PIECES,  ///< Выпущенные фигуры
+  BATCH_METRICS  ///< Количество метрик
+} BatchMetric_t;
+
+/**
+ * @struct BatchOptions_t
+ * @brief Параметры пакетного прогона
+ */
+typedef struct {
+  SimOptions_t sim;  ///< Параметры каждой игры (ai_threads всегда 1)
+  int workers;  ///< Рабочих потоков (по умолчанию - по числу ядер)
+  const char *corpus;  ///< Корпус для проигрывания (NULL - новые игры)
+} BatchOptions_t;
+
+/**
+ * @struct BatchQueue_t
+ * @brief Диапазон еще не сыгранных игр одного потока
+ * @details Границы [lo, hi) упакованы в одно 64-битное слово (lo в младших
+ * 32 битах), поэтому и владелец, и вор меняют диапазон одним CAS.
+ * Каждая очередь занимает свою строку кэша.
+ */
+typedef struct {
+  _Alignas(BATCH_LINE) _Atomic uint64_t range;  ///< Упакованные lo и hi
+} BatchQueue_t;
+
+/**
+ * @struct BatchWorker_t
+ * @brief Рабочий поток пакетного прогона
+ */
+typedef struct {
+  struct BatchRun_t *run;  ///< Общее состояние прогона
+  int id;            ///< Номер потока (и его очереди)
+  long games;        ///< Сыграно игр
+  long steals;       ///< Удачных краж
+  pthread_t thread;  ///< Поток
+} BatchWorker_t;
+
+/**
+ * @struct BatchRun_t
+ * @brief Общее состояние пакетного прогона
+ */
+typedef struct BatchRun_t {
+  const BatchOptions_t *options;  ///< Параметры
+  BatchQueue_t *queues;           ///< Очереди потоков
+  BatchWorker_t *workers;         ///< Рабочие потоки
+  SimGame_t *results;             ///< Итоги игр по номерам
+  const Corpus_t *corpus;  ///< Проигрываемый корпус (NULL - нет)
+} BatchRun_t;
+
+/**
+ * @struct BatchStat_t
+ * @brief Распределение одной метрики по всем играм
+ */
+typedef struct {
+  double mean;  ///< Среднее
+  long long min, p50, p90, p99, max;  ///< Минимум, перцентили и максимум
+} BatchStat_t;
+
+int parse_batch_options(int argc, char *argv[], BatchOptions_t *options);
+int run_batch(const BatchOptions_t *options, const Corpus_t *corpus,
+              SimGame_t *results, long *steals);
+void batch_replay_game(const Corpus_t *corpus, uint64_t game,
+                       SimGame_t *result);
+int batch_pop(BatchQueue_t *queue, uint32_t *game);
+int batch_steal(BatchRun_t *run, int thief);
+void batch_stat(const SimGame_t *results, int count, BatchMetric_t metric,
+                BatchStat_t *stat);
+void print_batch_summary(const BatchOptions_t *options,
+                         const SimGame_t *results, long steals,
+                         double seconds);
+
+#endif  // TETRIS_BATCH_H
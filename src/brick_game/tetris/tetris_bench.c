@@ -0,0 +1,467 @@
+/**
+ * @file tetris_bench.c
+ * @brief Микробенчмарки горячих функций Tetris
+ * @ingroup sim_module
+ * @details Замеряет время одной операции проверки столкновений,
+ * поворота, появления фигуры, сброса, снимка и восстановления игры,
+ * подсчета очков, оценки поля и отрисовки кадра.
+ * Доски и фигуры строятся из постоянного начального значения, каждый
+ * случай замеряется несколько раз, и итоги (нс на операцию, разброс между
+ * замерами) печатаются таблицей и при -o пишутся в JSON для сравнения
+ * версий.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_bench.h"
+
+/**
+ * @brief Ставит на доску фигуру из набора
+ * @param context Входные данные
+ * @param op Номер операции
+ */
+static void bench_pick(BenchContext_t *context, long op) {
+  context->game->current = context->figures[op & (BENCH_FIGURES - 1)];
+}
+
+/// Случай: collision() для фигур набора
+static void bench_collision(BenchContext_t *context, long ops) {
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    bench_pick(context, op);
+    sum += collision(context->game);
+  }
+  context->sink = sum;
+}
+
+/// Случай: check_figure_overlay() для фигур набора
+static void bench_overlay(BenchContext_t *context, long ops) {
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    bench_pick(context, op);
+    sum += check_figure_overlay(context->game);
+  }
+  context->sink = sum;
+}
+
+/// Случай: rotate_figure() с отскоками от стен и мусора
+static void bench_rotate(BenchContext_t *context, long ops) {
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    bench_pick(context, op);
+    rotate_figure(context->game);
+    sum += context->game->current.rotation + context->game->current.x;
+  }
+  context->sink = sum;
+}
+
+/// Случай: spawn_figure() вместе с выбором следующей фигуры
+static void bench_spawn(BenchContext_t *context, long ops) {
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    spawn_figure(context->game);
+    sum += context->game->current.id;
+  }
+  context->sink = sum;
+}
+
+/// Случай: сброс фигуры (landing_y(), как по Down в MOVING)
+static void bench_hard_drop(BenchContext_t *context, long ops) {
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    bench_pick(context, op);
+    context->game->current.y =
+        (int8_t)landing_y(context->game, &context->game->current);
+    sum += context->game->current.y;
+  }
+  context->sink = sum;
+}
+
+/// Случай: tetris_snapshot() доски с мусором
+static void bench_snapshot(BenchContext_t *context, long ops) {
+  GameSnapshot_t snapshot;
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    bench_pick(context, op);
+    tetris_snapshot(context->game, &snapshot);
+    sum += snapshot.rows[HEIGHT - 1] + snapshot.current.x;
+  }
+  context->sink = sum;
+}
+
+/// Случай: tetris_restore() - основа случаев подсчета очков
+static void bench_restore(BenchContext_t *context, long ops) {
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    tetris_restore(context->game, &context->clears[op & 3]);
+    sum += context->game->rows[BOARD_TOP + HEIGHT - 1];
+  }
+  context->sink = sum;
+}
+
+/// Случай: memcpy() состояния GameInfo_t до рекорда - мерка для снимков
+static void bench_game_copy(BenchContext_t *context, long ops) {
+  static GameInfo_t copy;
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    bench_pick(context, op);
+    memcpy(&copy, context->game, offsetof(GameInfo_t, high_score));
+    sum += copy.rows[BOARD_TOP + HEIGHT - 1] + copy.current.x;
+  }
+  context->sink = sum;
+}
+
+/**
+ * @brief Восстанавливает доску с lines полными строками и считает очки
+ * @param context Входные данные
+ * @param ops Количество операций
+ * @param lines Полных строк (0-4)
+ */
+static void bench_score(BenchContext_t *context, long ops, int lines) {
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    tetris_restore(context->game, &context->clears[lines]);
+    calculate_score(context->game);
+    sum += context->game->score;
+  }
+  context->sink = sum;
+}
+
+/// Случаи: calculate_score() с удалением 0-4 строк (вместе с восстановлением)
+static void bench_score_0(BenchContext_t *context, long ops) {
+  bench_score(context, ops, 0);
+}
+static void bench_score_1(BenchContext_t *context, long ops) {
+  bench_score(context, ops, 1);
+}
+static void bench_score_2(BenchContext_t *context, long ops) {
+  bench_score(context, ops, 2);
+}
+static void bench_score_3(BenchContext_t *context, long ops) {
+  bench_score(context, ops, 3);
+}
+static void bench_score_4(BenchContext_t *context, long ops) {
+  bench_score(context, ops, 4);
+}
+
+/// Случай: board_features() для доски HEIGHT x WIDTH
+static void bench_features(BenchContext_t *context, long ops) {
+  BoardFeatures_t features;
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    board_features(context->game->rows, HEIGHT, WIDTH, &features);
+    sum += features.holes;
+  }
+  context->sink = sum;
+}
+
+/// Случай: board_features() для доски HEIGHT x BENCH_WIDE
+static void bench_features_wide(BenchContext_t *context, long ops) {
+  BoardFeatures_t features;
+  long sum = 0;
+  for (long op = 0; op < ops; op++) {
+    board_features(context->wide, HEIGHT, BENCH_WIDE, &features);
+    sum += features.holes;
+  }
+  context->sink = sum;
+}
+
+/// Случай: кадр print_game_screen() после сдвига фигуры на клетку
+static void bench_render(BenchContext_t *context, long ops) {
+  GameInfo_t *game = context->game;
+  for (long op = 0; op < ops; op++) {
+    game->current.x = (int8_t)(op & 1 ? 3 : 4);
+    print_game_screen(game);
+    refresh();
+  }
+}
+
+/// Случай: полная перерисовка экрана print_game_screen()
+static void bench_render_full(BenchContext_t *context, long ops) {
+  for (long op = 0; op < ops; op++) {
+    invalidate_screen();
+    print_game_screen(context->game);
+    refresh();
+  }
+}
+
+/// Все случаи в порядке вывода
+static const BenchCase_t bench_cases[] = {
+    {"collision", bench_collision, 0},
+    {"check_figure_overlay", bench_overlay, 0},
+    {"rotate_figure", bench_rotate, 0},
+    {"spawn_figure", bench_spawn, 0},
+    {"hard_drop", bench_hard_drop, 0},
+    {"tetris_snapshot", bench_snapshot, 0},
+    {"tetris_restore", bench_restore, 0},
+    {"game_copy", bench_game_copy, 0},
+    {"calculate_score_0", bench_score_0, 0},
+    {"calculate_score_1", bench_score_1, 0},
+    {"calculate_score_2", bench_score_2, 0},
+    {"calculate_score_3", bench_score_3, 0},
+    {"calculate_score_4", bench_score_4, 0},
+    {"board_features", bench_features, 0},
+    {"board_features_wide", bench_features_wide, 0},
+    {"print_game_screen", bench_render, 1},
+    {"print_game_screen_full", bench_render_full, 1},
+};
+
+/**
+ * @brief Точка входа бенчмарков
+ * @return 0 при успешном завершении, 1 при ошибке
+ * @details Параметры: -r замеров на случай, -t длительность замера (мс),
+ * -f подстрока имени случая, -o файл результатов в JSON. Случаи отрисовки
+ * пропускаются, если терминал BENCH_TERM не найден.
+ */
+int main(int argc, char *argv[]) {
+  int count = (int)(sizeof(bench_cases) / sizeof(bench_cases[0]));
+  BenchResult_t results[sizeof(bench_cases) / sizeof(bench_cases[0])];
+  BenchOptions_t options;
+  BenchContext_t context;
+  int done = 0;
+  int status = parse_bench_options(argc, argv, &options);
+  if (status == 0) status = bench_context_init(&context);
+  if (status == 0) {
+    printf("%-24s %12s %10s %10s %10s %7s\n", "case", "ops", "ns/op",
+           "min", "max", "+-%");
+    for (int i = 0; i < count; i++) {
+      const BenchCase_t *bench = &bench_cases[i];
+      if (options.filter != NULL && strstr(bench->name, options.filter) == NULL)
+        continue;
+      if (bench->screen && context.screen == NULL) {
+        fprintf(stderr, "%s: no terminal %s, skipped\n", bench->name,
+                BENCH_TERM);
+        continue;
+      }
+      BenchResult_t *result = &results[done++];
+      bench_case(&options, &context, bench, result);
+      printf("%-24s %12ld %10.2f %10.2f %10.2f %7.1f\n", result->name,
+             result->ops, result->mean, result->min, result->max,
+             result->mean > 0 ? 100.0 * result->stddev / result->mean : 0.0);
+    }
+    bench_context_free(&context);
+  }
+  if (status == 0 && options.json != NULL)
+    status = write_bench_json(options.json, &options, results, done);
+  return status;
+}
+
+/**
+ * @brief Разбирает параметры командной строки
+ * @param argc Количество аргументов
+ * @param argv Аргументы
+ * @param[out] options Заполняемые параметры замеров
+ * @return 0 при успехе, 1 при ошибке
+ */
+int parse_bench_options(int argc, char *argv[], BenchOptions_t *options) {
+  int status = 0;
+  int opt;
+  options->samples = BENCH_SAMPLES;
+  options->sample_ms = BENCH_SAMPLE_MS;
+  options->filter = NULL;
+  options->json = NULL;
+  while (status == 0 && (opt = getopt(argc, argv, "r:t:f:o:")) != -1) {
+    switch (opt) {
+      case 'r':
+        options->samples = atoi(optarg);
+        break;
+      case 't':
+        options->sample_ms = atoi(optarg);
+        break;
+      case 'f':
+        options->filter = optarg;
+        break;
+      case 'o':
+        options->json = optarg;
+        break;
+      default:
+        status = 1;
+        break;
+    }
+  }
+  if (options->samples < 2 || options->sample_ms <= 0) status = 1;
+  if (status != 0)
+    fprintf(stderr,
+            "usage: %s [-r samples] [-t sample_ms] [-f filter] [-o json]\n",
+            argv[0]);
+  return status;
+}
+
+/**
+ * @brief Заполняет нижние строки доски мусором
+ * @param game Указатель на состояние игры
+ * @param rng Генератор
+ * @details В каждой строке мусора остается хотя бы одна дыра, поэтому
+ * строки не удаляются
+ */
+static void bench_garbage(GameInfo_t *game, Rng_t *rng) {
+  reset_field(game);
+  for (int y = game->height - 8; y < game->height; y++) {
+    int hole = (int)rng_bounded(rng, game->width);
+    for (int x = 0; x < game->width; x++) {
+      if (x != hole && rng_bounded(rng, 10) < 7)
+        set_field_cell(game, y, x, 1 + (int)rng_bounded(rng, FIGURES_COUNT));
+    }
+  }
+}
+
+/**
+ * @brief Строит доски, фигуры и терминал отрисовки
+ * @param[out] context Входные данные
+ * @return 0 при успехе, 1 при нехватке памяти
+ */
+int bench_context_init(BenchContext_t *context) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = BENCH_SEED};
+  TetrisConfig_t wide_config = config;
+  wide_config.width = BENCH_WIDE;
+  GameInfo_t *game = tetris_create(&config);
+  GameInfo_t *wide = tetris_create(&wide_config);
+  Rng_t rng;
+  memset(context, 0, sizeof(*context));
+  context->game = game;
+  rng_seed(&rng, BENCH_SEED);
+  for (int lines = 0; game != NULL && lines <= 4; lines++) {
+    bench_garbage(game, &rng);
+    for (int y = HEIGHT - lines; y < HEIGHT; y++) {
+      for (int x = 0; x < WIDTH; x++) set_field_cell(game, y, x, 1);
+    }
+    tetris_snapshot(game, &context->clears[lines]);
+  }
+  if (game != NULL) {
+    bench_garbage(game, &rng);
+    for (int i = 0; i < BENCH_FIGURES; i++) {
+      Tetramino *figure = &game->current;
+      init_figure(figure, 1 + (int)rng_bounded(&rng, FIGURES_COUNT));
+      figure->y = (int8_t)rng_bounded(&rng, HEIGHT - 10);
+      for (int turns = (int)rng_bounded(&rng, 4); turns > 0; turns--)
+        rotate_tetramino(game, figure);
+      do {
+        figure->x = (int8_t)rng_bounded(&rng, WIDTH);
+      } while (check_leaving_field(game));
+      context->figures[i] = *figure;
+    }
+    game->current = context->figures[0];
+    game->state = MOVING;
+    tetris_snapshot(game, &context->board);
+    memcpy(context->field, game->field, sizeof(context->field));
+    context->screen_out = fopen("/dev/null", "w");
+    context->screen_in = fopen("/dev/null", "r");
+  }
+  if (wide != NULL) {
+    bench_garbage(wide, &rng);
+    memcpy(context->wide, wide->rows, sizeof(context->wide));
+    tetris_destroy(wide);
+  }
+  if (context->screen_out != NULL && context->screen_in != NULL)
+    context->screen =
+        newterm(BENCH_TERM, context->screen_out, context->screen_in);
+  if (context->screen != NULL) {
+    set_term(context->screen);
+    curs_set(0);
+    init_colors();
+  }
+  return game == NULL || wide == NULL;
+}
+
+/**
+ * @brief Освобождает входные данные
+ * @param context Входные данные
+ */
+void bench_context_free(BenchContext_t *context) {
+  if (context->screen != NULL) {
+    endwin();
+    delscreen(context->screen);
+  }
+  if (context->screen_out != NULL) fclose(context->screen_out);
+  if (context->screen_in != NULL) fclose(context->screen_in);
+  tetris_destroy(context->game);
+}
+
+/**
+ * @brief Выполняет ops операций случая на исходной доске
+ * @param context Входные данные
+ * @param bench Случай
+ * @param ops Количество операций
+ * @return Затраченное время (с)
+ * @note Цветовой слой восстанавливается отдельно: удаление строк сдвигает
+ *       его, а снимок его не содержит
+ */
+static double bench_time(BenchContext_t *context, const BenchCase_t *bench,
+                         long ops) {
+  tetris_restore(context->game, &context->board);
+  memcpy(context->game->field, context->field, sizeof(context->field));
+  double start = monotonic_seconds();
+  bench->run(context, ops);
+  return monotonic_seconds() - start;
+}
+
+/**
+ * @brief Замеряет один случай
+ * @param options Параметры замеров
+ * @param context Входные данные
+ * @param bench Случай
+ * @param[out] result Итоги замеров
+ * @details Сначала подбирает число операций, которое занимает
+ * options->sample_ms (это же прогревает кэши), затем делает
+ * options->samples замеров с этим числом операций
+ */
+void bench_case(const BenchOptions_t *options, BenchContext_t *context,
+                const BenchCase_t *bench, BenchResult_t *result) {
+  double target = options->sample_ms / 1000.0;
+  long ops = 1;
+  double seconds = bench_time(context, bench, ops);
+  while (seconds < target) {
+    double scale = seconds > 0 ? 1.2 * target / seconds : 100.0;
+    ops = (long)(ops * (scale < 100.0 ? scale : 100.0)) + 1;
+    seconds = bench_time(context, bench, ops);
+  }
+  double sum = 0, squares = 0;
+  result->name = bench->name;
+  result->ops = ops;
+  result->min = INFINITY;
+  result->max = 0;
+  for (int i = 0; i < options->samples; i++) {
+    double ns = bench_time(context, bench, ops) * 1e9 / ops;
+    sum += ns;
+    squares += ns * ns;
+    if (ns < result->min) result->min = ns;
+    if (ns > result->max) result->max = ns;
+  }
+  result->mean = sum / options->samples;
+  double variance = (squares - sum * result->mean) / (options->samples - 1);
+  result->stddev = variance > 0 ? sqrt(variance) : 0.0;
+}
+
+/**
+ * @brief Пишет итоги замеров в JSON
+ * @param path Файл результатов
+ * @param options Параметры замеров
+ * @param results Итоги
+ * @param count Количество итогов
+ * @return 0 при успехе, 1 - файл не записан
+ */
+int write_bench_json(const char *path, const BenchOptions_t *options,
+                     const BenchResult_t *results, int count) {
+  FILE *file = fopen(path, "w");
+  int status = file == NULL;
+  if (file != NULL) {
+    fprintf(file,
+            "{\n  \"seed\": %d,\n  \"samples\": %d,\n  \"sample_ms\": %d,\n"
+            "  \"unit\": \"ns/op\",\n  \"results\": [",
+            BENCH_SEED, options->samples, options->sample_ms);
+    for (int i = 0; i < count; i++) {
+      const BenchResult_t *result = &results[i];
+      fprintf(file,
+              "%s\n    {\"name\": \"%s\", \"ops\": %ld, \"mean\": %.3f, "
+              "\"stddev\": %.3f, \"variance\": %.3f, \"min\": %.3f, "
+              "\"max\": %.3f}",
+              i > 0 ? "," : "", result->name, result->ops, result->mean,
+              result->stddev, result->stddev * result->stddev, result->min,
+              result->max);
+    }
+    fprintf(file, "\n  ]\n}\n");
+    if (fclose(file) != 0) status = 1;
+  }
+  return status;
+}
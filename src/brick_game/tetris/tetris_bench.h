@@ -0,0 +1,78 @@
+#ifndef TETRIS_BENCH_H
+#define TETRIS_BENCH_H
+
+#include <math.h>
+
+#include "../../gui/cli/frontend_tetris.h"
+#include "tetris_sim.h"
+
+/// параметры замеров по умолчанию
+#define BENCH_SAMPLES 15  ///< замеров на случай
+#define BENCH_SAMPLE_MS 20  ///< длительность одного замера (мс)
+#define BENCH_SEED 2024  ///< начальное значение досок и фигур
+#define BENCH_FIGURES 256  ///< фигур в наборе (степень двойки)
+#define BENCH_TERM "xterm-256color"  ///< тип терминала для отрисовки
+#define BENCH_WIDE 16  ///< ширина поля для случаев широкого поля
+
+/**
+ * @struct BenchOptions_t
+ * @brief Параметры запуска замеров
+ */
+typedef struct {
+  int samples;    ///< Замеров на случай
+  int sample_ms;  ///< Длительность одного замера (мс)
+  const char *filter;  ///< Подстрока имени случая (NULL - все случаи)
+  const char *json;  ///< Файл результатов в JSON (NULL - не писать)
+} BenchOptions_t;
+
+/**
+ * @struct BenchContext_t
+ * @brief Неизменные входные данные замеров
+ * @details Доски и фигуры строятся из BENCH_SEED, поэтому в разных версиях
+ * программы замеряется одна и та же работа
+ */
+typedef struct {
+  GameInfo_t *game;  ///< Игра, над которой идут операции
+  Tetramino figures[BENCH_FIGURES];  ///< Фигуры в разных местах доски
+  GameSnapshot_t board;  ///< Доска с мусором внизу
+  uint8_t field[HEIGHT_MAX][WIDTH_MAX];  ///< Цвета клеток доски board
+  GameSnapshot_t clears[5];  ///< Доски с 0-4 полными строками
+  uint32_t wide[BOARD_ROWS_MAX];  ///< Битборд поля HEIGHT x BENCH_WIDE
+  SCREEN *screen;      ///< Терминал отрисовки (или NULL)
+  FILE *screen_out;    ///< Вывод терминала (/dev/null)
+  FILE *screen_in;     ///< Ввод терминала (/dev/null)
+  volatile long sink;  ///< Приемник результатов (против выброса кода)
+} BenchContext_t;
+
+/**
+ * @struct BenchCase_t
+ * @brief Случай замера
+ */
+typedef struct {
+  const char *name;  ///< Имя случая
+  void (*run)(BenchContext_t *context, long ops);  ///< Выполняет ops операций
+  int screen;  ///< Нужен терминал отрисовки
+} BenchCase_t;
+
+/**
+ * @struct BenchResult_t
+ * @brief Итоги замеров одного случая (нс на операцию)
+ */
+typedef struct {
+  const char *name;  ///< Имя случая
+  long ops;          ///< Операций в одном замере
+  double mean;       ///< Среднее
+  double stddev;  ///< Стандартное отклонение между замерами
+  double min;  ///< Лучший замер
+  double max;  ///< Худший замер
+} BenchResult_t;
+
+int parse_bench_options(int argc, char *argv[], BenchOptions_t *options);
+int bench_context_init(BenchContext_t *context);
+void bench_context_free(BenchContext_t *context);
+void bench_case(const BenchOptions_t *options, BenchContext_t *context,
+                const BenchCase_t *bench, BenchResult_t *result);
+int write_bench_json(const char *path, const BenchOptions_t *options,
+                     const BenchResult_t *results, int count);
+
+#endif  // TETRIS_BENCH_H
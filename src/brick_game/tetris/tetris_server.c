@@ -0,0 +1,502 @@
+/**
+ * @file tetris_server.c
+ * @brief Игровой сервер Tetris для ботов на Unix-сокете
+ * @defgroup server_module Server Module
+ * @{
+ * @details Один долгоживущий процесс держит много экземпляров игры и
+ * обслуживает клиентов по двоичному протоколу (см. protocol.h) вместо того,
+ * чтобы каждый бот собирался со статической библиотекой. Все соединения
+ * обслуживает один поток в цикле epoll: шаг автомата занимает сотни
+ * наносекунд, поэтому время запроса - это в основном системные вызовы, и
+ * пачка шагов в одном запросе делит их между всеми шагами.
+ */
+
+#define _GNU_SOURCE
+
+#include "tetris_server.h"
+
+/// Запрос завершения сервера (SIGINT, SIGTERM)
+static volatile sig_atomic_t stop_requested = 0;
+
+/**
+ * @brief Обработчик сигналов завершения
+ * @param signal Номер сигнала
+ */
+static void request_stop(int signal) {
+  (void)signal;
+  stop_requested = 1;
+}
+
+/**
+ * @brief Точка входа сервера
+ * @return 0 при успешном завершении, 1 при ошибке
+ * @details Параметры: -S путь сокета (по умолчанию SERVER_SOCKET), -n
+ * предел игр. С -c вместо сервера запускается клиент замера задержки:
+ * он создает -g игр, делает -r запросов STEP по -b шагов и печатает
+ * время запроса от отправки до ответа.
+ */
+int main(int argc, char *argv[]) {
+  ServerOptions_t options;
+  int status = parse_server_options(argc, argv, &options);
+  if (status == 0)
+    status = options.client ? run_client(&options) : run_server(&options);
+  return status;
+}
+
+/**
+ * @brief Разбирает параметры командной строки
+ * @param argc Количество аргументов
+ * @param argv Аргументы
+ * @param[out] options Заполняемые параметры
+ * @return 0 при успехе, 1 при ошибке
+ */
+int parse_server_options(int argc, char *argv[], ServerOptions_t *options) {
+  int status = 0;
+  int opt;
+  options->path = SERVER_SOCKET;
+  options->max_games = SERVER_GAMES_MAX;
+  options->client = 0;
+  options->games = CLIENT_GAMES;
+  options->rounds = CLIENT_ROUNDS;
+  options->batch = CLIENT_BATCH;
+  while (status == 0 && (opt = getopt(argc, argv, "S:n:cg:r:b:")) != -1) {
+    switch (opt) {
+      case 'S':
+        options->path = optarg;
+        break;
+      case 'n':
+        options->max_games = (uint32_t)strtoul(optarg, NULL, 10);
+        break;
+      case 'c':
+        options->client = 1;
+        break;
+      case 'g':
+        options->games = atoi(optarg);
+        break;
+      case 'r':
+        options->rounds = atoi(optarg);
+        break;
+      case 'b':
+        options->batch = atoi(optarg);
+        break;
+      default:
+        status = 1;
+        break;
+    }
+  }
+  if (options->max_games == 0 || options->games <= 0 ||
+      options->rounds <= 0 || options->batch <= 0 ||
+      options->batch > PROTO_STEPS_MAX ||
+      strlen(options->path) >= sizeof(((struct sockaddr_un *)0)->sun_path))
+    status = 1;
+  if (status != 0)
+    fprintf(stderr,
+            "usage: %s [-S socket] [-n max_games] "
+            "[-c [-g games] [-r rounds] [-b batch]]\n",
+            argv[0]);
+  return status;
+}
+
+/**
+ * @brief Открывает слушающий сокет
+ * @param path Путь сокета; прежний файл сокета удаляется
+ * @return Сокет или -1 при ошибке
+ */
+static int open_listener(const char *path) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  strcpy(address.sun_path, path);
+  unlink(path);
+  if (fd >= 0 &&
+      (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+       listen(fd, SOMAXCONN) != 0)) {
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief Принимает все ожидающие соединения
+ * @param epoll Экземпляр epoll
+ * @param listener Слушающий сокет
+ * @param connections Соединения по номеру сокета (растет)
+ * @param count Емкость connections
+ */
+static void accept_connections(int epoll, int listener,
+                               Connection_t ***connections, int *count) {
+  int fd;
+  while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >=
+         0) {
+    Connection_t *connection = calloc(1, sizeof(Connection_t));
+    if (fd >= *count) {
+      int grown_count = *count > 0 ? *count : 64;
+      while (grown_count <= fd) grown_count *= 2;
+      Connection_t **grown =
+          realloc(*connections, sizeof(Connection_t *) * grown_count);
+      if (grown != NULL) {
+        memset(grown + *count, 0,
+               sizeof(Connection_t *) * (grown_count - *count));
+        *connections = grown;
+        *count = grown_count;
+      }
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+    if (connection != NULL && fd < *count &&
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) == 0) {
+      connection->fd = fd;
+      connection->events = EPOLLIN;
+      (*connections)[fd] = connection;
+    } else {
+      free(connection);
+      close(fd);
+    }
+  }
+}
+
+/**
+ * @brief Обслуживает клиентов, пока не придет SIGINT или SIGTERM
+ * @param options Параметры сервера
+ * @return 0 при успешном завершении, 1 - сокет не открылся
+ * @details Сокеты работают в неблокирующем режиме по уровню: за одно
+ * событие читается то, что уже пришло, все целые сообщения сразу
+ * обрабатываются, и ответы отправляются в том же проходе. Пока у
+ * соединения остаются неотправленные ответы, сервер ждет записи вместо
+ * чтения, так что клиент, не читающий ответы, не раздувает буферы.
+ */
+int run_server(const ServerOptions_t *options) {
+  struct sigaction action = {.sa_handler = request_stop};
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+  Connection_t **connections = NULL;
+  int count = 0;
+  GameServer_t server;
+  int listener = open_listener(options->path);
+  int epoll = epoll_create1(EPOLL_CLOEXEC);
+  int status = listener < 0 || epoll < 0 ||
+               epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event) != 0;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  server_init(&server, options->max_games);
+  if (status != 0)
+    perror(options->path);
+  else
+    fprintf(stderr, "listening on %s\n", options->path);
+  while (status == 0 && !stop_requested) {
+    struct epoll_event events[SERVER_EVENTS];
+    int ready = epoll_wait(epoll, events, SERVER_EVENTS, -1);
+    for (int i = 0; i < ready; i++) {
+      Connection_t *connection = events[i].data.ptr;
+      if (connection == NULL) {
+        accept_connections(epoll, listener, &connections, &count);
+      } else {
+        int closed = 0;
+        if (connection->events == EPOLLIN)
+          closed = connection_read(&server, connection);
+        if (!closed) closed = connection_flush(connection);
+        uint32_t wanted =
+            connection->sent < connection->out.len ? EPOLLOUT : EPOLLIN;
+        if (!closed && wanted != connection->events) {
+          struct epoll_event update = {.events = wanted,
+                                       .data.ptr = connection};
+          closed = epoll_ctl(epoll, EPOLL_CTL_MOD, connection->fd,
+                             &update) != 0;
+          connection->events = wanted;
+        }
+        if (closed) {
+          connections[connection->fd] = NULL;
+          connection_close(&server, epoll, connection);
+        }
+      }
+    }
+  }
+  for (int fd = 0; fd < count; fd++) {
+    if (connections[fd] != NULL)
+      connection_close(&server, epoll, connections[fd]);
+  }
+  free(connections);
+  server_free(&server);
+  if (epoll >= 0) close(epoll);
+  if (listener >= 0) {
+    close(listener);
+    unlink(options->path);
+  }
+  return status;
+}
+
+/**
+ * @brief Читает пришедшие данные и обрабатывает целые сообщения
+ * @param server Сервер
+ * @param connection Соединение
+ * @return 0, если соединение живо; 1 - клиент закрыл его, ошибка сокета,
+ *         неверный размер сообщения или нехватка памяти
+ * @details Короткое чтение значит, что сокет опустел, и лишний вызов
+ * read() до EAGAIN не нужен
+ */
+int connection_read(GameServer_t *server, Connection_t *connection) {
+  ProtoBuffer_t *in = &connection->in;
+  int closed = 0;
+  int more = 1;
+  while (!closed && more) {
+    ssize_t got = -1;
+    size_t room = 0;
+    if (proto_buffer_reserve(in, SERVER_READ) == 0) {
+      room = in->cap - in->len;
+      got = read(connection->fd, in->data + in->len, room);
+    }
+    if (got > 0) {
+      size_t pos = 0;
+      long frame;
+      in->len += (size_t)got;
+      more = (size_t)got == room;
+      while (!closed &&
+             (frame = proto_frame_size(in->data + pos, in->len - pos)) != 0) {
+        closed = frame < 0 || server_handle(server, connection->fd,
+                                            in->data + pos, (size_t)frame,
+                                            &connection->out) != 0;
+        pos += frame > 0 ? (size_t)frame : 0;
+      }
+      memmove(in->data, in->data + pos, in->len - pos);
+      in->len -= pos;
+    } else if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      more = 0;
+    } else if (!(got < 0 && errno == EINTR)) {
+      closed = 1;
+    }
+  }
+  return closed;
+}
+
+/**
+ * @brief Отправляет накопленные ответы
+ * @param connection Соединение
+ * @return 0, если соединение живо; 1 - ошибка сокета
+ * @details Отправляет, пока сокет принимает данные; остаток уходит по
+ * EPOLLOUT, на который run_server() подписывает сокет, пока он есть
+ */
+int connection_flush(Connection_t *connection) {
+  ProtoBuffer_t *out = &connection->out;
+  int closed = 0;
+  int blocked = 0;
+  while (!closed && !blocked && connection->sent < out->len) {
+    ssize_t sent = send(connection->fd, out->data + connection->sent,
+                        out->len - connection->sent, MSG_NOSIGNAL);
+    if (sent > 0)
+      connection->sent += (size_t)sent;
+    else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      blocked = 1;
+    else if (!(sent < 0 && errno == EINTR))
+      closed = 1;
+  }
+  if (connection->sent == out->len) {
+    out->len = 0;
+    connection->sent = 0;
+  }
+  return closed;
+}
+
+/**
+ * @brief Закрывает соединение и удаляет его игры
+ * @param server Сервер
+ * @param epoll Экземпляр epoll
+ * @param connection Соединение
+ */
+void connection_close(GameServer_t *server, int epoll,
+                      Connection_t *connection) {
+  epoll_ctl(epoll, EPOLL_CTL_DEL, connection->fd, NULL);
+  server_drop_owner(server, connection->fd);
+  close(connection->fd);
+  proto_buffer_free(&connection->in);
+  proto_buffer_free(&connection->out);
+  free(connection);
+}
+
+/**
+ * @brief Записывает буфер в сокет целиком
+ * @param fd Сокет
+ * @param data Данные
+ * @param size Размер данных
+ * @return 0 при успехе, 1 при ошибке
+ */
+static int write_all(int fd, const uint8_t *data, size_t size) {
+  int status = 0;
+  while (status == 0 && size > 0) {
+    ssize_t done = write(fd, data, size);
+    if (done > 0) {
+      data += done;
+      size -= (size_t)done;
+    } else if (!(done < 0 && errno == EINTR)) {
+      status = 1;
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Читает из сокета ровно size байт
+ * @param fd Сокет
+ * @param[out] data Буфер
+ * @param size Сколько прочитать
+ * @return 0 при успехе, 1 - ошибка или соединение закрыто
+ */
+static int read_exact(int fd, uint8_t *data, size_t size) {
+  int status = 0;
+  while (status == 0 && size > 0) {
+    ssize_t done = read(fd, data, size);
+    if (done > 0) {
+      data += done;
+      size -= (size_t)done;
+    } else if (!(done < 0 && errno == EINTR)) {
+      status = 1;
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Отправляет запрос и дожидается ответа
+ * @param fd Сокет, соединенный с сервером
+ * @param request Запрос
+ * @param size Размер запроса
+ * @param[out] reply Ответ целиком (с заголовком)
+ * @return 0 при успехе, 1 при ошибке
+ */
+int client_call(int fd, const uint8_t *request, size_t size,
+                ProtoBuffer_t *reply) {
+  ProtoHeader_t header;
+  reply->len = 0;
+  int status = proto_buffer_reserve(reply, PROTO_HEADER_SIZE) ||
+               write_all(fd, request, size) ||
+               read_exact(fd, reply->data, PROTO_HEADER_SIZE);
+  if (status == 0) {
+    proto_get_header(reply->data, &header);
+    status = header.size < PROTO_HEADER_SIZE ||
+             proto_buffer_reserve(reply, header.size) ||
+             read_exact(fd, reply->data + PROTO_HEADER_SIZE,
+                        header.size - PROTO_HEADER_SIZE);
+    if (status == 0) reply->len = header.size;
+  }
+  return status;
+}
+
+/**
+ * @brief Создает игры клиента замера
+ * @param fd Сокет, соединенный с сервером
+ * @param ids Номера игр
+ * @param views Состояния игр
+ * @param games Количество игр
+ * @param reply Буфер ответа
+ * @return 0 при успехе, 1 при ошибке
+ */
+static int client_create(int fd, uint32_t *ids, GameView_t *views, int games,
+                         ProtoBuffer_t *reply) {
+  uint8_t request[PROTO_HEADER_SIZE + PROTO_CREATE_SIZE] = {0};
+  ProtoHeader_t header = {.size = sizeof(request), .type = PROTO_CREATE};
+  int status = 0;
+  proto_put_header(request, &header);
+  for (int i = 0; status == 0 && i < games; i++) {
+    size_t pos = PROTO_HEADER_SIZE + 6;
+    proto_put(request + PROTO_HEADER_SIZE, (uint64_t)i + 1, 8);
+    status = client_call(fd, request, sizeof(request), reply) ||
+             reply->data[5] != PROTO_OK;
+    if (status == 0) {
+      const uint8_t *body = reply->data + PROTO_HEADER_SIZE;
+      ids[i] = (uint32_t)proto_get(body, 4);
+      game_view_init(&views[i], body[4], body[5]);
+      status = game_view_apply(&views[i], reply->data, reply->len, &pos);
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Сравнивает задержки для qsort()
+ * @param a Первая задержка
+ * @param b Вторая задержка
+ * @return Знак разности
+ */
+static int compare_ns(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Клиент замера: играет случайными действиями и замеряет запросы
+ * @param options Параметры клиента
+ * @return 0 при успехе, 1 при ошибке соединения или протокола
+ * @details Шаги идут по играм по кругу, виртуальные часы каждой игры
+ * продвигаются на 16 мс за шаг. Начало и перезапуск игры выбираются по
+ * состоянию из дельт, поэтому дельты заодно проверяются на целостность.
+ */
+int run_client(const ServerOptions_t *options) {
+  static const int8_t actions[] = {-1, -1, Left, Right, Action, Down};
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  uint32_t *ids = calloc((size_t)options->games, sizeof(uint32_t));
+  GameView_t *views = calloc((size_t)options->games, sizeof(GameView_t));
+  uint64_t *round_ns = calloc((size_t)options->rounds, sizeof(uint64_t));
+  size_t size = PROTO_HEADER_SIZE + (size_t)options->batch * PROTO_STEP_SIZE;
+  uint8_t *request = malloc(size);
+  ProtoBuffer_t reply = {0};
+  ProtoHeader_t header = {.size = (uint32_t)size,
+                          .type = PROTO_STEP,
+                          .count = (uint16_t)options->batch};
+  Rng_t rng;
+  long next = 0;
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  strcpy(address.sun_path, options->path);
+  int status = ids == NULL || views == NULL || round_ns == NULL ||
+               request == NULL || fd < 0 ||
+               connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0;
+  if (status != 0) perror(options->path);
+  if (status == 0)
+    status = client_create(fd, ids, views, options->games, &reply);
+  rng_seed(&rng, 1);
+  proto_put_header(request, &header);
+  uint64_t started = fsm_stats_now();
+  for (int round = 0; status == 0 && round < options->rounds; round++) {
+    for (int i = 0; i < options->batch; i++) {
+      uint8_t *entry = request + PROTO_HEADER_SIZE + i * PROTO_STEP_SIZE;
+      const GameView_t *view = &views[(next + i) % options->games];
+      int8_t action = actions[rng_bounded(&rng, sizeof(actions))];
+      if (view->state == START || view->state == GAMEOVER) action = Start;
+      proto_put(entry, ids[(next + i) % options->games], 4);
+      proto_put(entry + 4, 16, 2);
+      entry[6] = (uint8_t)action;
+    }
+    uint64_t sent = fsm_stats_now();
+    status = client_call(fd, request, size, &reply) ||
+             reply.data[5] != PROTO_OK;
+    round_ns[round] = fsm_stats_now() - sent;
+    size_t pos = PROTO_HEADER_SIZE;
+    for (int i = 0; status == 0 && i < options->batch; i++) {
+      status = game_view_apply(&views[(next + i) % options->games],
+                               reply.data, reply.len, &pos);
+    }
+    next = (next + options->batch) % options->games;
+  }
+  double seconds = (fsm_stats_now() - started) / 1e9;
+  if (status == 0) {
+    long long steps = (long long)options->rounds * options->batch;
+    qsort(round_ns, (size_t)options->rounds, sizeof(uint64_t), compare_ns);
+    printf("games: %d, requests: %d, steps per request: %d\n",
+           options->games, options->rounds, options->batch);
+    printf("round trip: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           round_ns[options->rounds / 2] / 1e3,
+           round_ns[(long)options->rounds * 99 / 100] / 1e3,
+           round_ns[options->rounds - 1] / 1e3);
+    printf("steps/sec: %.0f\n", steps / seconds);
+  } else {
+    fprintf(stderr, "protocol error\n");
+  }
+  if (fd >= 0) close(fd);
+  proto_buffer_free(&reply);
+  free(request);
+  free(round_ns);
+  free(views);
+  free(ids);
+  return status;
+}
+
+/** @} */  // Конец группы server_module
@@ -0,0 +1,61 @@
+#ifndef TETRIS_SERVER_H
+#define TETRIS_SERVER_H
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "backend/fsm_stats.h"
+#include "backend/server.h"
+
+/// параметры сервера по умолчанию
+#define SERVER_SOCKET "/tmp/tetris_server.sock"  ///< путь сокета
+#define SERVER_EVENTS 256  ///< событий epoll за один вызов
+#define SERVER_READ 65536  ///< порция чтения из сокета
+/// параметры клиента замера задержки по умолчанию
+#define CLIENT_GAMES 1000    ///< игр клиента
+#define CLIENT_ROUNDS 20000  ///< запросов STEP
+#define CLIENT_BATCH 1       ///< шагов в одном запросе
+
+/**
+ * @struct ServerOptions_t
+ * @brief Параметры запуска сервера или клиента замера
+ */
+typedef struct {
+  const char *path;    ///< Путь Unix-сокета
+  uint32_t max_games;  ///< Предел игр сервера
+  int client;  ///< Запустить клиент замера вместо сервера
+  int games;   ///< Игр клиента
+  int rounds;  ///< Запросов STEP клиента
+  int batch;   ///< Шагов в одном запросе клиента
+} ServerOptions_t;
+
+/**
+ * @struct Connection_t
+ * @brief Соединение с клиентом
+ */
+typedef struct {
+  int fd;  ///< Сокет клиента
+  ProtoBuffer_t in;  ///< Принятые, но не разобранные данные
+  ProtoBuffer_t out;  ///< Ответы, еще не отправленные клиенту
+  size_t sent;  ///< Отправлено байт из out
+  uint32_t events;  ///< События, на которые подписан сокет
+} Connection_t;
+
+int parse_server_options(int argc, char *argv[], ServerOptions_t *options);
+int run_server(const ServerOptions_t *options);
+int connection_read(GameServer_t *server, Connection_t *connection);
+int connection_flush(Connection_t *connection);
+void connection_close(GameServer_t *server, int epoll,
+                      Connection_t *connection);
+int run_client(const ServerOptions_t *options);
+int client_call(int fd, const uint8_t *request, size_t size,
+                ProtoBuffer_t *reply);
+
+#endif  // TETRIS_SERVER_H
@@ -0,0 +1,200 @@
+/**
+ * @file tetris_sim.c
+ * @brief Безголовый симулятор игры Tetris
+ * @defgroup sim_module Simulation Module
+ * @{
+ * @details Ведет конечный автомат игры без терминала на виртуальных часах:
+ * гравитация срабатывает по времени игры, а не по системному времени,
+ * поэтому игры идут с полной скоростью процессора. Ввод берется из
+ * сценария или генерируется случайно.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_sim.h"
+
+/**
+ * @brief Точка входа симулятора
+ * @return 0 при успешном завершении, 1 при ошибке в параметрах
+ * @details Параметры: -g игры, -s seed, -t шаг часов (мс),
+ * -m предел шагов на игру, -b выдача фигур семерками, -S сценарий из
+ * символов L R D A . (влево, вправо, сброс, поворот, ожидание), повторяемый
+ * по кругу, -a играет автоигрок, -j потоков поиска автоигрока, -P файл
+ * проигрывает запись игры с полной скоростью вместо симуляции, -C файл
+ * записывает все игры в корпус, -K фигур между ключевыми кадрами корпуса.
+ * В сборке с TETRIS_STATS после итогов печатает статистику автомата.
+ */
+int main(int argc, char *argv[]) {
+  SimOptions_t options;
+  SimResult_t result;
+  int status = parse_sim_options(argc, argv, &options);
+  if (status == 0 && options.replay != NULL) {
+    status = play_replay_file(options.replay);
+  } else if (status == 0) {
+    status = run_simulation(&options, &result);
+    printf("games: %d\n", options.games);
+    printf("steps: %lld\n", result.steps);
+    printf("avg score: %.1f\n", (double)result.score / options.games);
+    printf("avg lines: %.1f\n", (double)result.lines / options.games);
+    printf("avg pieces: %.1f\n", (double)result.pieces / options.games);
+    printf("time: %.3f s\n", result.seconds);
+    printf("games/sec: %.1f\n", options.games / result.seconds);
+    printf("steps/sec: %.0f\n", result.steps / result.seconds);
+    FSM_STATS_DUMP(NULL);
+  }
+  return status;
+}
+
+/**
+ * @brief Разбирает параметры командной строки
+ * @param argc Количество аргументов
+ * @param argv Аргументы
+ * @param[out] options Заполняемые параметры симуляции
+ * @return 0 при успехе, 1 при ошибке
+ */
+int parse_sim_options(int argc, char *argv[], SimOptions_t *options) {
+  int status = 0;
+  int opt;
+  options->games = SIM_GAMES;
+  options->seed = (uint64_t)time(NULL);
+  options->randomizer = RANDOMIZER_UNIFORM;
+  options->height = 0;
+  options->width = 0;
+  options->tick_ms = SIM_TICK_MS;
+  options->max_steps = SIM_MAX_STEPS;
+  options->script = NULL;
+  options->ai = 0;
+  options->ai_threads = 1;
+  options->replay = NULL;
+  options->corpus = NULL;
+  options->keyframe_pieces = CORPUS_KEYFRAME_PIECES;
+  while (status == 0 &&
+         (opt = getopt(argc, argv, "g:s:t:m:bH:W:S:aj:P:C:K:")) != -1) {
+    switch (opt) {
+      case 'g':
+        options->games = atoi(optarg);
+        break;
+      case 's':
+        options->seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'b':
+        options->randomizer = RANDOMIZER_BAG;
+        break;
+      case 'H':
+        options->height = atoi(optarg);
+        break;
+      case 'W':
+        options->width = atoi(optarg);
+        break;
+      case 't':
+        options->tick_ms = atoi(optarg);
+        break;
+      case 'm':
+        options->max_steps = atol(optarg);
+        break;
+      case 'S':
+        options->script = optarg;
+        break;
+      case 'a':
+        options->ai = 1;
+        break;
+      case 'j':
+        options->ai_threads = atoi(optarg);
+        break;
+      case 'P':
+        options->replay = optarg;
+        break;
+      case 'C':
+        options->corpus = optarg;
+        break;
+      case 'K':
+        options->keyframe_pieces = atoi(optarg);
+        break;
+      default:
+        status = 1;
+        break;
+    }
+  }
+  if (options->games <= 0 || options->tick_ms <= 0 ||
+      options->ai_threads <= 0 || options->keyframe_pieces < 0 ||
+      !tetris_size_valid(options->height, options->width) ||
+      (options->script != NULL && options->script[0] == '\0'))
+    status = 1;
+  if (status != 0)
+    fprintf(stderr,
+            "usage: %s [-g games] [-s seed] [-t tick_ms] [-m max_steps] [-b] "
+            "[-H height] [-W width] [-S script] [-a] [-j ai_threads] "
+            "[-P replay] [-C corpus] [-K keyframe_pieces]\n",
+            argv[0]);
+  return status;
+}
+
+/**
+ * @brief Проводит все игры симуляции и замеряет время
+ * @param options Параметры симуляции
+ * @param[out] result Итоги симуляции
+ * @return 0 при успехе, 1 - корпус не записан
+ * @details С options->corpus каждая игра записывается в буфер в памяти и
+ * добавляется в корпус; время построения корпуса входит в замер
+ */
+int run_simulation(const SimOptions_t *options, SimResult_t *result) {
+  AiConfig_t ai_config = {.threads = options->ai_threads};
+  AiPlayer_t *ai = options->ai ? ai_create(&ai_config) : NULL;
+  CorpusWriter_t *corpus = NULL;
+  ReplayBuffer_t replay = {0};
+  int status = 0;
+  if (options->corpus != NULL) {
+    corpus = corpus_writer_open(options->corpus, options->keyframe_pieces);
+    if (corpus == NULL) status = 1;
+  }
+  double start = monotonic_seconds();
+  result->steps = 0;
+  result->score = 0;
+  result->lines = 0;
+  result->pieces = 0;
+  for (int i = 0; status == 0 && i < options->games; i++) {
+    SimGame_t game;
+    sim_game(options, ai, options->seed + (uint64_t)i, &game,
+             corpus != NULL ? &replay : NULL);
+    if (corpus != NULL) status = corpus_add(corpus, replay.data, replay.len);
+    result->steps += game.steps;
+    result->score += game.score;
+    result->lines += game.lines;
+    result->pieces += game.pieces;
+  }
+  if (corpus_writer_close(corpus) != 0) status = 1;
+  result->seconds = monotonic_seconds() - start;
+  if (status != 0) fprintf(stderr, "%s: corpus not written\n", options->corpus);
+  replay_buffer_free(&replay);
+  ai_destroy(ai);
+  return status;
+}
+
+/**
+ * @brief Проигрывает файл записи с полной скоростью и печатает итоги
+ * @param path Файл записи
+ * @return 0 при успехе, 1 - файл не прочитан или не является записью
+ */
+int play_replay_file(const char *path) {
+  size_t size = 0;
+  uint8_t *data = replay_load(path, &size);
+  double start = monotonic_seconds();
+  GameInfo_t *game = replay_play(data, size);
+  double seconds = monotonic_seconds() - start;
+  int status = game == NULL;
+  if (game != NULL) {
+    printf("bytes: %zu\n", size);
+    printf("score: %d\n", game->score);
+    printf("lines: %d\n", game->lines);
+    printf("level: %d\n", game->level);
+    printf("pieces: %d\n", game->pieces);
+    printf("time: %.6f s\n", seconds);
+  } else {
+    fprintf(stderr, "%s: not a replay file\n", path);
+  }
+  tetris_destroy(game);
+  free(data);
+  return status;
+}
+
+/** @} */  // Конец группы sim_module
@@ -0,0 +1,74 @@
+#ifndef TETRIS_SIM_H
+#define TETRIS_SIM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend/ai.h"
+#include "backend/corpus.h"
+#include "backend/backend_tetris.h"
+#include "backend/figures.h"
+#include "backend/fsm_stats.h"
+#include "backend/replay.h"
+
+/// параметры симуляции по умолчанию
+#define SIM_GAMES 1000  ///< количество игр
+#define SIM_TICK_MS 50  ///< шаг виртуальных часов на шаг автомата
+#define SIM_MAX_STEPS 1000000  ///< предел шагов автомата на одну игру
+
+/**
+ * @struct SimOptions_t
+ * @brief Параметры запуска симулятора
+ */
+typedef struct {
+  int games;  ///< Количество игр
+  uint64_t seed;  ///< Начальное значение генераторов
+  int randomizer;  ///< Способ выбора фигур (RANDOMIZER_UNIFORM, ...)
+  int height;   ///< Высота поля (0 - HEIGHT)
+  int width;    ///< Ширина поля (0 - WIDTH)
+  int tick_ms;  ///< Шаг виртуальных часов (мс)
+  long max_steps;  ///< Предел шагов автомата на одну игру
+  const char *script;  ///< Сценарий ввода (NULL - случайный ввод)
+  int ai;              ///< Играет автоигрок
+  int ai_threads;      ///< Потоков поиска автоигрока
+  const char *replay;  ///< Файл записи для проигрывания (NULL - симуляция)
+  const char *corpus;  ///< Корпус для записи всех игр (NULL - не писать)
+  int keyframe_pieces;  ///< Фигур между ключевыми кадрами корпуса
+} SimOptions_t;
+
+/**
+ * @struct SimGame_t
+ * @brief Итоги одной игры
+ */
+typedef struct {
+  long long steps;  ///< Выполнено шагов автомата
+  int score;        ///< Итоговый счет
+  int lines;        ///< Удалено линий
+  int level;        ///< Достигнутый уровень
+  int pieces;       ///< Выпущено фигур
+} SimGame_t;
+
+/**
+ * @struct SimResult_t
+ * @brief Итоги симуляции
+ */
+typedef struct {
+  long long steps;  ///< Выполнено шагов автомата
+  long long score;  ///< Сумма очков по всем играм
+  long long lines;  ///< Сумма удаленных линий по всем играм
+  long long pieces;  ///< Сумма выпущенных фигур по всем играм
+  double seconds;  ///< Затраченное время
+} SimResult_t;
+
+int parse_sim_options(int argc, char *argv[], SimOptions_t *options);
+UserAction_t sim_action(const SimOptions_t *options, Rng_t *rng, long step);
+void sim_game(const SimOptions_t *options, AiPlayer_t *ai, uint64_t seed,
+              SimGame_t *result, ReplayBuffer_t *replay);
+int run_simulation(const SimOptions_t *options, SimResult_t *result);
+int play_replay_file(const char *path);
+double monotonic_seconds();
+
+#endif  // TETRIS_SIM_H
@@ -7,6 +7,9 @@
 
 #include "frontend_tetris.h"
 
+/// последний выведенный кадр (отрисовка выводит только отличия от него)
+static ScreenCache_t screen = {.mode = SCREEN_NONE};
+
 /**
  * @brief Инициализация библиотеки ncurses
  */
@@ -16,48 +19,92 @@ void init_ncurses() {
   noecho();     // не отображать символы на экране
   curs_set(0);  // курсор невидимый
   keypad(stdscr, TRUE);  // обрабатывать специальные клавиши
-  srand(time(NULL));  // инициализация генератора случайных чисел для фигур
   nodelay(stdscr, TRUE);  // включает неблокирующий ввод — getch() не ждёт ввода
   init_colors();
 }
 
+/**
+ * @brief Сбрасывает последний выведенный кадр
+ * @details Следующий вызов print_game_screen() очистит экран и нарисует его
+ * целиком (например, после изменения размера терминала)
+ */
+void invalidate_screen() { screen.mode = SCREEN_NONE; }
+
+/**
+ * @brief Определяет режим экрана для состояния игры
+ * @param state Состояние конечного автомата
+ * @return Режим экрана (SCREEN_START, SCREEN_GAME или SCREEN_GAMEOVER)
+ */
+int screen_mode(GameState_t state) {
+  int mode = SCREEN_GAME;
+  if (state == START)
+    mode = SCREEN_START;
+  else if (state == GAMEOVER)
+    mode = SCREEN_GAMEOVER;
+  return mode;
+}
+
 /**
  * @brief Основная функция отрисовки игрового экрана
- * @param game Текущее состояние игры
+ * @param game Текущее состояние игры (только для чтения)
+ * @details Неизменная часть экрана рисуется один раз при смене режима или
+ * размеров поля, дальше выводятся только изменившиеся клетки и строки
+ * статистики.
+ * Отрисовка не копирует состояние и не изменяет его, поэтому ее можно
+ * вести из отдельного потока по снимку состояния, пока автомат не пишет в
+ * этот снимок.
  */
-void print_game_screen(GameInfo_t game) {
+void print_game_screen(const GameInfo_t *game) {
+  int mode = screen_mode(game->state);
+  if (mode != screen.mode || game->height != screen.height ||
+      game->width != screen.width) {
+    print_screen_chrome(mode, game->height, game->width);
+    if (mode == SCREEN_GAMEOVER) print_game_over(game);
+  }
+  if (mode == SCREEN_GAME) {
+    print_field(game);
+    print_statistic(game);
+    print_pause(game->state == PAUSE);
+  } else if (mode == SCREEN_GAMEOVER) {
+    print_field(game);
+  }
+}
+
+/**
+ * @brief Отрисовка неизменной части экрана для режима
+ * @param mode Режим экрана (SCREEN_*)
+ * @param height Высота поля
+ * @param width Ширина поля
+ * @details Очищает экран, рисует рамки и подписи и помечает все клетки и
+ * значения статистики как невыведенные
+ */
+void print_screen_chrome(int mode, int height, int width) {
+  screen.height = height;
+  screen.width = width;
+  erase();
   print_outer_frame();
-  switch (game.state) {
-    case START:
-      print_start_screen();
-      break;
-    case PAUSE:
-      print_playing_field_frame();
-      print_pause();
-      print_field(game);
-      print_statistic(game);
-      print_figure(game.current);
-      break;
-    case GAMEOVER:
-      print_playing_field_frame();
-      print_field(game);
-      print_figure(game.current);
-      print_game_over(game);
-      break;
-    default:
-      print_playing_field_frame();
-      print_field(game);
-      print_statistic(game);
-      print_figure(game.current);
-      break;
+  if (mode == SCREEN_START) {
+    print_start_screen();
+  } else {
+    print_playing_field_frame();
+    if (mode == SCREEN_GAME) print_controls();
   }
+  memset(screen.cells, -1, sizeof(screen.cells));
+  screen.score = -1;
+  screen.high_score = -1;
+  screen.level = -1;
+  screen.next_id = -1;
+  screen.paused = 0;
+  screen.mode = mode;
 }
 
 /**
  * @brief Отрисовка рамки игрового поля
+ * @details Размеры поля берутся из последнего кадра (print_screen_chrome())
  */
 void print_playing_field_frame() {
-  print_box(1, F_Y_START + HEIGHT, 2, F_X_START + WIDTH * CELL_SIZE);
+  print_box(1, F_Y_START + screen.height, 2,
+            F_X_START + screen.width * CELL_SIZE);
 }
 
 /**
@@ -65,8 +112,7 @@ void print_playing_field_frame() {
  * @details Создает большую рамку вокруг всего игрового интерфейса
  */
 void print_outer_frame() {
-  print_box(0, F_Y_START + HEIGHT + 1, 0,
-            F_X_START + (WIDTH * CELL_SIZE) * 2 + 6);
+  print_box(0, SCREEN_BOTTOM(screen.height), 0, SCREEN_RIGHT(screen.width));
 }
 
 /**
@@ -91,7 +137,9 @@ void print_box(int top_y, int bottom_y, int left_x, int right_x) {
  * @brief Отрисовка стартового экрана
  */
 void print_start_screen() {
-  int x_offset = ((F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) - 45) / 2 + 1;
+  int right = SCREEN_RIGHT(screen.width);
+  int bottom = SCREEN_BOTTOM(screen.height);
+  int x_offset = (right - 45) / 2 + 1;
   attron(COLOR_PAIR(BLUE_P) | A_BOLD);
   mvprintw(8, x_offset, " _______ ______ _______ _____  _____  _____ ");
   mvprintw(9, x_offset, "|__   __|  ____|__   __|  __ \\|_   _|/ ____|");
@@ -101,112 +149,155 @@ void print_start_screen() {
   mvprintw(13, x_offset, "   |_|  |______|  |_|  |_|  \\_\\_____|_____/ ");
   attroff(COLOR_PAIR(BLUE_P) | A_BOLD);
   attron(A_BLINK);
-  mvprintw(HEIGHT, (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 2 - 9,
-           "ENTER - start game");
-  mvprintw(HEIGHT + 1, (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 2 - 9,
-           "    q - exit");
+  mvprintw(bottom - 3, right / 2 - 9, "ENTER - start game");
+  mvprintw(bottom - 2, right / 2 - 9, "    q - exit");
   attroff(A_BLINK);
 }
 
+/**
+ * @brief Отрисовка одной клетки
+ * @param y Строка экрана
+ * @param x Колонка экрана
+ * @param color Цвет клетки (0 - пустая клетка)
+ */
+void print_cell(int y, int x, int color) {
+  if (color != 0) {
+    attron(COLOR_PAIR(color));
+    mvaddstr(y, x, CELL);
+    attroff(COLOR_PAIR(color));
+  } else {
+    mvaddstr(y, x, EMPTY_CELL);
+  }
+}
+
 /**
  * @brief Отрисовка игрового поля
+ * @details Собирает кадр из поля и текущей фигуры и выводит только клетки,
+ * отличающиеся от последнего выведенного кадра
  */
-void print_field(GameInfo_t game) {
-  for (int i = 0; i < HEIGHT; i++) {
-    for (int j = 0; j < WIDTH; j++) {
-      if (game.field[i][j] != 0) {
-        attron(COLOR_PAIR(game.field[i][j]));
-        mvprintw(F_Y_START + i, F_X_START + j * CELL_SIZE, CELL);
-        attroff(COLOR_PAIR(game.field[i][j]));
+void print_field(const GameInfo_t *game) {
+  int frame[HEIGHT_MAX][WIDTH_MAX];
+  for (int i = 0; i < game->height; i++) {
+    for (int j = 0; j < game->width; j++)
+      frame[i][j] = field_color(game, i, j);
+  }
+  print_figure(frame, &game->current, game->height);
+  for (int i = 0; i < game->height; i++) {
+    for (int j = 0; j < game->width; j++) {
+      if (frame[i][j] != screen.cells[i][j]) {
+        print_cell(F_Y_START + i, F_X_START + j * CELL_SIZE, frame[i][j]);
+        screen.cells[i][j] = frame[i][j];
       }
     }
   }
 }
 
 /**
- * @brief Отрисовка текущей фигуры
+ * @brief Добавление текущей фигуры в кадр поля
+ * @param frame Кадр поля (цвета клеток)
  * @param figure Текущая активная фигура
- * @details Отображает фигуру с учетом ее текущей позиции
- * и не отображает части фигуры, находящиеся за верхней границей поля
- */
-void print_figure(Tetramino figure) {
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
-      if (figure.view[i][j] != 0 && figure.y + i >= 0) {
-        attron(COLOR_PAIR(figure.view[i][j]));
-        mvprintw(F_Y_START + figure.y + i,
-                 F_X_START + figure.x * CELL_SIZE + j * CELL_SIZE, CELL);
-        attroff(COLOR_PAIR(figure.view[i][j]));
-      }
+ * @param height Высота поля
+ * @details Учитывает текущую позицию фигуры и пропускает части фигуры,
+ * находящиеся за верхней границей поля
+ */
+void print_figure(int frame[HEIGHT_MAX][WIDTH_MAX], const Tetramino *figure,
+                  int height) {
+  const FigureShape *shape = figure_shape(figure);
+  int color = figure_info(figure->id)->color;
+  for (int i = shape->top; i <= shape->bottom; i++) {
+    int y = figure->y + i;
+    for (int j = shape->left; j <= shape->right; j++) {
+      if ((shape->mask[i] & (1u << j)) && y >= 0 && y < height)
+        frame[y][figure->x + j] = color;
     }
   }
 }
 
 /**
  * @brief Отрисовка следующей фигуры
+ * @details Перерисовывается только при смене фигуры: область 4x4
+ * очищается и фигура выводится заново
  */
-void print_next_figure(Tetramino figure, int y, int x) {
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
-      if (figure.view[i][j] != 0) {
-        attron(COLOR_PAIR(figure.view[i][j]));
-        mvprintw(y + i, x + j * CELL_SIZE, CELL);
-        attroff(COLOR_PAIR(figure.view[i][j]));
-      }
+void print_next_figure(const Tetramino *figure, int y, int x) {
+  if (figure->id != screen.next_id) {
+    const FigureShape *shape = figure_shape(figure);
+    int color = figure_info(figure->id)->color;
+    for (int i = 0; i < 4; i++) {
+      for (int j = 0; j < 4; j++)
+        print_cell(y + i, x + j * CELL_SIZE,
+                   (shape->mask[i] & (1u << j)) ? color : 0);
     }
+    screen.next_id = figure->id;
+  }
+}
+
+/**
+ * @brief Отрисовка игровой статистики
+ * @details Выводит только изменившиеся значения
+ */
+void print_statistic(const GameInfo_t *game) {
+  int panel = PANEL_X(screen.width);
+  if (game->score != screen.score) {
+    mvprintw(F_Y_START, panel, "SCORE: %-8d", game->score);
+    screen.score = game->score;
+  }
+  if (game->high_score != screen.high_score) {
+    mvprintw(F_Y_START + 2, panel, "HIGH SCORE: %-8d", game->high_score);
+    screen.high_score = game->high_score;
   }
+  if (game->level != screen.level) {
+    mvprintw(F_Y_START + 4, panel, "LEVEL: %-3d", game->level);
+    screen.level = game->level;
+  }
+  print_next_figure(&game->next, F_Y_START + 8, panel);
 }
 
 /**
- * @brief Отрисовка игровой статистики и клавиши управления
+ * @brief Отрисовка подписей и клавиш управления
  */
-void print_statistic(GameInfo_t game) {
-  mvprintw(F_Y_START, F_X_START + WIDTH * CELL_SIZE + 3, "SCORE: %d",
-           game.score);
-  mvprintw(F_Y_START + 2, F_X_START + WIDTH * CELL_SIZE + 3, "HIGH SCORE: %d",
-           game.high_score);
-  mvprintw(F_Y_START + 4, F_X_START + WIDTH * CELL_SIZE + 3, "LEVEL: %d",
-           game.level);
-  mvprintw(F_Y_START + 6, F_X_START + WIDTH * CELL_SIZE + 3, "NEXT:");
-  print_next_figure(game.next, F_Y_START + 8,
-                    F_X_START + WIDTH * CELL_SIZE + 3);
-  mvprintw(F_Y_START + 15, F_X_START + WIDTH * CELL_SIZE + 3, "<   >  -  move");
-  mvprintw(F_Y_START + 16, F_X_START + WIDTH * CELL_SIZE + 3, "  V    -  drop");
-  mvprintw(F_Y_START + 17, F_X_START + WIDTH * CELL_SIZE + 3,
-           "SPACE  -  rotate");
-  mvprintw(F_Y_START + 18, F_X_START + WIDTH * CELL_SIZE + 3,
-           "  p    -  pause");
-  mvprintw(F_Y_START + 19, F_X_START + WIDTH * CELL_SIZE + 3, "  q    -  exit");
+void print_controls() {
+  int panel = PANEL_X(screen.width);
+  mvprintw(F_Y_START + 6, panel, "NEXT:");
+  mvprintw(F_Y_START + 15, panel, "<   >  -  move");
+  mvprintw(F_Y_START + 16, panel, "  V    -  drop");
+  mvprintw(F_Y_START + 17, panel, "SPACE  -  rotate");
+  mvprintw(F_Y_START + 18, panel, "  p    -  pause");
+  mvprintw(F_Y_START + 19, panel, "  q    -  exit");
+  mvprintw(F_Y_START + 20, panel, "  a    -  autoplay");
 }
 
 /**
- * @brief Отрисовка экрана паузы
+ * @brief Отрисовка надписи паузы
+ * @param paused Показать (1) или стереть (0) надпись
  */
-void print_pause() {
-  attron(COLOR_PAIR(RED_P));
-  mvprintw(F_Y_START + 12, F_X_START + WIDTH * CELL_SIZE + 3, "PAUSE");
-  attroff(COLOR_PAIR(RED_P));
+void print_pause(int paused) {
+  int panel = PANEL_X(screen.width);
+  if (paused != screen.paused) {
+    attron(COLOR_PAIR(RED_P));
+    mvprintw(F_Y_START + 12, panel, paused ? "PAUSE" : "     ");
+    attroff(COLOR_PAIR(RED_P));
+    screen.paused = paused;
+  }
 }
 
 /**
  * @brief Отрисовка экрана завершения игры
  */
-void print_game_over(GameInfo_t game) {
-  mvprintw(F_Y_START, F_X_START + WIDTH * CELL_SIZE + 3, "SCORE: %d",
-           game.score);
-  mvprintw(F_Y_START + 2, F_X_START + WIDTH * CELL_SIZE + 3, "HIGH SCORE: %d",
-           game.high_score);
+void print_game_over(const GameInfo_t *game) {
+  int panel = PANEL_X(screen.width);
+  mvprintw(F_Y_START, panel, "SCORE: %d", game->score);
+  mvprintw(F_Y_START + 2, panel, "HIGH SCORE: %d", game->high_score);
   attron(COLOR_PAIR(RED_P));
-  mvprintw(6, F_X_START + WIDTH * CELL_SIZE + 3, "[ GAME OVER ]");
+  mvprintw(6, panel, "[ GAME OVER ]");
   attroff(COLOR_PAIR(RED_P));
   attron(COLOR_PAIR(ORANGE_P));
-  mvprintw(8, F_X_START + WIDTH * CELL_SIZE + 3, "BETTER LUCK NEXT TIME!");
+  mvprintw(8, panel, "BETTER LUCK NEXT TIME!");
   attroff(COLOR_PAIR(ORANGE_P));
   attron(COLOR_PAIR(GREEN_P));
-  mvprintw(10, F_X_START + WIDTH * CELL_SIZE + 3, "TRY AGAIN?");
+  mvprintw(10, panel, "TRY AGAIN?");
   attroff(COLOR_PAIR(GREEN_P));
-  mvprintw(12, F_X_START + WIDTH * CELL_SIZE + 3, "ENTER  -  YES");
-  mvprintw(13, F_X_START + WIDTH * CELL_SIZE + 3, "  q    -  NO");
+  mvprintw(12, panel, "ENTER  -  YES");
+  mvprintw(13, panel, "  q    -  NO");
 }
 
 /**
@@ -227,4 +318,4 @@ void init_colors() {
   init_pair(VIOLET_P, COLOR_VIOLET, COLOR_BLACK);
 }
 
-/** @} */  // Конец группы frontend_module
\ No newline at end of file
+/** @} */  // Конец группы frontend_module
@@ -10,9 +10,23 @@
 #define F_Y_START 2
 #define F_X_START 3
 
-// вид и длина клетки фигурки
+// вид и длина клетки фигурки (длина вычисляется при компиляции)
 #define CELL "[]"
-#define CELL_SIZE strlen(CELL)
+#define EMPTY_CELL "  "
+#define CELL_SIZE ((int)sizeof(CELL) - 1)
+
+// начальная колонка панели статистики справа от поля ширины w
+#define PANEL_X(w) (F_X_START + (w) * CELL_SIZE + 3)
+// правая колонка экрана для поля ширины w (панель не уже поля WIDTH)
+#define SCREEN_RIGHT(w) (PANEL_X(w) + WIDTH * CELL_SIZE + 3)
+// нижняя строка экрана для поля высоты h (экран не ниже поля HEIGHT)
+#define SCREEN_BOTTOM(h) (F_Y_START + ((h) > HEIGHT ? (h) : HEIGHT) + 1)
+
+// режимы экрана: у каждого своя неизменная часть (рамки, подписи)
+#define SCREEN_NONE (-1)
+#define SCREEN_START 0
+#define SCREEN_GAME 1
+#define SCREEN_GAMEOVER 2
 
 // индексы кастомных цветов
 #define COLOR_ORANGE 8
@@ -29,22 +43,47 @@
 #define VIOLET_P 10
 #define MAGENTA_P 11
 
+/**
+ * @struct ScreenCache_t
+ * @brief Последний выведенный на экран кадр
+ * @details Отрисовка сравнивает новое состояние игры с этим кадром и выводит
+ * только изменившиеся клетки и строки статистики; -1 означает, что значение
+ * на экране неизвестно и должно быть нарисовано заново
+ */
+typedef struct {
+  int mode;  ///< Режим экрана (SCREEN_*)
+  int height;  ///< Высота поля, для которой нарисован экран
+  int width;  ///< Ширина поля, для которой нарисован экран
+  int cells[HEIGHT_MAX][WIDTH_MAX];  ///< Цвета клеток поля с текущей фигурой
+  int score;       ///< Выведенный счет
+  int high_score;  ///< Выведенный рекорд
+  int level;       ///< Выведенный уровень
+  int next_id;     ///< Выведенная следующая фигура
+  int paused;      ///< Выведена ли надпись паузы
+} ScreenCache_t;
+
 void init_ncurses();
 void init_colors();
+void invalidate_screen();
+int screen_mode(GameState_t state);
+void print_screen_chrome(int mode, int height, int width);
+void print_controls();
 
 void print_outer_frame();
 void print_playing_field_frame();
 void print_box(int top_y, int bottom_y, int left_x, int right_x);
 
-void print_field(GameInfo_t game);
-void print_figure(Tetramino figure);
-void print_next_figure(Tetramino figure, int y, int x);
+void print_cell(int y, int x, int color);
+void print_field(const GameInfo_t *game);
+void print_figure(int frame[HEIGHT_MAX][WIDTH_MAX], const Tetramino *figure,
+                  int height);
+void print_next_figure(const Tetramino *figure, int y, int x);
 
-void print_statistic(GameInfo_t game);
+void print_statistic(const GameInfo_t *game);
 
-void print_game_screen(GameInfo_t game);
+void print_game_screen(const GameInfo_t *game);
 void print_start_screen();
-void print_pause();
-void print_game_over(GameInfo_t game);
+void print_pause(int paused);
+void print_game_over(const GameInfo_t *game);
 
 #endif  // FRONTEND_TETRIS_H
@@ -16,29 +16,24 @@ START_TEST(stats_test) {
   game_init(game);
   for (int i = 0; i < HEIGHT; i++) {
     for (int j = 0; j < WIDTH; j++) {
-      ck_assert_int_eq(game->field[i][j], 0);
+      ck_assert_int_eq(field_color(game, i, j), 0);
     }
   }
-  ck_assert_int_eq(game->next.type != 0, 1);
-  ck_assert_int_eq(game->next.cols != 0, 1);
-  ck_assert_int_eq(game->next.rows != 0, 1);
+  ck_assert_int_eq(figure_info(game->next.id)->type != 0, 1);
+  ck_assert_int_eq(figure_shape(&game->next)->cols != 0, 1);
+  ck_assert_int_eq(figure_shape(&game->next)->rows != 0, 1);
   ck_assert_int_eq(game->state, START);
   ck_assert_int_eq(game->score, 0);
   ck_assert_int_eq(game->level, 1);
-  ck_assert_int_eq(game->pause, 0);
-
-  save_max_score(50000);
-  ck_assert_int_eq(load_max_score(), 50000);
-  save_max_score(0);
 
   for (int i = 19; i > 15; i--) {
     for (int j = 0; j < WIDTH; j++) {
-      game->field[i][j] = 1;
+      set_field_cell(game, i, j, 1);
     }
   }
-  calculate_score();
+  calculate_score(game);
   ck_assert_int_eq(game->score, 1500);
-  update_level();
+  update_level(game);
   ck_assert_int_eq(game->level, 3);
 }
 END_TEST
@@ -55,9 +50,9 @@ START_TEST(score_case_1_line) {
   GameInfo_t *game = updateCurrentState();
   game_init(game);
   for (int j = 0; j < WIDTH; j++) {
-    game->field[19][j] = 1;
+    set_field_cell(game, 19, j, 1);
   }
-  calculate_score();
+  calculate_score(game);
   ck_assert_int_eq(game->score, 100);
 }
 END_TEST
@@ -67,10 +62,10 @@ START_TEST(score_case_2_lines) {
   game_init(game);
   for (int i = 18; i < 20; i++) {
     for (int j = 0; j < WIDTH; j++) {
-      game->field[i][j] = 1;
+      set_field_cell(game, i, j, 1);
     }
   }
-  calculate_score();
+  calculate_score(game);
   ck_assert_int_eq(game->score, 300);
 }
 END_TEST
@@ -80,10 +75,10 @@ START_TEST(score_case_3_lines) {
   game_init(game);
   for (int i = 17; i < 20; i++) {
     for (int j = 0; j < WIDTH; j++) {
-      game->field[i][j] = 1;
+      set_field_cell(game, i, j, 1);
     }
   }
-  calculate_score();
+  calculate_score(game);
   ck_assert_int_eq(game->score, 700);
 }
 END_TEST
@@ -94,14 +89,38 @@ START_TEST(score_high_score_update) {
   game->high_score = 500;
   for (int i = 16; i < 20; i++) {
     for (int j = 0; j < WIDTH; j++) {
-      game->field[i][j] = 1;
+      set_field_cell(game, i, j, 1);
     }
   }
-  calculate_score();
+  calculate_score(game);
   ck_assert_int_eq(game->high_score, 1500);
 }
 END_TEST
 
+START_TEST(score_split_lines) {
+  GameInfo_t *game = updateCurrentState();
+  game_init(game);
+  for (int j = 0; j < WIDTH; j++) {
+    set_field_cell(game, 19, j, 1);
+    set_field_cell(game, 17, j, 1);
+  }
+  set_field_cell(game, 18, 3, COLOR_GREEN);
+  set_field_cell(game, 16, 7, COLOR_BLUE);
+  calculate_score(game);
+  ck_assert_int_eq(game->score, 300);
+  ck_assert_int_eq(game->lines, 2);
+  ck_assert_int_eq(game->cleared_rows, (1u << 19) | (1u << 17));
+  ck_assert_int_eq(field_color(game, 19, 3), COLOR_GREEN);
+  ck_assert_int_eq(field_color(game, 18, 7), COLOR_BLUE);
+  ck_assert_int_eq(game->rows[BOARD_TOP + 19],
+                   ROW_EMPTY | (1 << (BOARD_WALL + 3)));
+  ck_assert_int_eq(game->rows[BOARD_TOP + 17], ROW_EMPTY);
+  ck_assert_int_eq(game->heights[7], 2);
+  ck_assert_int_eq(clear_lines(game), 0);
+  reset_field(game);
+}
+END_TEST
+
 Suite *score_test_suite(void) {
   Suite *s = suite_create("score_test");
   TCase *tc = tcase_create("score_test");
@@ -109,6 +128,7 @@ Suite *score_test_suite(void) {
   tcase_add_test(tc, score_case_2_lines);
   tcase_add_test(tc, score_case_3_lines);
   tcase_add_test(tc, score_high_score_update);
+  tcase_add_test(tc, score_split_lines);
   suite_add_tcase(s, tc);
   return s;
 }
@@ -135,11 +155,51 @@ Suite *user_action_test_suite(void) {
 START_TEST(generate_figure_test) {
   GameInfo_t *game = updateCurrentState();
   for (int i = 0; i < 8; i++) {
-    generate_figure(&game->next);
-    ck_assert_int_ne(game->next.type, 0);
-    ck_assert_int_ne(game->next.cols, 0);
-    ck_assert_int_ne(game->next.rows, 0);
+    generate_figure(game, &game->next);
+    ck_assert_int_ne(figure_info(game->next.id)->type, 0);
+    ck_assert_int_ne(figure_shape(&game->next)->cols, 0);
+    ck_assert_int_ne(figure_shape(&game->next)->rows, 0);
+  }
+}
+END_TEST
+
+START_TEST(seeded_sequence_test) {
+  TetrisConfig_t config = {.flags = GAME_NO_PERSIST, .seed = 42};
+  GameInfo_t *first = tetris_create(&config);
+  GameInfo_t *second = tetris_create(&config);
+  config.seed = 43;
+  GameInfo_t *other = tetris_create(&config);
+  int differs = 0;
+  for (int i = 0; i < 64; i++) {
+    generate_figure(first, &first->next);
+    generate_figure(second, &second->next);
+    generate_figure(other, &other->next);
+    ck_assert_int_eq(first->next.id, second->next.id);
+    if (first->next.id != other->next.id) differs = 1;
+  }
+  ck_assert_int_eq(differs, 1);
+  tetris_destroy(first);
+  tetris_destroy(second);
+  tetris_destroy(other);
+}
+END_TEST
+
+START_TEST(bag_randomizer_test) {
+  TetrisConfig_t config = {
+      .flags = GAME_NO_PERSIST, .seed = 7, .randomizer = RANDOMIZER_BAG};
+  GameInfo_t *game = tetris_create(&config);
+  while (game->bag_left > 0) generate_figure(game, &game->next);
+  for (int bag = 0; bag < 10; bag++) {
+    int seen = 0;
+    for (int i = 0; i < FIGURES_COUNT; i++) {
+      generate_figure(game, &game->next);
+      ck_assert_int_ge(game->next.id, FIGURE_I);
+      ck_assert_int_le(game->next.id, FIGURE_Z);
+      seen |= 1 << game->next.id;
+    }
+    ck_assert_int_eq(seen, 0xFE);
   }
+  tetris_destroy(game);
 }
 END_TEST
 
@@ -147,13 +207,15 @@ Suite *generate_figure_test_suite(void) {
   Suite *s = suite_create("generate_figure_test");
   TCase *tc_generate_figure_test = tcase_create("generate_figure_test");
   tcase_add_test(tc_generate_figure_test, generate_figure_test);
+  tcase_add_test(tc_generate_figure_test, seeded_sequence_test);
+  tcase_add_test(tc_generate_figure_test, bag_randomizer_test);
   suite_add_tcase(s, tc_generate_figure_test);
   return s;
 }
 
 START_TEST(moving_figure_test) {
   GameInfo_t *game = updateCurrentState();
-  generate_figure(&game->current);
+  generate_figure(game, &game->current);
   game->current.x = 3;
   game->current.y = 0;
   moving_state_actions(game, Left);
@@ -164,31 +226,31 @@ START_TEST(moving_figure_test) {
   ck_assert_int_eq(game->current.y, 18);
   game->current.x = 9;
   game->current.y = 0;
-  ck_assert_int_eq(check_leaving_field(), 2);
+  ck_assert_int_eq(check_leaving_field(game), 2);
   game->current.x = -1;
   game->current.y = 0;
-  ck_assert_int_eq(check_leaving_field(), 1);
+  ck_assert_int_eq(check_leaving_field(game), 1);
   game->current.x = 3;
   game->current.y = 19;
-  ck_assert_int_eq(check_leaving_field(), 3);
+  ck_assert_int_eq(check_leaving_field(game), 3);
   game->current.x = 3;
   game->current.y = 0;
   for (int i = 0; i < 2; i++) {
     for (int j = 0; j < WIDTH; j++) {
-      game->field[i][j] = 1;
+      set_field_cell(game, i, j, 1);
     }
   }
-  ck_assert_int_eq(check_figure_overlay(), 1);
+  ck_assert_int_eq(check_figure_overlay(game), 1);
   for (int i = 0; i < 2; i++) {
     for (int j = 0; j < WIDTH; j++) {
-      game->field[i][j] = 0;
+      set_field_cell(game, i, j, 0);
     }
   }
-  ck_assert_int_eq(check_figure_overlay(), 0);
+  ck_assert_int_eq(check_figure_overlay(game), 0);
   for (int i = 0; i < WIDTH; i++) {
-    game->field[2][i] = 1;
+    set_field_cell(game, 2, i, 1);
   }
-  ck_assert_int_eq(collision() & 0b100, 4);
+  ck_assert_int_eq(collision(game) & 0b100, 4);
 }
 END_TEST
 
@@ -202,41 +264,45 @@ Suite *moving_figure_test_suite(void) {
 
 START_TEST(rotate_figure_test) {
   GameInfo_t *game = updateCurrentState();
-  reset_field();
+  reset_field(game);
+  int pieces = game->pieces;
   spawn_state_actions(game);
-  reset_figure(&game->current);
-  game->current.rows = 2;
-  game->current.cols = 2;
-  for (int i = 1; i < 3; i++) game->current.view[0][i] = COLOR_CUSTOM_YELLOW;
-  for (int i = 1; i < 3; i++) game->current.view[1][i] = COLOR_CUSTOM_YELLOW;
-  game->current.type = 'O';
+  ck_assert_int_eq(game->pieces, pieces + 1);
+  init_figure(&game->current, FIGURE_O);
   game->current.y = 0;
-  rotate_figure();
-  for (int i = 1; i < 3; i++)
-    ck_assert_int_eq(game->current.view[0][i], COLOR_CUSTOM_YELLOW);
-  for (int i = 1; i < 3; i++)
-    ck_assert_int_eq(game->current.view[1][i], COLOR_CUSTOM_YELLOW);
-
-  reset_figure(&game->current);
-  game->current.rows = 2;
-  game->current.cols = 4;
-  for (int i = 0; i < 4; i++) game->current.view[1][i] = COLOR_RED;
-  game->current.type = 'I';
+  rotate_figure(game);
+  ck_assert_int_eq(game->current.rotation, 0);
+  for (int i = 0; i < 2; i++)
+    ck_assert_int_eq(figure_shape(&game->current)->mask[i], 0b0110);
+
+  init_figure(&game->current, FIGURE_I);
   game->current.x = 0;
   game->current.y = 1;
-  rotate_figure();
+  rotate_figure(game);
   for (int i = 0; i < 4; i++)
-    ck_assert_int_eq(game->current.view[i][1], COLOR_RED);
-
-  reset_figure(&game->current);
-  game->current.rows = 3;
-  game->current.cols = 3;
-  game->current.view[0][2] = COLOR_BLUE;
-  for (int i = 0; i < 3; i++) game->current.view[1][i] = COLOR_BLUE;
-  game->current.type = 'T';
-  rotate_figure();
+    ck_assert_int_eq(figure_shape(&game->current)->mask[i], 0b0010);
+  ck_assert_int_eq(figure_shape(&game->current)->rows, 4);
+  ck_assert_int_eq(figure_shape(&game->current)->cols, 2);
+
+  init_figure(&game->current, FIGURE_L);
+  rotate_figure(game);
   for (int i = 0; i < 3; i++)
-    ck_assert_int_eq(game->current.view[i][1], COLOR_BLUE);
+    ck_assert_int_ne(figure_shape(&game->current)->mask[i] & 0b0010, 0);
+
+  init_figure(&game->current, FIGURE_I);
+  game->current.x = 0;
+  game->current.y = -1;
+  rotate_figure(game);
+  ck_assert_int_eq(game->current.rotation, 0);
+
+  init_figure(&game->current, FIGURE_I);
+  game->current.y = 4;
+  rotate_figure(game);
+  game->current.x = 8;
+  rotate_figure(game);
+  ck_assert_int_eq(game->current.rotation, 0);
+  ck_assert_int_eq(game->current.x, 6);
+  ck_assert_int_eq(check_leaving_field(game), 0);
 }
 END_TEST
 
@@ -248,8 +314,738 @@ Suite *rotate_figure_test_suite(void) {
   return s;
 }
 
+START_TEST(bitboard_test) {
+  GameInfo_t *game = updateCurrentState();
+  reset_field(game);
+  for (int i = 0; i < HEIGHT; i++)
+    ck_assert_int_eq(game->rows[BOARD_TOP + i], ROW_EMPTY);
+  for (int i = 0; i < BOARD_FLOOR; i++)
+    ck_assert_int_eq(game->rows[BOARD_TOP + HEIGHT + i], ROW_FULL);
+  set_field_cell(game, 5, 0, COLOR_RED);
+  ck_assert_int_eq(game->rows[BOARD_TOP + 5], ROW_EMPTY | (1 << BOARD_WALL));
+  ck_assert_int_eq(game->field[5][0], COLOR_RED);
+  set_field_cell(game, 5, 0, 0);
+  ck_assert_int_eq(game->rows[BOARD_TOP + 5], ROW_EMPTY);
+
+  init_figure(&game->current, FIGURE_I);
+  game->current.x = 0;
+  game->current.y = 0;
+  ck_assert_int_eq(collision(game) & 0b010, 2);
+  ck_assert_int_eq(check_figure_overlay(game), 0);
+  game->current.x = -1;
+  ck_assert_int_eq(check_figure_overlay(game), 1);
+  game->current.x = 6;
+  game->current.y = HEIGHT - 2;
+  ck_assert_int_eq(collision(game), 0b101);
+  attached_figure(game);
+  ck_assert_int_eq(game->rows[BOARD_TOP + HEIGHT - 1],
+                   ROW_EMPTY | (0xF << (BOARD_WALL + 6)));
+  ck_assert_int_eq(game->field[HEIGHT - 1][9], COLOR_RED);
+}
+END_TEST
+
+START_TEST(landing_test) {
+  GameInfo_t *game = updateCurrentState();
+  reset_field(game);
+  for (int x = 0; x < WIDTH; x++) ck_assert_int_eq(game->heights[x], 0);
+  set_field_cell(game, HEIGHT - 3, 2, COLOR_RED);
+  set_field_cell(game, HEIGHT - 1, 5, COLOR_RED);
+  ck_assert_int_eq(game->heights[2], 3);
+  ck_assert_int_eq(game->heights[5], 1);
+  ck_assert_int_eq(game->heights[4], 0);
+  for (int id = FIGURE_I; id <= FIGURE_Z; id++) {
+    for (int rot = 0; rot < figure_info(id)->rotations; rot++) {
+      for (int x = -1; x < WIDTH; x++) {
+        Tetramino figure = {0};
+        init_figure(&figure, id);
+        figure.rotation = rot;
+        figure.x = x;
+        figure.y = 0;
+        if (figure_overlay(game, &figure)) continue;
+        Tetramino probe = figure;
+        while (!figure_overlay(game, &probe)) probe.y++;
+        ck_assert_int_eq(landing_y(game, &figure), probe.y - 1);
+      }
+    }
+  }
+  init_figure(&game->current, FIGURE_O);
+  game->current.x = 1;
+  game->current.y = 0;
+  game->current.y = landing_y(game, &game->current);
+  ck_assert_int_eq(game->current.y, HEIGHT - 5);
+  attached_figure(game);
+  ck_assert_int_eq(game->heights[2], 5);
+  ck_assert_int_eq(game->heights[3], 5);
+  set_field_cell(game, HEIGHT - 3, 8, COLOR_RED);
+  init_figure(&game->current, FIGURE_I);
+  game->current.x = 6;
+  game->current.y = HEIGHT - 3;
+  ck_assert_int_eq(landing_y(game, &game->current), HEIGHT - 2);
+  drop_lines(game, HEIGHT - 1);
+  ck_assert_int_eq(game->heights[2], 4);
+  ck_assert_int_eq(game->heights[5], 0);
+  ck_assert_int_eq(game->heights[8], 2);
+}
+END_TEST
+
+Suite *bitboard_test_suite(void) {
+  Suite *s = suite_create("bitboard_test");
+  TCase *tc_bitboard_test = tcase_create("bitboard_test");
+  tcase_add_test(tc_bitboard_test, bitboard_test);
+  tcase_add_test(tc_bitboard_test, landing_test);
+  suite_add_tcase(s, tc_bitboard_test);
+  return s;
+}
+
+START_TEST(instances_test) {
+  GameInfo_t *first = tetris_create(NULL);
+  GameInfo_t *second = tetris_create(NULL);
+  ck_assert_ptr_nonnull(first);
+  ck_assert_ptr_nonnull(second);
+  ck_assert_int_eq(first->state, START);
+  tetris_step(first, Start);
+  tetris_step(first, Left);
+  ck_assert_int_eq(first->state, MOVING);
+  ck_assert_int_eq(second->state, START);
+  set_field_cell(first, HEIGHT - 1, 0, COLOR_RED);
+  ck_assert_int_eq(field_color(first, HEIGHT - 1, 0), COLOR_RED);
+  ck_assert_int_eq(field_color(second, HEIGHT - 1, 0), 0);
+  ck_assert_int_eq(second->rows[BOARD_TOP + HEIGHT - 1], ROW_EMPTY);
+  ck_assert_int_eq((uintptr_t)first % GAME_CACHE_LINE, 0);
+  ck_assert_int_eq(sizeof(Tetramino), 4);
+  tetris_step(first, Terminate);
+  ck_assert_int_eq(first->state, EXIT_STATE);
+  tetris_destroy(first);
+  tetris_destroy(second);
+}
+END_TEST
+
+START_TEST(virtual_clock_test) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST};
+  GameInfo_t *game = tetris_create(&config);
+  ck_assert_ptr_nonnull(game);
+  tetris_step(game, Start);
+  tetris_step(game, -1);
+  ck_assert_int_eq(game->state, MOVING);
+  int y = game->current.y;
+  tetris_advance_clock(game, game->speed - 1);
+  tetris_step(game, -1);
+  ck_assert_int_eq(game->state, MOVING);
+  tetris_advance_clock(game, 1);
+  tetris_step(game, -1);
+  ck_assert_int_eq(game->state, SHIFTING);
+  tetris_step(game, -1);
+  ck_assert_int_eq(game->current.y, y + 1);
+  ck_assert_int_eq(game->timer, game->clock);
+  tetris_destroy(game);
+}
+END_TEST
+
+START_TEST(snapshot_test) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = 9,
+                           .randomizer = RANDOMIZER_BAG};
+  static const UserAction_t actions[] = {Left, Down, Action, Right, -1};
+  GameInfo_t *game = tetris_create(&config);
+  GameInfo_t *clone = tetris_create(&config);
+  GameSnapshot_t snapshot;
+  tetris_step(game, Start);
+  for (int i = 0; i < 200; i++) {
+    tetris_step(game, actions[i % 5]);
+    tetris_advance_clock(game, 100);
+  }
+  tetris_snapshot(game, &snapshot);
+  ck_assert_int_eq(GAME_SNAPSHOT_SIZE_OF(HEIGHT), 108);
+  ck_assert_int_le(sizeof(snapshot), 152);
+  tetris_restore(clone, &snapshot);
+  ck_assert_mem_eq(clone->rows, game->rows, sizeof(game->rows));
+  ck_assert_mem_eq(clone->heights, game->heights, sizeof(game->heights));
+  for (int i = 0; i < 300; i++) {
+    tetris_step(game, actions[i % 4]);
+    tetris_step(clone, actions[i % 4]);
+    tetris_advance_clock(game, 70);
+    tetris_advance_clock(clone, 70);
+  }
+  ck_assert_int_eq(clone->state, game->state);
+  ck_assert_int_eq(clone->score, game->score);
+  ck_assert_int_eq(clone->pieces, game->pieces);
+  ck_assert_mem_eq(clone->rows, game->rows, sizeof(game->rows));
+  ck_assert_mem_eq(clone->bag, game->bag, sizeof(game->bag));
+  GameSnapshot_t after;
+  tetris_restore(game, &snapshot);
+  tetris_snapshot(game, &after);
+  ck_assert_mem_eq(&after, &snapshot, GAME_SNAPSHOT_SIZE_OF(HEIGHT));
+  tetris_destroy(clone);
+  tetris_destroy(game);
+}
+END_TEST
+
+Suite *instances_test_suite(void) {
+  Suite *s = suite_create("instances_test");
+  TCase *tc_instances_test = tcase_create("instances_test");
+  tcase_add_test(tc_instances_test, instances_test);
+  tcase_add_test(tc_instances_test, virtual_clock_test);
+  tcase_add_test(tc_instances_test, snapshot_test);
+  suite_add_tcase(s, tc_instances_test);
+  return s;
+}
+
+START_TEST(geometry_test) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST};
+  ck_assert_int_eq(tetris_size_valid(0, 0), 1);
+  ck_assert_int_eq(tetris_size_valid(HEIGHT_MAX, WIDTH_MAX), 1);
+  ck_assert_int_eq(tetris_size_valid(SIZE_MIN - 1, 0), 0);
+  ck_assert_int_eq(tetris_size_valid(0, WIDTH_MAX + 1), 0);
+  config.width = WIDTH_MAX + 1;
+  ck_assert_ptr_null(tetris_create(&config));
+
+  config.width = 16;
+  GameInfo_t *wide = tetris_create(&config);
+  ck_assert_ptr_nonnull(wide);
+  ck_assert_int_eq(wide->height, HEIGHT);
+  ck_assert_int_eq(wide->width, 16);
+  ck_assert_int_eq(wide->rows[BOARD_TOP], ROW_EMPTY_OF(16));
+  tetris_step(wide, Start);
+  tetris_step(wide, -1);
+  ck_assert_int_eq(wide->current.x, 6);
+  for (int x = 0; x < 16; x++) set_field_cell(wide, HEIGHT - 1, x, COLOR_RED);
+  ck_assert_int_eq(wide->heights[15], 1);
+  calculate_score(wide);
+  ck_assert_int_eq(wide->score, 100);
+  ck_assert_int_eq(wide->rows[BOARD_TOP + HEIGHT - 1], ROW_EMPTY_OF(16));
+
+  config.width = 12;
+  config.height = HEIGHT_MAX;
+  GameInfo_t *tall = tetris_create(&config);
+  ck_assert_ptr_nonnull(tall);
+  init_figure(&tall->current, FIGURE_O);
+  tall->current.y = 0;
+  for (int i = 0; i < 20; i++) move_right(tall);
+  const FigureShape *shape = figure_shape(&tall->current);
+  ck_assert_int_eq(tall->current.x + shape->right, 11);
+  ck_assert_int_eq(landing_y(tall, &tall->current),
+                   HEIGHT_MAX - 1 - shape->bottom);
+  tall->current.y = (int8_t)landing_y(tall, &tall->current);
+  attached_figure(tall);
+  ck_assert_int_eq(tall->heights[11], 2);
+  ck_assert_int_eq(field_color(tall, HEIGHT_MAX - 1, 11),
+                   figure_info(FIGURE_O)->color);
+
+  uint8_t header[REPLAY_HEADER_SIZE];
+  ReplayReader_t reader;
+  replay_header(&config, header);
+  ck_assert_int_eq(replay_reader_init(&reader, header, sizeof(header)), 0);
+  ck_assert_int_eq(reader.config.height, HEIGHT_MAX);
+  ck_assert_int_eq(reader.config.width, 12);
+  tetris_destroy(tall);
+  tetris_destroy(wide);
+}
+END_TEST
+
+START_TEST(geometry_play_test) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = 4,
+                           .height = 24,
+                           .width = 16};
+  GameInfo_t *game = tetris_create(&config);
+  GameInfo_t *clone = tetris_create(&config);
+  AiPlayer_t *ai = ai_create(NULL);
+  GameSnapshot_t snapshot;
+  int pieces = 0;
+  tetris_step(game, ai_action(ai, game));
+  while (game->state != GAMEOVER && pieces < 150) {
+    if (game->state == SPAWN) pieces++;
+    tetris_step(game, ai_action(ai, game));
+    tetris_advance_clock(game, 50);
+  }
+  ck_assert_int_eq(pieces, 150);
+  ck_assert_int_gt(game->lines, 0);
+  tetris_snapshot(game, &snapshot);
+  tetris_restore(clone, &snapshot);
+  for (int i = 0; i < 500; i++) {
+    UserAction_t action = ai_action(ai, game);
+    tetris_step(game, action);
+    tetris_step(clone, action);
+    tetris_advance_clock(game, 50);
+    tetris_advance_clock(clone, 50);
+  }
+  ck_assert_int_eq(clone->score, game->score);
+  ck_assert_int_eq(clone->width, 16);
+  ck_assert_mem_eq(clone->rows, game->rows, sizeof(game->rows));
+  ai_destroy(ai);
+  tetris_destroy(clone);
+  tetris_destroy(game);
+}
+END_TEST
+
+Suite *geometry_test_suite(void) {
+  Suite *s = suite_create("geometry_test");
+  TCase *tc_geometry_test = tcase_create("geometry_test");
+  tcase_add_test(tc_geometry_test, geometry_test);
+  tcase_add_test(tc_geometry_test, geometry_play_test);
+  suite_add_tcase(s, tc_geometry_test);
+  return s;
+}
+
+START_TEST(features_test) {
+  GameInfo_t *game = updateCurrentState();
+  reset_field(game);
+  for (int y = HEIGHT - 3; y < HEIGHT; y++) set_field_cell(game, y, 0, 1);
+  set_field_cell(game, HEIGHT - 2, 2, 1);
+  BoardFeatures_t features;
+  board_features(game->rows, game->height, game->width, &features);
+  ck_assert_int_eq(features.aggregate_height, 5);
+  ck_assert_int_eq(features.holes, 1);
+  ck_assert_int_eq(features.bumpiness, 7);
+  ck_assert_int_eq(features.row_transitions, 42);
+  ck_assert_int_eq(features.column_transitions, 12);
+  ck_assert_int_eq(features.wells, 1);
+  ck_assert_int_eq(features.max_height, 3);
+  reset_field(game);
+
+  enum { BOARDS = 45 };
+  static const int sizes[][2] = {
+      {HEIGHT, WIDTH}, {HEIGHT, 12}, {HEIGHT, WIDTH_MAX}, {HEIGHT_MAX, 6}};
+  static uint32_t boards[BOARDS][BOARD_ROWS_MAX];
+  BoardFeatures_t batch[BOARDS];
+  Rng_t rng;
+  rng_seed(&rng, 12);
+  for (int k = 0; k < (int)(sizeof(sizes) / sizeof(sizes[0])); k++) {
+    int height = sizes[k][0], width = sizes[k][1];
+    uint32_t empty = ROW_EMPTY_OF(width);
+    for (int b = 0; b < BOARDS; b++) {
+      int top = (int)rng_bounded(&rng, height + 1);
+      for (int i = 0; i < BOARD_ROWS_MAX; i++) {
+        uint32_t cells = rng_next(&rng) & rng_next(&rng) & ROW_FIELD_OF(width);
+        boards[b][i] = i < BOARD_TOP + top ? empty : empty | cells;
+        if (i >= BOARD_TOP + height) boards[b][i] = ROW_FULL;
+      }
+    }
+    board_features_batch(boards, BOARDS, height, width, batch);
+    for (int b = 0; b < BOARDS; b++) {
+      board_features(boards[b], height, width, &features);
+      ck_assert_int_eq(memcmp(&features, &batch[b], sizeof(features)), 0);
+    }
+  }
+}
+END_TEST
+
+Suite *features_test_suite(void) {
+  Suite *s = suite_create("features_test");
+  TCase *tc_features_test = tcase_create("features_test");
+  tcase_add_test(tc_features_test, features_test);
+  suite_add_tcase(s, tc_features_test);
+  return s;
+}
+
+static int replay_placement(GameInfo_t *game, const Tetramino *start,
+                            const Placement_t *place) {
+  game->current = *start;
+  for (int i = 0; i < place->path_len; i++) apply_move(game, place->path[i]);
+  Tetramino below = game->current;
+  below.y++;
+  return game->current.x == place->x && game->current.y == place->y &&
+         game->current.rotation == place->rotation &&
+         figure_overlay(game, &below);
+}
+
+START_TEST(placements_test) {
+  static const int expected[FIGURES_COUNT + 1] = {0, 17, 9, 34, 34, 17, 34, 17};
+  Placement_t places[PLACEMENTS_MAX];
+  GameInfo_t *game = updateCurrentState();
+  reset_field(game);
+  for (int id = FIGURE_I; id <= FIGURE_Z; id++) {
+    Tetramino start = {0};
+    init_figure(&start, id);
+    start.x = WIDTH / 2 - 2;
+    start.y = figure_info(id)->spawn_y;
+    int count = generate_placements(game, &start, places, PLACEMENTS_MAX);
+    ck_assert_int_eq(count, expected[id]);
+    for (int i = 0; i < count; i++) {
+      ck_assert_int_eq(replay_placement(game, &start, &places[i]), 1);
+      ck_assert_int_eq(places[i].path[places[i].path_len - 1], MOVE_DROP);
+    }
+    ck_assert_int_eq(generate_drops(game, &start, places, PLACEMENTS_MAX),
+                     expected[id]);
+    for (int i = 0; i < expected[id]; i++)
+      ck_assert_int_eq(replay_placement(game, &start, &places[i]), 1);
+  }
+  Tetramino spawned = {0};
+  init_figure(&spawned, FIGURE_T);
+  spawned.x = WIDTH / 2 - 2;
+  ck_assert_int_eq(generate_placements(game, &spawned, places, 3), 3);
+
+  for (int x = 0; x < WIDTH - 2; x++) set_field_cell(game, HEIGHT - 4, x, 1);
+  Tetramino start = {0};
+  init_figure(&start, FIGURE_O);
+  start.x = 3;
+  start.y = 0;
+  int count = generate_placements(game, &start, places, PLACEMENTS_MAX);
+  int tucked = 0;
+  for (int i = 0; i < count; i++) {
+    ck_assert_int_eq(replay_placement(game, &start, &places[i]), 1);
+    if (places[i].y == HEIGHT - 2 && places[i].x < WIDTH - 4) tucked = 1;
+  }
+  ck_assert_int_eq(tucked, 1);
+  reset_field(game);
+}
+END_TEST
+
+Suite *placements_test_suite(void) {
+  Suite *s = suite_create("placements_test");
+  TCase *tc_placements_test = tcase_create("placements_test");
+  tcase_add_test(tc_placements_test, placements_test);
+  suite_add_tcase(s, tc_placements_test);
+  return s;
+}
+
+START_TEST(ai_test) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = 3};
+  AiConfig_t ai_config = {.threads = 2};
+  GameInfo_t *game = tetris_create(&config);
+  AiPlayer_t *ai = ai_create(&ai_config);
+  ck_assert_ptr_nonnull(ai);
+  ck_assert_int_eq(ai_budget(game), SPEED_MIN / AI_BUDGET_DIVISOR);
+  int pieces = 0;
+  tetris_step(game, ai_action(ai, game));
+  while (game->state != GAMEOVER && pieces < 300) {
+    if (game->state == SPAWN) pieces++;
+    tetris_step(game, ai_action(ai, game));
+    tetris_advance_clock(game, 50);
+  }
+  ck_assert_int_eq(pieces, 300);
+  ck_assert_int_gt(game->score, 0);
+  ai_destroy(ai);
+  tetris_destroy(game);
+}
+END_TEST
+
+/**
+ * @brief Играет автоигроком заданное число фигур
+ * @param threads Потоков поиска
+ * @param[out] rows Поле после игры
+ * @return Счет игры
+ */
+static int ai_play(int threads, uint32_t *rows) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = 11};
+  AiConfig_t ai_config = {.threads = threads};
+  GameInfo_t *game = tetris_create(&config);
+  AiPlayer_t *ai = ai_create(&ai_config);
+  int pieces = 0;
+  while (game->state != GAMEOVER && pieces < 150) {
+    if (game->state == SPAWN) pieces++;
+    tetris_step(game, ai_action(ai, game));
+    tetris_advance_clock(game, 50);
+  }
+  int score = game->score;
+  memcpy(rows, game->rows, sizeof(game->rows));
+  ai_destroy(ai);
+  tetris_destroy(game);
+  return score;
+}
+
+START_TEST(ai_reproducible_test) {
+  uint32_t single[BOARD_ROWS_MAX], pool[BOARD_ROWS_MAX];
+  int score = ai_play(1, single);
+  ck_assert_int_gt(score, 0);
+  ck_assert_int_eq(ai_play(4, pool), score);
+  ck_assert_mem_eq(pool, single, sizeof(single));
+}
+END_TEST
+
+Suite *ai_test_suite(void) {
+  Suite *s = suite_create("ai_test");
+  TCase *tc_ai_test = tcase_create("ai_test");
+  tcase_add_test(tc_ai_test, ai_test);
+  tcase_add_test(tc_ai_test, ai_reproducible_test);
+  suite_add_tcase(s, tc_ai_test);
+  return s;
+}
+
+START_TEST(replay_varint_test) {
+  static const uint64_t values[] = {0, 1, 127, 128, 300, 1ull << 35,
+                                    UINT64_MAX};
+  uint8_t buffer[REPLAY_VARINT_MAX * 7];
+  size_t len = 0, pos = 0;
+  for (int i = 0; i < 7; i++) len += replay_put_varint(buffer + len, values[i]);
+  ck_assert_int_eq(buffer[0], 0);
+  ck_assert_int_eq(buffer[2], 0x7F);
+  for (int i = 0; i < 7; i++) {
+    uint64_t value = 0;
+    ck_assert_int_eq(replay_get_varint(buffer, len, &pos, &value), 1);
+    ck_assert(value == values[i]);
+  }
+  ck_assert_int_eq(pos, len);
+  uint64_t value = 0;
+  pos = 3;
+  ck_assert_int_eq(replay_get_varint(buffer, 4, &pos, &value), 0);
+  ck_assert_int_eq(pos, 3);
+}
+END_TEST
+
+START_TEST(replay_round_trip_test) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = 11,
+                           .randomizer = RANDOMIZER_BAG};
+  static const UserAction_t actions[] = {-1, Left, Right, Down, Action};
+  GameInfo_t *game = tetris_create(&config);
+  ReplayWriter_t *writer = replay_writer_open("replay_test.trp", &config);
+  Rng_t input;
+  rng_seed(&input, 5);
+  ck_assert_ptr_nonnull(writer);
+  replay_record(writer, game->clock, Start);
+  tetris_step(game, Start);
+  for (int i = 0; i < 20000 && game->state != GAMEOVER; i++) {
+    UserAction_t action = actions[rng_bounded(&input, 5)];
+    tetris_advance_clock(game, rng_bounded(&input, 120));
+    replay_record(writer, game->clock, action);
+    tetris_step(game, action);
+  }
+  ck_assert_int_eq(replay_writer_close(writer), 0);
+
+  size_t size = 0;
+  uint8_t *data = replay_load("replay_test.trp", &size);
+  ck_assert_ptr_nonnull(data);
+  ck_assert_int_gt(size, REPLAY_HEADER_SIZE);
+  GameInfo_t *copy = replay_play(data, size);
+  ck_assert_ptr_nonnull(copy);
+  ck_assert_int_eq(copy->state, game->state);
+  ck_assert_int_eq(copy->score, game->score);
+  ck_assert_int_eq(copy->pieces, game->pieces);
+  ck_assert_int_eq(copy->clock, game->clock);
+  ck_assert_mem_eq(copy->rows, game->rows, sizeof(game->rows));
+  ck_assert_ptr_null(replay_play(data, REPLAY_HEADER_SIZE - 1));
+  tetris_destroy(copy);
+  tetris_destroy(game);
+  free(data);
+  remove("replay_test.trp");
+}
+END_TEST
+
+/**
+ * @brief Записывает случайные партии в буфер
+ * @param replay Буфер записи
+ * @param seed Начальное значение фигур и ввода
+ * @param games Количество партий (следующие начинаются рестартом)
+ */
+static void record_random_game(ReplayBuffer_t *replay, uint64_t seed,
+                               int games) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = seed};
+  static const UserAction_t actions[] = {-1, Left, Right, Down, Action};
+  GameInfo_t *game = tetris_create(&config);
+  Rng_t input;
+  rng_seed(&input, seed);
+  ck_assert_int_eq(replay_buffer_start(replay, &config), 0);
+  for (int i = 0; i < games; i++) {
+    replay_buffer_record(replay, game->clock, Start);
+    tetris_step(game, Start);
+    while (game->state != GAMEOVER) {
+      UserAction_t action = actions[rng_bounded(&input, 5)];
+      tetris_advance_clock(game, 40);
+      replay_buffer_record(replay, game->clock, action);
+      tetris_step(game, action);
+    }
+  }
+  tetris_destroy(game);
+}
+
+START_TEST(corpus_seek_test) {
+  CorpusWriter_t *writer = corpus_writer_open("corpus_test.bin", 4);
+  ReplayBuffer_t replay = {0};
+  ck_assert_ptr_nonnull(writer);
+  for (uint64_t seed = 1; seed <= 3; seed++) {
+    record_random_game(&replay, seed, 1);
+    ck_assert_int_eq(corpus_add(writer, replay.data, replay.len), 0);
+  }
+  ck_assert_int_eq(corpus_add(writer, replay.data, 3), 1);
+  ck_assert_int_eq(corpus_writer_close(writer), 0);
+
+  Corpus_t *corpus = corpus_open("corpus_test.bin");
+  ck_assert_ptr_nonnull(corpus);
+  ck_assert_int_eq(corpus->count, 3);
+  ReplayReader_t reader;
+  ck_assert_int_eq(corpus_replay(corpus, 2, &reader), 0);
+  ck_assert_int_eq(reader.size, replay.len);
+  ck_assert_mem_eq(reader.data, replay.data, replay.len);
+  ck_assert_int_ne(corpus_replay(corpus, 3, &reader), 0);
+  const CorpusGame_t *entry = &corpus->games[1];
+  ck_assert_int_eq(entry->keyframes, entry->pieces / 4);
+  ck_assert_ptr_nonnull(corpus_keyframes(corpus, 1));
+
+  int piece = entry->pieces - 2;
+  ReplayReader_t straight;
+  ck_assert_int_eq(corpus_replay(corpus, 1, &straight), 0);
+  straight.config.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST;
+  GameInfo_t *game = tetris_create(&straight.config);
+  uint64_t step = 0;
+  for (; game->pieces < piece; step++) replay_step(game, &straight);
+  GameInfo_t *seek = corpus_seek(corpus, 1, step, &reader);
+  ck_assert_ptr_nonnull(seek);
+  ck_assert_int_eq(seek->pieces, piece);
+  ck_assert_int_eq(seek->score, game->score);
+  ck_assert_int_eq(seek->clock, game->clock);
+  ck_assert_mem_eq(seek->rows, game->rows, sizeof(game->rows));
+  ck_assert_int_eq(reader.pos, straight.pos);
+  int stepping = 1;
+  while (stepping) stepping = replay_step(seek, &reader);
+  ck_assert_int_eq(seek->score, entry->score);
+  ck_assert_int_eq(seek->state, GAMEOVER);
+  tetris_destroy(game);
+  tetris_destroy(seek);
+  corpus_close(corpus);
+  replay_buffer_free(&replay);
+  remove("corpus_test.bin");
+}
+END_TEST
+
+START_TEST(corpus_restart_test) {
+  CorpusWriter_t *writer = corpus_writer_open("corpus_restart.bin", 4);
+  ReplayBuffer_t replay = {0};
+  ck_assert_ptr_nonnull(writer);
+  record_random_game(&replay, 7, 2);
+  ck_assert_int_eq(corpus_add(writer, replay.data, replay.len), 0);
+  ck_assert_int_eq(corpus_writer_close(writer), 0);
+
+  Corpus_t *corpus = corpus_open("corpus_restart.bin");
+  ck_assert_ptr_nonnull(corpus);
+  const CorpusGame_t *entry = &corpus->games[0];
+  ReplayReader_t straight;
+  ck_assert_int_eq(corpus_replay(corpus, 0, &straight), 0);
+  straight.config.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST;
+  GameInfo_t *game = tetris_create(&straight.config);
+  uint64_t step = 0;
+  int first = 0;
+  for (; first == 0; step++) {
+    if (game->state == GAMEOVER) first = game->pieces;
+    replay_step(game, &straight);
+  }
+  ck_assert_int_gt(entry->keyframes, first / 4);
+  const CorpusKeyframe_t *keyframes = corpus_keyframes(corpus, 0);
+  for (uint32_t i = 1; i < entry->keyframes; i++)
+    ck_assert(keyframes[i - 1].step < keyframes[i].step);
+
+  // номера фигур второй партии повторяют первую, кадры их не путают
+  int piece = (entry->pieces < first ? entry->pieces : first) - 1;
+  ck_assert_int_ge(piece, 4);
+  while (game->pieces != piece) {
+    replay_step(game, &straight);
+    step++;
+  }
+  ReplayReader_t reader;
+  GameInfo_t *seek = corpus_seek(corpus, 0, step, &reader);
+  ck_assert_ptr_nonnull(seek);
+  ck_assert_int_eq(seek->pieces, piece);
+  ck_assert_int_eq(seek->score, game->score);
+  ck_assert_int_eq(seek->clock, game->clock);
+  ck_assert_mem_eq(seek->rows, game->rows, sizeof(game->rows));
+  ck_assert_int_eq(reader.pos, straight.pos);
+  GameInfo_t *last = corpus_seek(corpus, 0, entry->steps, &reader);
+  ck_assert_int_eq(last->score, entry->score);
+  ck_assert_int_eq(last->state, GAMEOVER);
+  tetris_destroy(last);
+  tetris_destroy(game);
+  tetris_destroy(seek);
+  corpus_close(corpus);
+  replay_buffer_free(&replay);
+  remove("corpus_restart.bin");
+}
+END_TEST
+
+Suite *replay_test_suite(void) {
+  Suite *s = suite_create("replay_test");
+  TCase *tc_replay_test = tcase_create("replay_test");
+  tcase_add_test(tc_replay_test, replay_varint_test);
+  tcase_add_test(tc_replay_test, replay_round_trip_test);
+  tcase_add_test(tc_replay_test, corpus_seek_test);
+  tcase_add_test(tc_replay_test, corpus_restart_test);
+  suite_add_tcase(s, tc_replay_test);
+  return s;
+}
+
+START_TEST(leaderboard_insert_test) {
+  Leaderboard_t board = {.count = 0};
+  for (int i = 1; i <= LEADERBOARD_SIZE + 2; i++) {
+    ScoreEntry_t entry = {.score = i * 100, .lines = i, .level = 1};
+    leaderboard_insert(&board, &entry);
+  }
+  ck_assert_int_eq(board.count, LEADERBOARD_SIZE);
+  ck_assert_int_eq(board.entries[0].score, (LEADERBOARD_SIZE + 2) * 100);
+  ck_assert_int_eq(board.entries[LEADERBOARD_SIZE - 1].score, 300);
+  ScoreEntry_t tie = {.score = 300, .lines = 99};
+  ck_assert_int_eq(leaderboard_insert(&board, &tie), -1);
+  tie.score = 500;
+  ck_assert_int_eq(leaderboard_insert(&board, &tie), LEADERBOARD_SIZE - 2);
+  ck_assert_int_eq(board.entries[LEADERBOARD_SIZE - 3].lines, 5);
+  ck_assert_int_eq(board.entries[LEADERBOARD_SIZE - 1].score, 400);
+  ScoreEntry_t zero = {.score = 0};
+  Leaderboard_t empty = {.count = 0};
+  ck_assert_int_eq(leaderboard_insert(&empty, &zero), -1);
+  ck_assert_int_eq(empty.count, 0);
+}
+END_TEST
+
+START_TEST(leaderboard_store_test) {
+  ScoreStore_t *store = score_store_open("leaderboard_test.txt");
+  ck_assert_ptr_nonnull(store);
+  ck_assert_int_eq(score_store_best(store), 0);
+  ScoreEntry_t first = {.score = 700, .lines = 7, .level = 2};
+  ScoreEntry_t second = {.score = 1500, .lines = 12, .level = 3, .time = 42};
+  ck_assert_int_eq(score_store_submit(store, &first), 0);
+  ck_assert_int_eq(score_store_submit(store, &second), 0);
+  ck_assert_int_eq(score_store_best(store), 1500);
+  ck_assert_int_eq(score_store_close(store), 0);
+
+  Leaderboard_t board;
+  ck_assert_int_eq(leaderboard_load(&board, "leaderboard_test.txt"), 0);
+  ck_assert_int_eq(board.count, 2);
+  ck_assert_int_eq(board.entries[0].score, 1500);
+  ck_assert_int_eq(board.entries[0].level, 3);
+  ck_assert(board.entries[0].time == 42);
+  ck_assert_int_eq(board.entries[1].lines, 7);
+  ck_assert(board.entries[1].time > 0);
+  ck_assert_ptr_null(fopen("leaderboard_test.txt.tmp", "r"));
+  ck_assert_int_eq(leaderboard_save(&board, "no_such_dir/leaderboard.txt"),
+                   1);
+  ck_assert_int_eq(leaderboard_load(&board, "no_such_dir/leaderboard.txt"),
+                   1);
+  ck_assert_int_eq(board.count, 0);
+  ck_assert_int_eq(score_store_submit(NULL, &first), -1);
+  remove("leaderboard_test.txt");
+}
+END_TEST
+
+START_TEST(leaderboard_path_test) {
+  char *path = leaderboard_path("/data", "/home/user");
+  ck_assert_str_eq(path, "/data/tetris/leaderboard.txt");
+  free(path);
+  path = leaderboard_path("data", "/home/user");
+  ck_assert_str_eq(path, "/home/user/.local/share/tetris/leaderboard.txt");
+  free(path);
+  path = leaderboard_path(NULL, "/home/user");
+  ck_assert_str_eq(path, "/home/user/.local/share/tetris/leaderboard.txt");
+  free(path);
+  path = leaderboard_path("", "");
+  ck_assert_str_eq(path, LEADERBOARD_PATH);
+  free(path);
+}
+END_TEST
+
+Suite *leaderboard_test_suite(void) {
+  Suite *s = suite_create("leaderboard_test");
+  TCase *tc_leaderboard_test = tcase_create("leaderboard_test");
+  tcase_add_test(tc_leaderboard_test, leaderboard_insert_test);
+  tcase_add_test(tc_leaderboard_test, leaderboard_store_test);
+  tcase_add_test(tc_leaderboard_test, leaderboard_path_test);
+  suite_add_tcase(s, tc_leaderboard_test);
+  return s;
+}
+
 START_TEST(fsm_test) {
   GameInfo_t *game = updateCurrentState();
+  game->timer = game_time(game);  // гравитация не должна сработать в тесте
   game->state = START;
   userInput(Start, 0);
   ck_assert_int_eq(game->state, SPAWN);
@@ -264,6 +1060,7 @@ START_TEST(fsm_test) {
   userInput(Right, 0);
   ck_assert_int_eq(game->state, SPAWN);
   game->state = SHIFTING;
+  game->current.y = HEIGHT - 1 - figure_shape(&game->current)->bottom;
   userInput(Down, 0);
   ck_assert_int_eq(game->state, ATTACHING);
   game->state = MOVING;
@@ -275,14 +1072,524 @@ START_TEST(fsm_test) {
 }
 END_TEST
 
+/**
+ * @brief Делает шаг автомата с замером
+ * @param game Указатель на состояние игры
+ * @param action Действие пользователя
+ * @details Без TETRIS_STATS tetris_step() не замеряет шаги, и замер
+ * делается здесь
+ */
+static void measured_step(GameInfo_t *game, UserAction_t action) {
+#ifdef TETRIS_STATS
+  tetris_step(game, action);
+#else
+  FsmSample_t sample = fsm_stats_begin(game);
+  tetris_step(game, action);
+  fsm_stats_end(&sample, game);
+#endif
+}
+
+START_TEST(fsm_stats_test) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = 3};
+  GameInfo_t *game = tetris_create(&config);
+  FsmStats_t stats;
+  uint64_t steps = 0;
+  fsm_stats_reset();
+  measured_step(game, Start);
+  for (int i = 0; i < 5000 && game->state != GAMEOVER; i++) {
+    tetris_advance_clock(game, 50);
+    measured_step(game, i % 3 == 0 ? Left : Down);
+  }
+  fsm_stats_get(&stats);
+  for (int i = 0; i < FSM_STATES; i++) steps += stats.states[i].count;
+  ck_assert_int_eq(stats.transitions[START][SPAWN], 1);
+  ck_assert_int_eq(stats.transitions[SPAWN][MOVING] +
+                       stats.transitions[SPAWN][GAMEOVER],
+                   stats.states[SPAWN].count);
+  ck_assert_int_eq(stats.states[ATTACHING].count,
+                   stats.transitions[ATTACHING][SPAWN]);
+  ck_assert_int_eq(stats.pieces, game->pieces);
+  ck_assert_int_eq(stats.lines, game->lines);
+  ck_assert_int_gt(stats.started, 0);
+  const FsmHistogram_t *moving = &stats.states[MOVING];
+  uint64_t bucketed = 0;
+  for (int i = 0; i < FSM_STATS_BUCKETS; i++) bucketed += moving->buckets[i];
+  ck_assert_int_eq(bucketed, moving->count);
+  ck_assert(fsm_histogram_percentile(moving, 50) <=
+            fsm_histogram_percentile(moving, 99));
+  ck_assert(fsm_histogram_percentile(moving, 99) <= moving->max_ns);
+  fsm_stats_get(&stats);
+  uint64_t again = 0;
+  for (int i = 0; i < FSM_STATES; i++) again += stats.states[i].count;
+  ck_assert_int_eq(again, steps);
+  fsm_stats_reset();
+  fsm_stats_get(&stats);
+  ck_assert_int_eq(stats.states[MOVING].count, 0);
+  ck_assert_int_eq(fsm_histogram_percentile(&stats.states[MOVING], 50), 0);
+  tetris_destroy(game);
+}
+END_TEST
+
+START_TEST(fsm_dwell_test) {
+  TetrisConfig_t config = {.flags = GAME_VIRTUAL_CLOCK | GAME_NO_PERSIST,
+                           .seed = 3};
+  GameInfo_t *game = tetris_create(&config);
+  FsmStats_t stats;
+  fsm_stats_reset();
+  measured_step(game, Start);
+  measured_step(game, Left);
+  ck_assert_int_eq(game->state, MOVING);
+  uint64_t entered = fsm_stats_now();
+  while (fsm_stats_now() - entered < 2000000) continue;
+  measured_step(game, Pause);
+  ck_assert_int_eq(game->state, PAUSE);
+  fsm_stats_get(&stats);
+  // пребывание в MOVING - это ожидание между шагами, а не сами шаги
+  ck_assert(stats.dwell_ns[MOVING] >= 2000000);
+  ck_assert(stats.states[MOVING].total_ns < stats.dwell_ns[MOVING]);
+  ck_assert(stats.dwell_ns[START] > 0);
+  ck_assert(stats.dwell_ns[PAUSE] == 0);
+  fsm_stats_reset();
+  tetris_destroy(game);
+}
+END_TEST
+
 static Suite *fsm_test_suite(void) {
   Suite *s = suite_create("fsm_test");
   TCase *tc_fsm_test = tcase_create("fsm_test");
   tcase_add_test(tc_fsm_test, fsm_test);
+  tcase_add_test(tc_fsm_test, fsm_stats_test);
+  tcase_add_test(tc_fsm_test, fsm_dwell_test);
   suite_add_tcase(s, tc_fsm_test);
   return s;
 }
 
+START_TEST(input_queue_test) {
+  InputQueue_t queue;
+  input_queue_init(&queue);
+  ck_assert_int_eq(input_queue_pop(&queue), ERR);
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < INPUT_QUEUE_SIZE; i++)
+      ck_assert(input_queue_push(&queue, round * 100 + i));
+    ck_assert(!input_queue_push(&queue, -1));
+    for (int i = 0; i < INPUT_QUEUE_SIZE / 2; i++)
+      ck_assert_int_eq(input_queue_pop(&queue), round * 100 + i);
+    ck_assert(input_queue_push(&queue, KEY_LEFT));
+    for (int i = INPUT_QUEUE_SIZE / 2; i < INPUT_QUEUE_SIZE; i++)
+      ck_assert_int_eq(input_queue_pop(&queue), round * 100 + i);
+    ck_assert_int_eq(input_queue_pop(&queue), KEY_LEFT);
+    ck_assert_int_eq(input_queue_pop(&queue), ERR);
+  }
+}
+END_TEST
+
+START_TEST(autoshift_test) {
+  InputConfig_t config = {.das_ms = 100, .arr_ms = 30, .release_ms = 50};
+  AutoShift_t shift;
+  UserAction_t none = (UserAction_t)-1;
+  autoshift_init(&shift, NULL);
+  ck_assert_int_eq(shift.config.das_ms, INPUT_DAS_MS);
+  ck_assert_int_eq(shift.config.arr_ms, INPUT_ARR_MS);
+  ck_assert_int_eq(autoshift_timeout(&shift, 0), -1);
+  autoshift_init(&shift, &config);
+  // нажатие проходит сразу, удержание до DAS - нет
+  ck_assert_int_eq(autoshift_input(&shift, Left, false, 0), Left);
+  // так рано терминал не повторяет: это повторное нажатие
+  ck_assert(!autoshift_is_hold(&shift, Left, 40));
+  ck_assert(autoshift_is_hold(&shift, Left, INPUT_DELAY_MIN_MS));
+  ck_assert(!autoshift_is_hold(&shift, Right, INPUT_DELAY_MIN_MS));
+  ck_assert_int_eq(autoshift_timeout(&shift, 0), INPUT_DELAY_MAX_MS + 1);
+  ck_assert_int_eq(autoshift_input(&shift, Left, true, 40), none);
+  ck_assert_int_eq(autoshift_timeout(&shift, 60), 31);
+  ck_assert_int_eq(autoshift_input(&shift, Left, true, 80), none);
+  ck_assert_int_eq(autoshift_repeat(&shift, 90), none);
+  ck_assert_int_eq(autoshift_timeout(&shift, 90), 10);
+  // после DAS - повторы с периодом ARR без догоняния пропущенных
+  ck_assert_int_eq(autoshift_repeat(&shift, 100), Left);
+  ck_assert_int_eq(autoshift_repeat(&shift, 110), none);
+  ck_assert_int_eq(autoshift_input(&shift, Left, true, 130), Left);
+  ck_assert_int_eq(autoshift_repeat(&shift, 150), none);
+  ck_assert_int_eq(autoshift_repeat(&shift, 175), Left);
+  ck_assert_int_eq(autoshift_repeat(&shift, 180), none);
+  // без событий дольше release_ms клавиша отпущена
+  ck_assert_int_eq(autoshift_repeat(&shift, 181), none);
+  ck_assert(!autoshift_is_hold(&shift, Left, 181));
+  ck_assert_int_eq(autoshift_timeout(&shift, 181), -1);
+  // другое действие прекращает удержание, отсутствие действия - нет
+  ck_assert_int_eq(autoshift_input(&shift, Right, false, 200), Right);
+  ck_assert_int_eq(autoshift_input(&shift, none, false, 210), none);
+  ck_assert(autoshift_is_hold(&shift, Right, 450));
+  ck_assert_int_eq(autoshift_input(&shift, Action, false, 220), Action);
+  ck_assert(!autoshift_is_hold(&shift, Right, 230));
+  ck_assert_int_eq(autoshift_input(&shift, Right, true, 230), Right);
+  ck_assert_int_eq(autoshift_input(&shift, Down, true, 240), Down);
+}
+END_TEST
+
+START_TEST(autoshift_terminal_test) {
+  AutoShift_t shift;
+  UserAction_t none = (UserAction_t)-1;
+  autoshift_init(&shift, NULL);
+  // первый повтор терминала через 250 мс, следующие - каждые 33 мс
+  ck_assert_int_eq(autoshift_input(&shift, Right, false, 0), Right);
+  for (long long t = 5; t < 250; t += 5)
+    ck_assert_int_eq(autoshift_repeat(&shift, t), none);
+  ck_assert(autoshift_is_hold(&shift, Right, 250));
+  // DAS отсчитан от нажатия и уже прошел: повтор сразу
+  ck_assert_int_eq(autoshift_input(&shift, Right, true, 250), Right);
+  ck_assert_int_eq(autoshift_input(&shift, Right, true, 283), none);
+  ck_assert_int_eq(autoshift_repeat(&shift, 300), Right);
+  ck_assert_int_eq(autoshift_input(&shift, Right, true, 316), none);
+  ck_assert_int_eq(autoshift_input(&shift, Right, true, 349), none);
+  ck_assert_int_eq(autoshift_repeat(&shift, 350), Right);
+  ck_assert_int_eq(autoshift_repeat(&shift, 400), Right);
+  ck_assert_int_eq(autoshift_repeat(&shift, 410), none);
+  ck_assert(!autoshift_is_hold(&shift, Right, 410));
+  // медленное двойное нажатие сдвигает дважды, без лишних повторов
+  ck_assert_int_eq(autoshift_input(&shift, Left, false, 1000), Left);
+  ck_assert(autoshift_is_hold(&shift, Left, 1300));
+  ck_assert_int_eq(autoshift_input(&shift, Left, true, 1300), Left);
+  for (long long t = 1305; t < 1400; t += 5)
+    ck_assert_int_eq(autoshift_repeat(&shift, t), none);
+  ck_assert(!autoshift_is_hold(&shift, Left, 1400));
+  // DAS длиннее задержки терминала: повтор в срок DAS, а одиночное
+  // событие до DAS сдвигает при отпускании
+  InputConfig_t slow = {.das_ms = 400};
+  autoshift_init(&shift, &slow);
+  ck_assert_int_eq(autoshift_input(&shift, Left, false, 0), Left);
+  ck_assert_int_eq(autoshift_input(&shift, Left, true, 250), none);
+  ck_assert_int_eq(autoshift_input(&shift, Left, true, 283), none);
+  ck_assert_int_eq(autoshift_repeat(&shift, 300), none);
+  ck_assert_int_eq(autoshift_input(&shift, Left, true, 349), none);
+  ck_assert_int_eq(autoshift_input(&shift, Left, true, 382), none);
+  ck_assert_int_eq(autoshift_repeat(&shift, 400), Left);
+  ck_assert_int_eq(autoshift_input(&shift, Right, false, 1000), Right);
+  ck_assert_int_eq(autoshift_input(&shift, Right, true, 1300), none);
+  ck_assert_int_eq(autoshift_repeat(&shift, 1360), none);
+  ck_assert_int_eq(autoshift_repeat(&shift, 1361), Right);
+  ck_assert_int_eq(autoshift_repeat(&shift, 1362), none);
+}
+END_TEST
+
+START_TEST(user_input_hold_test) {
+  GameInfo_t *game = updateCurrentState();
+  reset_field(game);
+  game->state = MOVING;
+  game->timer = game_time(game);
+  init_figure(&game->current, FIGURE_O);
+  game->current.x = WIDTH / 2;
+  game->current.y = 2;
+  userInput(Right, false);
+  ck_assert_int_eq(game->current.x, WIDTH / 2 + 1);
+  userInput(Right, true);
+  ck_assert_int_eq(game->current.x, WIDTH / 2 + 1);
+  userInput(Left, true);
+  ck_assert_int_eq(game->current.x, WIDTH / 2);
+  userInput(Left, true);
+  ck_assert_int_eq(game->current.x, WIDTH / 2);
+  userInput(Left, false);
+  ck_assert_int_eq(game->current.x, WIDTH / 2 - 1);
+}
+END_TEST
+
+static Suite *input_test_suite(void) {
+  Suite *s = suite_create("input_test");
+  TCase *tc_input_test = tcase_create("input_test");
+  tcase_add_test(tc_input_test, input_queue_test);
+  tcase_add_test(tc_input_test, autoshift_test);
+  tcase_add_test(tc_input_test, autoshift_terminal_test);
+  tcase_add_test(tc_input_test, user_input_hold_test);
+  suite_add_tcase(s, tc_input_test);
+  return s;
+}
+
+/**
+ * @brief Собирает запрос протокола
+ * @param[out] out Буфер запроса
+ * @param type Тип запроса
+ * @param count Количество записей
+ * @param body Данные после заголовка
+ * @param size Размер данных
+ * @return Размер запроса
+ */
+static size_t make_request(uint8_t *out, int type, int count,
+                           const uint8_t *body, size_t size) {
+  ProtoHeader_t header = {.size = (uint32_t)(PROTO_HEADER_SIZE + size),
+                          .type = (uint8_t)type,
+                          .count = (uint16_t)count};
+  proto_put_header(out, &header);
+  memcpy(out + PROTO_HEADER_SIZE, body, size);
+  return header.size;
+}
+
+/**
+ * @brief Проверяет, что клиент видит игру такой, какая она на сервере
+ * @param view Состояние у клиента
+ * @param game Игра на сервере
+ */
+static void assert_view(const GameView_t *view, const GameInfo_t *game) {
+  ck_assert_int_eq(view->state, game->state);
+  ck_assert_mem_eq(&view->current, &game->current, sizeof(Tetramino));
+  ck_assert_mem_eq(&view->next, &game->next, sizeof(Tetramino));
+  ck_assert_int_eq(view->score, game->score);
+  ck_assert_int_eq(view->lines, game->lines);
+  ck_assert_int_eq(view->level, game->level);
+  for (int y = 0; y < game->height; y++) {
+    for (int x = 0; x < game->width; x++)
+      ck_assert_int_eq((view->rows[y] >> x) & 1, field_color(game, y, x) != 0);
+  }
+}
+
+START_TEST(protocol_test) {
+  uint8_t data[PROTO_HEADER_SIZE + 4] = {0};
+  ProtoHeader_t header = {.size = 0x01020304, .type = 7, .status = 9,
+                          .count = 0xBEEF};
+  ProtoHeader_t parsed;
+  proto_put_header(data, &header);
+  proto_get_header(data, &parsed);
+  ck_assert_int_eq(parsed.size, header.size);
+  ck_assert_int_eq(parsed.type, 7);
+  ck_assert_int_eq(parsed.status, 9);
+  ck_assert_int_eq(parsed.count, 0xBEEF);
+  ck_assert_int_eq(data[0], 0x04);
+  ck_assert_int_eq(proto_get(data, 4), 0x01020304);
+  ck_assert_int_eq(proto_frame_size(data, 7), 0);
+  ck_assert_int_eq(proto_frame_size(data, sizeof(data)), -1);
+  proto_put(data, 4, 4);
+  ck_assert_int_eq(proto_frame_size(data, sizeof(data)), -1);
+  proto_put(data, sizeof(data), 4);
+  ck_assert_int_eq(proto_frame_size(data, sizeof(data) - 1), 0);
+  ck_assert_int_eq(proto_frame_size(data, sizeof(data) + 5), sizeof(data));
+  proto_put(data, PROTO_REQUEST_MAX + 1, 4);
+  ck_assert_int_eq(proto_frame_size(data, sizeof(data)), -1);
+}
+END_TEST
+
+START_TEST(server_test) {
+  GameServer_t server;
+  ProtoBuffer_t reply = {0};
+  ProtoHeader_t header;
+  GameView_t view;
+  uint8_t request[PROTO_HEADER_SIZE + 8 * PROTO_STEP_SIZE];
+  uint8_t body[8 * PROTO_STEP_SIZE] = {0};
+  size_t pos = PROTO_HEADER_SIZE + 6;
+  server_init(&server, 2);
+  // CREATE: недопустимые размеры, затем игра 24x12
+  body[9] = HEIGHT_MAX + 1;
+  size_t size = make_request(request, PROTO_CREATE, 0, body, PROTO_CREATE_SIZE);
+  ck_assert_int_eq(server_handle(&server, 5, request, size, &reply), 0);
+  proto_get_header(reply.data, &header);
+  ck_assert_int_eq(header.type, PROTO_CREATE | PROTO_REPLY);
+  ck_assert_int_eq(header.status, PROTO_BAD_CONFIG);
+  ck_assert_int_eq(header.size, PROTO_HEADER_SIZE);
+  reply.len = 0;
+  proto_put(body, 42, 8);
+  body[9] = 24;
+  body[10] = 12;
+  size = make_request(request, PROTO_CREATE, 0, body, PROTO_CREATE_SIZE);
+  ck_assert_int_eq(server_handle(&server, 5, request, size, &reply), 0);
+  proto_get_header(reply.data, &header);
+  ck_assert_int_eq(header.status, PROTO_OK);
+  ck_assert_int_eq(header.size, reply.len);
+  ck_assert_int_eq(proto_get(reply.data + PROTO_HEADER_SIZE, 4), 1);
+  game_view_init(&view, reply.data[PROTO_HEADER_SIZE + 4],
+                 reply.data[PROTO_HEADER_SIZE + 5]);
+  ck_assert_int_eq(view.height, 24);
+  ck_assert_int_eq(view.width, 12);
+  ck_assert_int_eq(game_view_apply(&view, reply.data, reply.len, &pos), 0);
+  ck_assert_int_eq(pos, reply.len);
+  GameInfo_t *game = server.games[0].game;
+  assert_view(&view, game);
+  // STEP: шаги своей игры и чужого номера в одной пачке
+  Rng_t rng;
+  int landed = 0;
+  rng_seed(&rng, 7);
+  for (int round = 0; round < 400; round++) {
+    uint16_t rows[HEIGHT_MAX];
+    memcpy(rows, view.rows, sizeof(rows));
+    for (int i = 0; i < 8; i++) {
+      uint8_t *entry = body + i * PROTO_STEP_SIZE;
+      int8_t action = (int8_t)rng_bounded(&rng, Action + 2) - 1;
+      if (view.state == START || view.state == GAMEOVER) action = Start;
+      if (action == Terminate || action == Pause) action = Down;
+      proto_put(entry, i == 3 ? 2 : 1, 4);
+      proto_put(entry + 4, 100, 2);
+      entry[6] = (uint8_t)action;
+    }
+    reply.len = 0;
+    size = make_request(request, PROTO_STEP, 8, body, sizeof(body));
+    ck_assert_int_eq(server_handle(&server, 5, request, size, &reply), 0);
+    proto_get_header(reply.data, &header);
+    ck_assert_int_eq(header.status, PROTO_OK);
+    ck_assert_int_eq(header.count, 8);
+    pos = PROTO_HEADER_SIZE;
+    for (int i = 0; i < 8; i++)
+      ck_assert_int_eq(game_view_apply(&view, reply.data, reply.len, &pos),
+                       i == 3);
+    ck_assert_int_eq(pos, reply.len);
+    assert_view(&view, game);
+    landed += memcmp(rows, view.rows, sizeof(rows)) != 0;
+  }
+  ck_assert_int_gt(landed, 20);
+  // неверное действие отклоняет всю пачку
+  int pieces = game->pieces;
+  body[6] = 100;
+  reply.len = 0;
+  size = make_request(request, PROTO_STEP, 8, body, sizeof(body));
+  server_handle(&server, 5, request, size, &reply);
+  proto_get_header(reply.data, &header);
+  ck_assert_int_eq(header.status, PROTO_BAD_MESSAGE);
+  ck_assert_int_eq(header.count, 0);
+  ck_assert_int_eq(game->pieces, pieces);
+  reply.len = 0;
+  size = make_request(request, PROTO_STEP, 9, body, sizeof(body));
+  server_handle(&server, 5, request, size, &reply);
+  ck_assert_int_eq(reply.data[5], PROTO_BAD_MESSAGE);
+  // предел игр, чужие игры и удаление
+  proto_put(body, 1, 4);
+  size = make_request(request, PROTO_DESTROY, 0, body, 4);
+  reply.len = 0;
+  server_handle(&server, 6, request, size, &reply);
+  ck_assert_int_eq(reply.data[5], PROTO_BAD_GAME);
+  memset(body, 0, sizeof(body));
+  size = make_request(request, PROTO_CREATE, 0, body, PROTO_CREATE_SIZE);
+  for (int i = 0; i < 2; i++) {
+    reply.len = 0;
+    server_handle(&server, 6, request, size, &reply);
+    ck_assert_int_eq(reply.data[5], i == 0 ? PROTO_OK : PROTO_FULL);
+  }
+  ck_assert_int_eq(server.active, 2);
+  proto_put(body, 1, 4);
+  size = make_request(request, PROTO_DESTROY, 0, body, 4);
+  reply.len = 0;
+  server_handle(&server, 5, request, size, &reply);
+  ck_assert_int_eq(reply.data[5], PROTO_OK);
+  ck_assert_int_eq(server.active, 1);
+  size = make_request(request, PROTO_CREATE, 0, body, PROTO_CREATE_SIZE);
+  reply.len = 0;
+  server_handle(&server, 6, request, size, &reply);
+  ck_assert_int_eq(reply.data[5], PROTO_OK);
+  ck_assert_int_eq(proto_get(reply.data + PROTO_HEADER_SIZE, 4), 1);
+  server_drop_owner(&server, 6);
+  ck_assert_int_eq(server.active, 0);
+  reply.len = 0;
+  size = make_request(request, 99, 0, body, 0);
+  server_handle(&server, 6, request, size, &reply);
+  ck_assert_int_eq(reply.data[4], 99 | PROTO_REPLY);
+  ck_assert_int_eq(reply.data[5], PROTO_BAD_MESSAGE);
+  proto_buffer_free(&reply);
+  server_free(&server);
+}
+END_TEST
+
+static Suite *server_test_suite(void) {
+  Suite *s = suite_create("server_test");
+  TCase *tc_server_test = tcase_create("server_test");
+  tcase_add_test(tc_server_test, protocol_test);
+  tcase_add_test(tc_server_test, server_test);
+  suite_add_tcase(s, tc_server_test);
+  return s;
+}
+
+START_TEST(channel_test) {
+  static FrameChannel_t channel;
+  GameInfo_t *game = tetris_create(NULL);
+  bool fresh = true;
+  channel_init(&channel);
+  ck_assert_int_eq(channel_latest(&channel, &fresh)->score, 0);
+  ck_assert(!fresh);
+  game->score = 10;
+  channel_publish(&channel, game);
+  game->score = 20;
+  ck_assert_int_eq(channel_latest(&channel, &fresh)->score, 10);
+  ck_assert(fresh);
+  ck_assert_int_eq(channel_latest(&channel, &fresh)->score, 10);
+  ck_assert(!fresh);
+  for (int i = 1; i <= 5; i++) {
+    game->score = 100 + i;
+    channel_publish(&channel, game);
+  }
+  ck_assert_int_eq(channel_latest(&channel, &fresh)->score, 105);
+  ck_assert(fresh);
+  tetris_destroy(game);
+}
+END_TEST
+
+#define CHANNEL_TEST_ROUNDS 200000  ///< сообщений в тестах между потоками
+
+/**
+ * @brief Поток-производитель теста очереди ввода
+ * @param arg Очередь
+ * @return NULL
+ */
+static void *queue_producer(void *arg) {
+  InputQueue_t *queue = arg;
+  for (int i = 0; i < CHANNEL_TEST_ROUNDS; i++) {
+    while (!input_queue_push(queue, i)) sched_yield();
+  }
+  return NULL;
+}
+
+/**
+ * @brief Поток-производитель теста канала кадров
+ * @param arg Канал
+ * @return NULL
+ * @details Кадр i содержит i в нескольких полях, чтобы потребитель мог
+ * заметить кадр, собранный из двух публикаций
+ */
+static void *channel_producer(void *arg) {
+  FrameChannel_t *channel = arg;
+  static GameInfo_t game;
+  for (int i = 1; i <= CHANNEL_TEST_ROUNDS; i++) {
+    game.score = i;
+    game.lines = i;
+    game.clock = i;
+    channel_publish(channel, &game);
+  }
+  return NULL;
+}
+
+START_TEST(channel_threads_test) {
+  static InputQueue_t queue;
+  static FrameChannel_t channel;
+  pthread_t producer;
+  input_queue_init(&queue);
+  ck_assert_int_eq(pthread_create(&producer, NULL, queue_producer, &queue), 0);
+  for (int i = 0; i < CHANNEL_TEST_ROUNDS; i++) {
+    int key;
+    while ((key = input_queue_pop(&queue)) == ERR) sched_yield();
+    ck_assert_int_eq(key, i);
+  }
+  pthread_join(producer, NULL);
+  ck_assert_int_eq(input_queue_pop(&queue), ERR);
+
+  channel_init(&channel);
+  ck_assert_int_eq(
+      pthread_create(&producer, NULL, channel_producer, &channel), 0);
+  int last = 0;
+  while (last < CHANNEL_TEST_ROUNDS) {
+    bool fresh;
+    const GameInfo_t *frame = channel_latest(&channel, &fresh);
+    ck_assert_int_eq(frame->lines, frame->score);
+    ck_assert_int_eq(frame->clock, frame->score);
+    if (fresh) ck_assert_int_gt(frame->score, last);
+    ck_assert_int_ge(frame->score, last);
+    last = frame->score;
+  }
+  pthread_join(producer, NULL);
+}
+END_TEST
+
+static Suite *channel_test_suite(void) {
+  Suite *s = suite_create("channel_test");
+  TCase *tc_channel_test = tcase_create("channel_test");
+  tcase_add_test(tc_channel_test, channel_test);
+  tcase_add_test(tc_channel_test, channel_threads_test);
+  suite_add_tcase(s, tc_channel_test);
+  return s;
+}
+
 int main() {
   int n_failed = 0;
   Suite *suite = NULL;
@@ -295,7 +1602,18 @@ int main() {
                      generate_figure_test_suite(),
                      moving_figure_test_suite(),
                      rotate_figure_test_suite(),
+                     bitboard_test_suite(),
+                     instances_test_suite(),
+                     geometry_test_suite(),
+                     features_test_suite(),
+                     placements_test_suite(),
+                     ai_test_suite(),
+                     replay_test_suite(),
+                     leaderboard_test_suite(),
                      fsm_test_suite(),
+                     input_test_suite(),
+                     server_test_suite(),
+                     channel_test_suite(),
                      NULL};
 
   for (Suite **st = suites; *st != NULL; st++) srunner_add_suite(sr, *st);
@@ -3,8 +3,17 @@
 
 #include <check.h>
 #include <ncurses.h>
+#include <sched.h>
 #include <stdio.h>
 
+#include "../brick_game/tetris/backend/ai.h"
+#include "../brick_game/tetris/backend/channel.h"
+#include "../brick_game/tetris/backend/corpus.h"
+#include "../brick_game/tetris/backend/input.h"
+#include "../brick_game/tetris/backend/leaderboard.h"
+#include "../brick_game/tetris/backend/moves.h"
+#include "../brick_game/tetris/backend/replay.h"
+#include "../brick_game/tetris/backend/server.h"
 #include "../brick_game/tetris/tetris.h"
 
 Suite *test_suite();